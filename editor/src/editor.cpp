@@ -9,11 +9,15 @@
 #include <webgpu/webgpu_cpp.h>
 
 #include <cstdlib>
+#include <exception>
 #include <fstream>
 #include <iostream>
 
 #define SCENE_RESOLUTION 512
 #define DEFAULT_SCENE_SCALE 32.f
+#define SCENE_FILE_EXTENSION ".vxng"
+// undo steps are dropped oldest first past this
+#define UNDO_MEMORY_BUDGET (256 << 20)
 
 Editor::Editor()
     : renderer(), viewport_camera(),
@@ -21,7 +25,9 @@ Editor::Editor()
                                                  DEFAULT_SCENE_SCALE)),
       cursors(), tools(), current_tool(&tools.voxel_brush), palette(),
       light_dir(0.5, 1.0, 0.3), dirlight_color(0.8), ambient_light_color(0.2),
-      background_color(0.1) {
+      background_color(0.1), streaming_enabled(false), residency_budget(),
+      distance_grid_resolution(0), pending_edit(), undo_history(),
+      redo_history() {
     palette.init_default_colors();
 };
 
@@ -184,14 +190,19 @@ auto Editor::init() -> int {
     init_info.Device = this->wgpu.device.Get();
     init_info.RenderTargetFormat =
         (WGPUTextureFormat)this->wgpu.preferred_format;
+    // gui gets its own pass after the scene, without depth
     init_info.DepthStencilFormat =
-        (WGPUTextureFormat)wgpu::TextureFormat::Depth32Float;
+        (WGPUTextureFormat)wgpu::TextureFormat::Undefined;
     ImGui_ImplWGPU_Init(&init_info);
 
     return 0;
 }
 
 Editor::~Editor() {
+    // let any in-flight load finish, there's no way to cancel it midway
+    if (this->load_job && this->load_job->thread.joinable())
+        this->load_job->thread.join();
+
     if (this->imgui_context != nullptr) {
         ImGui::SetCurrentContext(this->imgui_context);
         ImGui_ImplWGPU_Shutdown();
@@ -208,6 +219,8 @@ auto Editor::run() -> void {
     bool quit = false;
     while (!quit) {
         poll_events(quit);
+        this->scene->update_residency(this->viewport_camera.get_position());
+        this->scene->flush_chunk_buffers();
         draw_to_surface();
     }
 }
@@ -232,7 +245,11 @@ auto Editor::draw_to_surface() -> void {
     wgpu::CommandEncoder encoder =
         this->wgpu.device.CreateCommandEncoder(&encoderDesc);
 
-    // Create the render pass that clears the screen with our color
+    // delegate scene drawing to our vxng::Renderer, which clears the screen
+    // with our background color
+    renderer.render(encoder, targetView);
+
+    // then draw the gui over it
     wgpu::RenderPassDescriptor renderPassDesc = {};
 
     // The attachment part of the render pass descriptor describes the target
@@ -240,32 +257,18 @@ auto Editor::draw_to_surface() -> void {
     wgpu::RenderPassColorAttachment renderPassColorAttachment = {};
     renderPassColorAttachment.view = targetView;
     renderPassColorAttachment.resolveTarget = nullptr;
-    renderPassColorAttachment.loadOp = wgpu::LoadOp::Clear;
+    renderPassColorAttachment.loadOp = wgpu::LoadOp::Load;
     renderPassColorAttachment.storeOp = wgpu::StoreOp::Store;
-    renderPassColorAttachment.clearValue = wgpu::Color{
-        background_color.r, background_color.g, background_color.b, 1.0};
-
-    // depth attachment for multi-chunk rendering
-    wgpu::RenderPassDepthStencilAttachment depthAttachment;
-    depthAttachment.view = renderer.get_depth_texture_view();
-    depthAttachment.depthLoadOp = wgpu::LoadOp::Clear;
-    depthAttachment.depthStoreOp = wgpu::StoreOp::Store;
-    depthAttachment.depthClearValue = 1.0f; // far plane
-    depthAttachment.stencilLoadOp = wgpu::LoadOp::Undefined;
-    depthAttachment.stencilStoreOp = wgpu::StoreOp::Undefined;
 
     renderPassDesc.colorAttachmentCount = 1;
     renderPassDesc.colorAttachments = &renderPassColorAttachment;
-    renderPassDesc.depthStencilAttachment = &depthAttachment;
+    renderPassDesc.depthStencilAttachment = nullptr;
     renderPassDesc.timestampWrites = nullptr;
 
     // render pass!
     wgpu::RenderPassEncoder renderPass =
         encoder.BeginRenderPass(&renderPassDesc);
 
-    // delegate this to our vxng::Renderer
-    renderer.render(renderPass);
-
     ImGui_ImplWGPU_RenderDrawData(ImGui::GetDrawData(), renderPass.Get());
 
     renderPass.End();
@@ -289,6 +292,9 @@ auto Editor::draw_to_surface() -> void {
 
 auto Editor::run_gui() -> void {
 
+    // pick up finished loads and any files picked since last frame
+    this->poll_load_job();
+
     // --------- Title/File menu ---------
 
     if (ImGui::BeginMainMenuBar()) {
@@ -307,9 +313,28 @@ auto Editor::run_gui() -> void {
                 }
                 ImGui::EndMenu();
             }
-            if (ImGui::MenuItem("Open")) {
+            if (ImGui::MenuItem("Open", NULL, false, !this->load_job)) {
                 this->handle_open_vox_file();
             }
+            if (ImGui::MenuItem("Save As...")) {
+                this->handle_save_scene_file();
+            }
+            ImGui::Separator();
+            // shares repeated geometry; edited chunks thaw again on their own
+            if (ImGui::MenuItem("Compress Chunks", NULL, false,
+                                !this->load_job)) {
+                this->scene->compress_chunks();
+            }
+            ImGui::EndMenu();
+        }
+
+        if (ImGui::BeginMenu("Edit")) {
+            if (ImGui::MenuItem("Undo", "Ctrl+Z", false,
+                                !this->undo_history.empty()))
+                this->undo();
+            if (ImGui::MenuItem("Redo", "Ctrl+Shift+Z", false,
+                                !this->redo_history.empty()))
+                this->redo();
             ImGui::EndMenu();
         }
 
@@ -325,6 +350,9 @@ auto Editor::run_gui() -> void {
         ImGui::EndMainMenuBar();
     }
 
+    this->run_load_progress_gui();
+    this->run_load_errors_gui();
+
     // --------- Options menu ---------
 
     if (this->panels.show_options) {
@@ -358,6 +386,29 @@ auto Editor::run_gui() -> void {
                 this->renderer.set_background_color(this->background_color);
             };
 
+            // for a/b-ing frame times, both should look the same
+            const char *traversal_names[] = {"Stack", "Parametric"};
+            int traversal = this->renderer.get_traversal();
+            if (ImGui::Combo("Traversal", &traversal, traversal_names,
+                             IM_ARRAYSIZE(traversal_names))) {
+                this->renderer.set_traversal(
+                    static_cast<vxng::Renderer::Traversal>(traversal));
+            }
+
+            bool beam_prepass = this->renderer.is_beam_prepass();
+            if (ImGui::Checkbox("Beam prepass", &beam_prepass))
+                this->renderer.set_beam_prepass(beam_prepass);
+
+            bool single_pass = this->renderer.is_single_pass();
+            if (ImGui::Checkbox("Single pass", &single_pass))
+                this->renderer.set_single_pass(single_pass);
+
+            // this one does change the image, coarser with distance
+            float lod_threshold = this->renderer.get_lod_threshold();
+            if (ImGui::SliderFloat("LOD pixel size", &lod_threshold, 0.f, 4.f,
+                                   "%.1f"))
+                this->renderer.set_lod_threshold(lod_threshold);
+
             ImGui::Dummy(ImVec2(0.0f, 16.0f));
 
             // Scene Resolution
@@ -375,6 +426,64 @@ auto Editor::run_gui() -> void {
                 float new_scale = 512.f / glm::pow(2.f, unit_voxel_depth);
                 this->scene->set_chunk_scale(new_scale);
             }
+
+            ImGui::Dummy(ImVec2(0.0f, 16.0f));
+
+            // Chunk paging
+            ImGui::SeparatorText("Streaming");
+
+            bool streaming_changed = ImGui::Checkbox(
+                "Stream chunks around camera", &this->streaming_enabled);
+
+            float radius = this->residency_budget.radius;
+            int cpu_mb = static_cast<int>(
+                this->residency_budget.max_cpu_bytes >> 20);
+            int gpu_mb = static_cast<int>(
+                this->residency_budget.max_gpu_bytes >> 20);
+            streaming_changed |=
+                ImGui::SliderFloat("Radius", &radius, 16.f, 2048.f, "%.0f");
+            streaming_changed |=
+                ImGui::SliderInt("CPU budget (MB)", &cpu_mb, 64, 16384);
+            streaming_changed |=
+                ImGui::SliderInt("GPU budget (MB)", &gpu_mb, 64, 16384);
+
+            if (streaming_changed) {
+                this->residency_budget.radius = radius;
+                this->residency_budget.max_cpu_bytes = size_t(cpu_mb) << 20;
+                this->residency_budget.max_gpu_bytes = size_t(gpu_mb) << 20;
+                this->apply_streaming_options(*this->scene);
+            }
+
+            if (this->scene->is_streaming()) {
+                auto stats = this->scene->get_residency_stats();
+                ImGui::Text("%zu resident (%zu drawn), %zu on disk",
+                            stats.resident_chunks, stats.gpu_chunks,
+                            stats.stored_chunks);
+                ImGui::Text("CPU %zu MB, GPU %zu MB", stats.cpu_bytes >> 20,
+                            stats.gpu_bytes >> 20);
+            }
+
+            ImGui::Dummy(ImVec2(0.0f, 16.0f));
+
+            ImGui::SeparatorText("GPU Memory");
+
+            // empty space skipping, trading a little memory per chunk
+            const char *grid_names[] = {"Off", "8", "16", "32", "64"};
+            const int grid_resolutions[] = {0, 8, 16, 32, 64};
+            int grid_choice = 0;
+            for (int i = 0; i < IM_ARRAYSIZE(grid_resolutions); ++i) {
+                if (grid_resolutions[i] == this->distance_grid_resolution)
+                    grid_choice = i;
+            }
+            if (ImGui::Combo("Empty space grid", &grid_choice, grid_names,
+                             IM_ARRAYSIZE(grid_names))) {
+                this->distance_grid_resolution = grid_resolutions[grid_choice];
+                this->scene->set_distance_grid_resolution(
+                    this->distance_grid_resolution);
+            }
+            ImGui::TextWrapped(
+                "Lets rays jump over empty parts of each chunk, at a byte per "
+                "grid cell per chunk.");
         }
         ImGui::End();
     }
@@ -416,12 +525,52 @@ auto Editor::run_gui() -> void {
 }
 
 const SDL_DialogFileFilter Editor::vox_filters[] = {
+    {.name = "Voxel files", .pattern = "vox;vxng"},
     {.name = "MagicaVoxel files", .pattern = "vox"},
+    {.name = "Scene files", .pattern = "vxng"},
+};
+
+const SDL_DialogFileFilter Editor::scene_filters[] = {
+    {.name = "Scene files", .pattern = "vxng"},
 };
 
+static auto is_scene_file_path(const std::string &path) -> bool {
+    std::string extension = SCENE_FILE_EXTENSION;
+    return path.size() >= extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(),
+                        extension) == 0;
+}
+
 auto Editor::handle_open_vox_file() -> void {
     SDL_ShowOpenFileDialog(&open_vox_file, this, this->sdl_window, vox_filters,
-                           1, NULL, false);
+                           3, NULL, false);
+}
+
+auto Editor::handle_save_scene_file() -> void {
+    SDL_ShowSaveFileDialog(&save_scene_file, this, this->sdl_window,
+                           scene_filters, 1, NULL);
+}
+
+auto Editor::save_scene_file(void *user_data, const char *const *file_list,
+                             int filter) -> void {
+    // we passed the editor through as user data
+    Editor *editor = (Editor *)user_data;
+
+    if (!file_list) {
+        SDL_Log("An error occured: %s", SDL_GetError());
+        return;
+    } else if (!*file_list) {
+        SDL_Log("The dialog was canceled.");
+        return;
+    }
+
+    std::string path = *file_list;
+    if (!is_scene_file_path(path))
+        path += SCENE_FILE_EXTENSION;
+
+    // saving touches the scene, so leave it to the main thread
+    std::lock_guard<std::mutex> lock(editor->pending_paths_mutex);
+    editor->pending_save_paths.push_back(path);
 }
 
 auto Editor::open_vox_file(void *user_data, const char *const *file_list,
@@ -438,27 +587,165 @@ auto Editor::open_vox_file(void *user_data, const char *const *file_list,
         return;
     }
 
+    // hand the paths to the main thread, which starts the actual load
+    std::lock_guard<std::mutex> lock(editor->pending_paths_mutex);
     while (*file_list) {
-        // load file using fstream
-        std::ifstream file(*file_list, std::ios::binary | std::ios::ate);
-        if (!file.is_open()) {
-            SDL_Log("Failed to open file: '%s'", *file_list);
-            file_list++;
-            continue;
+        editor->pending_open_paths.emplace_back(*file_list);
+        file_list++;
+    }
+}
+
+auto Editor::start_load_job(std::vector<std::string> paths) -> void {
+    this->load_job = std::make_unique<LoadJob>();
+    this->load_job->paths = std::move(paths);
+
+    // no device on this scene, so it can be built entirely off-thread
+    this->load_job->scene = std::make_unique<vxng::scene::Scene>(
+        SCENE_RESOLUTION, this->scene->get_chunk_scale());
+
+    // streamed scenes leave chunks on disk instead of loading them all
+    this->apply_streaming_options(*this->load_job->scene);
+    this->load_job->scene->set_distance_grid_resolution(
+        this->distance_grid_resolution);
+
+    this->load_job->thread = std::thread(&Editor::run_load_job,
+                                         this->load_job.get());
+}
+
+auto Editor::run_load_job(LoadJob *job) -> void {
+    for (const auto &path : job->paths) {
+        // anything thrown here would take the whole editor down with it, so
+        // it ends the job instead
+        try {
+            // our own files get mapped, no need to read them in
+            if (is_scene_file_path(path)) {
+                if (!job->scene->load_file(path, &job->progress))
+                    job->errors.push_back("Failed to load '" + path + "'");
+                continue;
+            }
+
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file.is_open()) {
+                SDL_Log("Failed to open file: '%s'", path.c_str());
+                job->errors.push_back("Failed to open '" + path + "'");
+                continue;
+            }
+
+            size_t buffer_size = file.tellg();
+            file.seekg(0, std::ios::beg);
+            std::vector<uint8_t> buffer(buffer_size);
+
+            file.read(reinterpret_cast<char *>(buffer.data()), buffer_size);
+            file.close();
+
+            job->progress.bytes_total += buffer_size;
+            if (!buffer.empty())
+                job->scene->load_vox_file(buffer, &job->progress);
+        } catch (const std::exception &e) {
+            SDL_Log("Failed to load '%s': %s", path.c_str(), e.what());
+            job->errors.push_back("Failed to load '" + path + "': " +
+                                  e.what());
+            job->failed = true;
+            break;
         }
+    }
 
-        uint32_t buffer_size = file.tellg();
-        file.seekg(0, std::ios::beg);
-        std::vector<uint8_t> buffer(buffer_size);
+    job->done = true;
+}
 
-        file.read(reinterpret_cast<char *>(buffer.data()), buffer_size);
-        file.close();
+auto Editor::poll_load_job() -> void {
+    if (this->load_job) {
+        if (!this->load_job->done)
+            return;
+
+        this->load_job->thread.join();
+        this->load_errors = std::move(this->load_job->errors);
+
+        // a failed job's scene is in no state to show, keep the old one
+        if (!this->load_job->failed) {
+            // gpu upload has to happen here, on the device's thread
+            auto new_scene = std::move(this->load_job->scene);
+            new_scene->init_webgpu(this->wgpu.device);
+
+            // tools grab the scene fresh for every event, so nothing holds
+            // on to the old one past this point
+            if (this->is_tool_active) {
+                this->current_tool->handle_deactivate(make_event_bundle());
+                this->is_tool_active = false;
+            }
+            this->scene = std::move(new_scene);
+            this->renderer.set_scene(this->scene.get());
+            this->clear_history();
+        }
 
-        SDL_Log("Loading vox file: '%s'", *file_list);
-        editor->scene->load_vox_file(buffer);
+        this->load_job.reset();
+    }
 
-        file_list++;
+    std::vector<std::string> save_paths;
+    std::vector<std::string> paths;
+    {
+        std::lock_guard<std::mutex> lock(this->pending_paths_mutex);
+        save_paths.swap(this->pending_save_paths);
+        paths.swap(this->pending_open_paths);
     }
+
+    // saving is just a copy of the gpu arrays, fine to do right here
+    for (const auto &path : save_paths) {
+        SDL_Log("Saving scene file: '%s'", path.c_str());
+        this->scene->save_file(path);
+    }
+
+    if (!paths.empty()) {
+        SDL_Log("Loading %zu vox file(s)", paths.size());
+        this->start_load_job(std::move(paths));
+    }
+}
+
+auto Editor::run_load_progress_gui() -> void {
+    if (!this->load_job)
+        return;
+
+    const auto &progress = this->load_job->progress;
+
+    ImGuiIO &io = ImGui::GetIO();
+    ImGui::SetNextWindowPos(
+        ImVec2(io.DisplaySize.x * 0.5f, io.DisplaySize.y * 0.5f),
+        ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+    ImGui::SetNextWindowSize(ImVec2(360.f, 0.f));
+    ImGui::Begin("Loading", NULL,
+                 ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse |
+                     ImGuiWindowFlags_NoSavedSettings);
+
+    ImGui::ProgressBar(progress.get_fraction(), ImVec2(-1.f, 0.f));
+    ImGui::Text("Parsed %zu / %zu KB", progress.bytes_parsed / 1024,
+                progress.bytes_total / 1024);
+    ImGui::Text("Inserted %zu / %zu voxels", progress.voxels_inserted.load(),
+                progress.voxels_total.load());
+    ImGui::Text("Built %zu / %zu chunks", progress.chunks_built.load(),
+                progress.chunks_total.load());
+
+    ImGui::End();
+}
+
+auto Editor::run_load_errors_gui() -> void {
+    if (this->load_errors.empty())
+        return;
+
+    ImGuiIO &io = ImGui::GetIO();
+    ImGui::SetNextWindowPos(
+        ImVec2(io.DisplaySize.x * 0.5f, io.DisplaySize.y * 0.5f),
+        ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+    ImGui::SetNextWindowSize(ImVec2(360.f, 0.f));
+    ImGui::Begin("Loading failed", NULL,
+                 ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoCollapse |
+                     ImGuiWindowFlags_NoSavedSettings);
+
+    for (const auto &error : this->load_errors)
+        ImGui::TextWrapped("%s", error.c_str());
+    if (ImGui::Button("OK"))
+        this->load_errors.clear();
+
+    ImGui::End();
 }
 
 auto Editor::get_surface_configuration(int width, int height)
@@ -578,6 +865,28 @@ auto Editor::handle_key_down(const SDL_KeyboardEvent &event, bool *quit)
         *quit = true;
         break;
 
+    case SDLK_Z: {
+        if (!(event.mod & SDL_KMOD_CTRL)) {
+            this->current_tool->handle_keyboard_event(event,
+                                                      make_event_bundle());
+            break;
+        }
+        if (event.mod & SDL_KMOD_SHIFT)
+            this->redo();
+        else
+            this->undo();
+        break;
+    }
+
+    case SDLK_Y: {
+        if (event.mod & SDL_KMOD_CTRL)
+            this->redo();
+        else
+            this->current_tool->handle_keyboard_event(event,
+                                                      make_event_bundle());
+        break;
+    }
+
     case SDLK_A: {
         // add random white block
         auto rand_pos =
@@ -657,15 +966,75 @@ auto Editor::handle_mouse_up(const SDL_MouseButtonEvent &event) -> void {
         return; // using navigation mode
 
     this->current_tool->handle_mouse_button_event(event, make_event_bundle());
+
+    // a whole stroke is one undo step
+    this->commit_pending_edit();
+}
+
+auto Editor::commit_pending_edit() -> void {
+    if (this->pending_edit.is_empty())
+        return;
+
+    this->undo_history.push_back(std::move(this->pending_edit));
+    this->pending_edit = vxng::scene::EditRecord();
+    this->redo_history.clear();
+
+    // keep history under budget, always leaving the latest step
+    size_t bytes = 0;
+    for (const auto &record : this->undo_history)
+        bytes += record.get_memory_usage();
+    while (bytes > UNDO_MEMORY_BUDGET && this->undo_history.size() > 1) {
+        bytes -= this->undo_history.front().get_memory_usage();
+        this->undo_history.pop_front();
+    }
+}
+
+auto Editor::undo() -> void {
+    this->commit_pending_edit();
+    if (this->undo_history.empty())
+        return;
+
+    // swapping leaves the record holding the edit itself, ready to redo
+    vxng::scene::EditRecord record = std::move(this->undo_history.back());
+    this->undo_history.pop_back();
+    this->scene->swap_edit_record(record);
+    this->redo_history.push_back(std::move(record));
+}
+
+auto Editor::redo() -> void {
+    this->commit_pending_edit();
+    if (this->redo_history.empty())
+        return;
+
+    vxng::scene::EditRecord record = std::move(this->redo_history.back());
+    this->redo_history.pop_back();
+    this->scene->swap_edit_record(record);
+    this->undo_history.push_back(std::move(record));
+}
+
+auto Editor::clear_history() -> void {
+    this->pending_edit = vxng::scene::EditRecord();
+    this->undo_history.clear();
+    this->redo_history.clear();
 }
 
 auto Editor::new_empty_scene() -> void {
     // create new scene object
     this->scene = std::make_unique<vxng::scene::Scene>(SCENE_RESOLUTION,
                                                        DEFAULT_SCENE_SCALE);
+    this->apply_streaming_options(*this->scene);
+    this->scene->set_distance_grid_resolution(this->distance_grid_resolution);
     this->scene->init_webgpu(this->wgpu.device);
 
     this->renderer.set_scene(this->scene.get());
+    this->clear_history();
+}
+
+auto Editor::apply_streaming_options(vxng::scene::Scene &scene) -> void {
+    if (this->streaming_enabled)
+        scene.enable_streaming(this->residency_budget);
+    else
+        scene.disable_streaming();
 }
 
 auto Editor::set_active_tool(EditorTool *tool) -> void {
@@ -695,5 +1064,6 @@ auto Editor::make_event_bundle() -> EditorTool::EventBundle {
         .camera = &this->viewport_camera,
         .cursors = &this->cursors,
         .current_color = this->palette.get_current_color(),
+        .edit_record = &this->pending_edit,
     };
 }
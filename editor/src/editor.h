@@ -11,7 +11,13 @@
 #include <vxng/vxng.h>
 #include <webgpu/webgpu_cpp.h>
 
+#include <atomic>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 class Editor {
   public:
@@ -54,6 +60,38 @@ class Editor {
     static auto open_vox_file(void *user_data, const char *const *file_list,
                               int filter) -> void;
 
+    static const SDL_DialogFileFilter scene_filters[];
+    auto handle_save_scene_file() -> void;
+    static auto save_scene_file(void *user_data, const char *const *file_list,
+                                int filter) -> void;
+
+    // scene being built off the main thread, swapped in once done
+    typedef struct LoadJob {
+        std::thread thread;
+        std::atomic<bool> done{false};
+        std::vector<std::string> paths;
+        vxng::scene::LoadProgress progress;
+        std::unique_ptr<vxng::scene::Scene> scene;
+        // filled in before `done`. a job that threw leaves `scene` half
+        // built, so it's thrown away
+        std::vector<std::string> errors;
+        bool failed = false;
+    } LoadJob;
+    std::unique_ptr<LoadJob> load_job;
+    // errors from the last load, shown until dismissed
+    std::vector<std::string> load_errors;
+
+    // file dialog callbacks may come in on another thread
+    std::mutex pending_paths_mutex;
+    std::vector<std::string> pending_open_paths;
+    std::vector<std::string> pending_save_paths;
+
+    auto start_load_job(std::vector<std::string> paths) -> void;
+    auto poll_load_job() -> void;
+    auto run_load_progress_gui() -> void;
+    auto run_load_errors_gui() -> void;
+    static auto run_load_job(LoadJob *job) -> void;
+
     Cursors cursors;
 
     struct {
@@ -74,6 +112,23 @@ class Editor {
     glm::vec3 ambient_light_color;
     glm::vec3 background_color;
 
+    // chunk paging, applied to every scene we create or load
+    bool streaming_enabled;
+    vxng::scene::ResidencyBudget residency_budget;
+    auto apply_streaming_options(vxng::scene::Scene &scene) -> void;
+    // same goes for the distance grid
+    int distance_grid_resolution;
+
+    // undo/redo, newest at the back. edits since the last mouse up collect
+    // in pending_edit first
+    vxng::scene::EditRecord pending_edit;
+    std::deque<vxng::scene::EditRecord> undo_history;
+    std::deque<vxng::scene::EditRecord> redo_history;
+    auto commit_pending_edit() -> void;
+    auto undo() -> void;
+    auto redo() -> void;
+    auto clear_history() -> void;
+
     // menu options
     auto new_empty_scene() -> void;
 
@@ -23,6 +23,8 @@ class EditorTool {
         vxng::camera::Camera *camera;
         Cursors *cursors;
         glm::u8vec4 current_color;
+        // edits go in here, and become one undo step on mouse up
+        vxng::scene::EditRecord *edit_record;
     } EventBundle;
 
     virtual auto handle_mouse_button_event(const SDL_MouseButtonEvent &event,
@@ -7,8 +7,8 @@
 
 PaintBrush::PaintBrush()
     : DraggableTool(5.f), mode(Mode::FULL_KERNEL), size(2),
-      airbrush_strength(0.025f), brush_kernel(size), rd(), rgen(rd()),
-      rdist(0.f, 1.f) {}
+      airbrush_strength(0.025f), airbrush_falloff(false), brush_kernel(size),
+      rd(), rgen(rd()), rdist(0.f, 1.f) {}
 
 PaintBrush::~PaintBrush() {}
 
@@ -28,10 +28,15 @@ auto PaintBrush::render_ui() -> void {
     if (ImGui::SliderInt("Size", &this->size, 1, 10))
         this->brush_kernel.set_size(this->size);
 
+    const char *shape_names[] = {"Sphere", "Cube", "Cylinder"};
+    int shape = this->brush_kernel.get_shape();
+    if (ImGui::Combo("Shape", &shape, shape_names, IM_ARRAYSIZE(shape_names)))
+        this->brush_kernel.set_shape(static_cast<BrushKernel::Shape>(shape));
+
     if (this->mode == Mode::AIRBRUSH) {
-        if (ImGui::SliderFloat("Airbrush Strength", &this->airbrush_strength,
-                               0.001f, 0.025f))
-            this->brush_kernel.set_size(this->size);
+        ImGui::SliderFloat("Airbrush Strength", &this->airbrush_strength,
+                           0.001f, 0.025f);
+        ImGui::Checkbox("Falloff", &this->airbrush_falloff);
     }
 
     this->render_flow_density_ui();
@@ -91,9 +96,6 @@ auto PaintBrush::handle_drag_step(int step_idx, int total_steps,
     bool is_lmb_dragging = this->is_mousebutton_dragging(SDL_BUTTON_LEFT);
 
     if (is_lmb_dragging) {
-        // only update buffers on last drag step
-        bool skip_update_buffers = step_idx < total_steps - 1;
-
         auto mouse_ray = bundle.camera->screen_to_ray(step_mouse_ndc_coords);
         auto raycast_result = bundle.scene->raycast(mouse_ray);
         glm::vec3 target_pos =
@@ -101,49 +103,44 @@ auto PaintBrush::handle_drag_step(int step_idx, int total_steps,
         glm::vec3 interior_target_pos =
             target_pos - raycast_result.normal * 0.00001f;
 
-        stamp_paint(interior_target_pos, bundle, skip_update_buffers);
+        stamp_paint(interior_target_pos, bundle);
     }
 }
 
-auto PaintBrush::stamp_paint(glm::vec3 position, const EventBundle &bundle,
-                             bool skip_update_buffers) -> void {
-    int max_depth = std::log2(bundle.scene->get_chunk_resolution());
-    float voxel_size =
-        bundle.scene->get_chunk_scale() / bundle.scene->get_chunk_resolution();
-
-    for (auto &ioffset : this->brush_kernel.get_kernel()) {
-        glm::vec3 offset_position = position + glm::vec3(ioffset) * voxel_size;
-
-        if (this->mode == Mode::AIRBRUSH) {
-            if (!sample_airbrush_chance(1.f))
-                continue;
-        }
-
-        auto sample = bundle.scene->sample_position(offset_position);
-        if (sample.has_value() && sample.value() != bundle.current_color)
-            bundle.scene->set_voxel_filled(max_depth, offset_position,
-                                           bundle.current_color, true);
-    }
-
-    // set last guy
+auto PaintBrush::stamp_paint(glm::vec3 position, const EventBundle &bundle)
+    -> void {
+    const auto &spans = this->brush_kernel.get_spans();
+    vxng::scene::RegionEdit edit;
+    edit.operation = vxng::scene::RegionEdit::OPERATION_PAINT;
+    edit.depth = std::log2(bundle.scene->get_chunk_resolution());
+    edit.center = position;
+    edit.color = bundle.current_color;
 
     switch (this->mode) {
     case Mode::AIRBRUSH: {
-        if (sample_airbrush_chance(1.f))
-            bundle.scene->set_voxel_filled(max_depth, position,
-                                           bundle.current_color, true);
-        if (!skip_update_buffers) {
-            // ensure we always update buffers if requested
-            bundle.scene->force_update_chunk_buffers(position);
+        // a random few cells of each row
+        edit.shape = vxng::scene::RegionEdit::SHAPE_MASK;
+        for (const BrushKernel::Span &span : spans) {
+            glm::ivec3 offset = span.start;
+            for (int i = 0; i < span.length; ++i, ++offset.x) {
+                float factor = this->airbrush_falloff
+                                   ? this->brush_kernel.get_falloff(offset)
+                                   : 1.f;
+                if (sample_airbrush_chance(factor))
+                    edit.mask.push_back(offset);
+            }
         }
         break;
     }
     case Mode::FULL_KERNEL: {
-        bundle.scene->set_voxel_filled(
-            max_depth, position, bundle.current_color, skip_update_buffers);
+        edit.shape = vxng::scene::RegionEdit::SHAPE_SPANS;
+        edit.spans = spans;
         break;
     }
     }
+
+    // only recolors what's already there, so this never adds voxels
+    bundle.scene->apply_region_edit(edit, bundle.edit_record);
 }
 
 auto PaintBrush::sample_airbrush_chance(float factor) -> bool {
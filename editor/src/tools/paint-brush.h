@@ -33,6 +33,7 @@ class PaintBrush : public DraggableTool {
     Mode mode;
     int size;
     float airbrush_strength;
+    bool airbrush_falloff; // fade out towards the edge of the kernel
 
     // stamping / airbrushing
     BrushKernel brush_kernel;
@@ -44,8 +45,7 @@ class PaintBrush : public DraggableTool {
                           glm::vec2 step_mouse_ndc_coords,
                           const EventBundle &bundle) -> void override;
 
-    auto stamp_paint(glm::vec3 position, const EventBundle &bundle,
-                     bool skip_update_buffers = false) -> void;
+    auto stamp_paint(glm::vec3 position, const EventBundle &bundle) -> void;
 
     auto sample_airbrush_chance(float factor) -> bool;
 };
@@ -1,38 +1,121 @@
 #include "brush-kernel.h"
 
-BrushKernel::BrushKernel(int size) : size(size), kernel() {
+#include <algorithm>
+#include <cmath>
+
+// a row is one 64 bit word, so it can be at most 63 cells wide
+#define MAX_KERNEL_SIZE 32
+
+BrushKernel::BrushKernel(int size, Shape shape)
+    : size(std::clamp(size, 1, MAX_KERNEL_SIZE)), shape(shape), side(0),
+      rows(), spans() {
     regenerate_kernel();
 }
 BrushKernel::~BrushKernel() {}
 
 auto BrushKernel::set_size(int size) -> void {
+    size = std::clamp(size, 1, MAX_KERNEL_SIZE);
+    if (size == this->size)
+        return;
+
     this->size = size;
     regenerate_kernel();
 }
 
 auto BrushKernel::get_size() const -> int { return this->size; }
 
+auto BrushKernel::set_shape(Shape shape) -> void {
+    if (shape == this->shape)
+        return;
+
+    this->shape = shape;
+    regenerate_kernel();
+}
+
+auto BrushKernel::get_shape() const -> Shape { return this->shape; }
+
 auto BrushKernel::sample(glm::ivec3 pos) const -> bool {
-    auto kernel_result = this->kernel.find(pos);
-    // true if we found coord in the kernel
-    return kernel_result != this->kernel.end();
+    glm::ivec3 cell = pos + glm::ivec3(this->size - 1);
+    if (glm::any(glm::lessThan(cell, glm::ivec3(0))) ||
+        glm::any(glm::greaterThanEqual(cell, glm::ivec3(this->side))))
+        return false;
+
+    uint64_t row = this->rows[cell.z * this->side + cell.y];
+    return (row >> cell.x) & 1u;
 }
 
-auto BrushKernel::get_kernel() const -> const std::unordered_set<glm::ivec3> & {
-    return this->kernel;
+auto BrushKernel::get_falloff(glm::ivec3 pos) const -> float {
+    if (!sample(pos))
+        return 0.f;
+
+    // distance to the center relative to the shape's extent that way, so
+    // every shape fades out right at its edge
+    float radius = this->size - 0.5f;
+    glm::vec3 p = glm::abs(glm::vec3(pos));
+    float distance = 0.f;
+    switch (this->shape) {
+    case Shape::SPHERE:
+        distance = glm::length(p);
+        break;
+    case Shape::CUBE:
+        distance = std::max(std::max(p.x, p.y), p.z);
+        break;
+    case Shape::CYLINDER:
+        distance = std::max(glm::length(glm::vec2(p.x, p.z)), p.y);
+        break;
+    }
+    return std::clamp(1.f - distance / radius, 0.f, 1.f);
+}
+
+auto BrushKernel::get_spans() const -> const std::vector<Span> & {
+    return this->spans;
 }
 
 auto BrushKernel::regenerate_kernel() -> void {
-    this->kernel.clear();
-
-    int iter_start = -this->size + 1;
-    for (int x = iter_start; x < this->size; ++x) {
-        for (int y = iter_start; y < this->size; ++y) {
-            for (int z = iter_start; z < this->size; ++z) {
-                float magnitude = glm::sqrt(x * x + y * y + z * z);
-                if (magnitude < (this->size - 0.5f))
-                    this->kernel.insert(glm::ivec3(x, y, z));
-            }
+    int reach = this->size - 1;
+    this->side = 2 * this->size - 1;
+    this->rows.assign(this->side * this->side, 0);
+    this->spans.clear();
+
+    // every shape is convex, so each row is a single run we can solve for
+    // directly instead of testing cell by cell
+    for (int z = -reach; z <= reach; ++z) {
+        for (int y = -reach; y <= reach; ++y) {
+            int row_reach = get_row_reach(y, z);
+            if (row_reach < 0)
+                continue;
+
+            int length = 2 * row_reach + 1;
+            uint64_t bits = length == 64 ? ~0ull : (1ull << length) - 1;
+            this->rows[(z + reach) * this->side + (y + reach)] =
+                bits << (reach - row_reach);
+
+            this->spans.push_back({glm::ivec3(-row_reach, y, z), length});
         }
     }
 }
+
+auto BrushKernel::get_row_reach(int y, int z) const -> int {
+    // cells count if their center is strictly inside a ball of this radius,
+    // which is what the original sphere kernel did
+    float radius = this->size - 0.5f;
+    int reach = this->size - 1;
+
+    // largest |x| with x * x < limit
+    auto solve = [reach](float limit) {
+        if (limit <= 0.f)
+            return -1;
+        return std::min(static_cast<int>(std::ceil(std::sqrt(limit))) - 1,
+                        reach);
+    };
+
+    switch (this->shape) {
+    case Shape::SPHERE:
+        return solve(radius * radius - static_cast<float>(y * y + z * z));
+    case Shape::CUBE:
+        return reach;
+    case Shape::CYLINDER:
+        return solve(radius * radius - static_cast<float>(z * z));
+    }
+    return -1;
+}
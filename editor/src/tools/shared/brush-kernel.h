@@ -1,24 +1,57 @@
 #pragma once
 
 #include <glm/glm.hpp>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include <vxng/scene.h>
 
-#include <unordered_set>
+#include <cstdint>
+#include <vector>
 
+/**
+ * The set of voxel offsets a brush covers, centered on (0, 0, 0) and reaching
+ * `size - 1` voxels out along each axis. Stored as a dense bit mask, one 64-bit
+ * word per x row, alongside the runs of set bits in each row, so sampling is a
+ * shift and iterating never touches a cell outside the shape. The runs go
+ * straight into a `RegionEdit` to stamp the brush.
+ */
 class BrushKernel {
   public:
-    BrushKernel(int size);
+    typedef enum Shape {
+        SPHERE,
+        CUBE,
+        CYLINDER, // upright, i.e. round in x/z and flat along y
+    } Shape;
+
+    /** Consecutive kernel cells along +x, starting at `start` */
+    typedef vxng::scene::RegionEdit::Span Span;
+
+    BrushKernel(int size, Shape shape = Shape::SPHERE);
     ~BrushKernel();
 
+    /** Clamped to [1, 32], so each row fits in a single word */
     auto set_size(int size) -> void;
     auto get_size() const -> int;
+    auto set_shape(Shape shape) -> void;
+    auto get_shape() const -> Shape;
+
     auto sample(glm::ivec3 pos) const -> bool;
-    auto get_kernel() const -> const std::unordered_set<glm::ivec3> &;
+    /**
+     * How strongly the brush applies at `pos`: 1 in the middle, fading out to
+     * 0 at the edge of the shape (and beyond it)
+     */
+    auto get_falloff(glm::ivec3 pos) const -> float;
+
+    /** Every non-empty row of the kernel, in z, y order */
+    auto get_spans() const -> const std::vector<Span> &;
 
   private:
     int size;
-    std::unordered_set<glm::ivec3> kernel;
+    Shape shape;
+
+    int side;                   // 2 * size - 1
+    std::vector<uint64_t> rows; // bit x + size - 1 of row (y, z)
+    std::vector<Span> spans;
 
     auto regenerate_kernel() -> void;
+    /** Largest |x| in the kernel along row (y, z), -1 if the row is empty */
+    auto get_row_reach(int y, int z) const -> int;
 };
@@ -21,9 +21,14 @@ auto VoxelBrush::render_ui() -> void {
                            this->current_mode == Mode::CAMERA_PLANE))
         this->current_mode = Mode::CAMERA_PLANE;
 
-    if (ImGui::SliderInt("Size", &this->size, 1, 5))
+    if (ImGui::SliderInt("Size", &this->size, 1, 10))
         this->brush_kernel.set_size(this->size);
 
+    const char *shape_names[] = {"Sphere", "Cube", "Cylinder"};
+    int shape = this->brush_kernel.get_shape();
+    if (ImGui::Combo("Shape", &shape, shape_names, IM_ARRAYSIZE(shape_names)))
+        this->brush_kernel.set_shape(static_cast<BrushKernel::Shape>(shape));
+
     ImGui::SliderInt("Depth", &this->depth, 0, 9);
     this->render_flow_density_ui();
 }
@@ -109,8 +114,6 @@ auto VoxelBrush::handle_drag_step(int step_idx, int total_steps,
     bool is_rmb_dragging = this->is_mousebutton_dragging(SDL_BUTTON_RIGHT);
 
     if (is_lmb_dragging || is_rmb_dragging) {
-        bool skip_update_buffers = step_idx < total_steps - 1;
-
         auto mouse_ray = bundle.camera->screen_to_ray(step_mouse_ndc_coords);
 
         // project mouse ray onto plane defined by plane_normal
@@ -128,36 +131,24 @@ auto VoxelBrush::handle_drag_step(int step_idx, int total_steps,
                 StampMode stamp_mode =
                     (is_lmb_dragging) ? StampMode::PLACE : StampMode::DELETE;
                 // add/remove voxels
-                stamp_brush(stamp_mode, intersection, bundle,
-                            skip_update_buffers);
+                stamp_brush(stamp_mode, intersection, bundle);
             }
         }
     }
 }
 
 auto VoxelBrush::stamp_brush(StampMode mode, glm::vec3 position,
-                             const EventBundle &bundle,
-                             bool skip_update_buffers) -> void {
-    float voxel_size =
-        bundle.scene->get_chunk_scale() / (float)(1u << this->depth);
-
-    for (auto &ioffset : this->brush_kernel.get_kernel()) {
-        if (mode == StampMode::PLACE) {
-            bundle.scene->set_voxel_filled(
-                this->depth, position + glm::vec3(ioffset) * voxel_size,
-                bundle.current_color, true);
-        } else {
-            bundle.scene->set_voxel_empty(
-                this->depth, position + glm::vec3(ioffset) * voxel_size, true);
-        }
-    }
-
-    // set base node
-    if (mode == StampMode::PLACE) {
-        bundle.scene->set_voxel_filled(
-            this->depth, position, bundle.current_color, skip_update_buffers);
-    } else {
-        bundle.scene->set_voxel_empty(this->depth, position,
-                                      skip_update_buffers);
-    }
+                             const EventBundle &bundle) -> void {
+    // the whole kernel goes in as one region, so each chunk is walked once
+    vxng::scene::RegionEdit edit;
+    edit.shape = vxng::scene::RegionEdit::SHAPE_SPANS;
+    edit.operation = mode == StampMode::PLACE
+                         ? vxng::scene::RegionEdit::OPERATION_FILL
+                         : vxng::scene::RegionEdit::OPERATION_ERASE;
+    edit.depth = this->depth;
+    edit.center = position;
+    edit.color = bundle.current_color;
+    edit.spans = this->brush_kernel.get_spans();
+
+    bundle.scene->apply_region_edit(edit, bundle.edit_record);
 }
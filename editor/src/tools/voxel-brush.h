@@ -47,6 +47,5 @@ class VoxelBrush : public DraggableTool {
                           const EventBundle &bundle) -> void override;
 
     auto stamp_brush(StampMode mode, glm::vec3 position,
-                     const EventBundle &bundle,
-                     bool skip_update_buffers = false) -> void;
+                     const EventBundle &bundle) -> void;
 };
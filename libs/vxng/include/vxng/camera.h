@@ -22,11 +22,23 @@ class Camera {
     /** Creates world-space ray based on an NDC screen position */
     auto screen_to_ray(glm::vec2 screen_pos) const -> geometry::Ray;
     auto get_forward() const -> glm::vec3;
+    auto get_position() const -> glm::vec3;
+    /** World-to-camera, as uploaded to the shader */
+    auto get_view_matrix() const -> glm::mat4;
+
+    /**
+     * Conservative frustum test: false only if the box is entirely outside one
+     * of the side planes. Near/far planes are ignored, since the side planes
+     * already rule out anything behind us.
+     */
+    auto is_visible(const geometry::AABB &aabb) const -> bool;
 
     /** Updates the aspect ratio (width / height) for screen-to-ray conversion
      */
     auto set_aspect_ratio(float aspect_ratio) -> void;
     auto get_aspect_ratio() const -> float;
+    /** Vertical field of view, in radians */
+    auto get_fovy() const -> float;
 
   protected:
     Camera(glm::vec3 position, glm::mat3 rotation, float fovy_rad);
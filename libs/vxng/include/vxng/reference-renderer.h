@@ -0,0 +1,61 @@
+#pragma once
+
+#include "vxng/camera.h"
+#include "vxng/scene.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace vxng {
+
+typedef struct Image {
+    int width;
+    int height;
+    std::vector<glm::u8vec4> pixels; // RGBA, rows top to bottom
+    std::vector<float> depths; // t of each pixel's hit, infinity if none
+    uint64_t traversal_steps;        // summed over all rays, to compare cost
+} Image;
+
+/**
+ * Renders a scene on the CPU, tracing the same packed nodes the GPU gets
+ * (leaf masks and LOD averages included) and lighting them like the chunk
+ * shader does. Useful as a reference to check the
+ * shader against, and for previews where there's no GPU at all.
+ *
+ * Work is split into screen tiles across the shared thread pool.
+ */
+class ReferenceRenderer {
+  public:
+    ReferenceRenderer();
+    ~ReferenceRenderer();
+
+    auto set_light_dir(glm::vec3 light_dir) -> void;
+    auto set_dirlight_color(glm::vec3 color) -> void;
+    auto set_ambient_color(glm::vec3 color) -> void;
+    auto set_background_color(glm::vec3 color) -> void;
+    /** Same as `Renderer::set_lod_threshold`, 0 (the default) for none */
+    auto set_lod_threshold(float pixels) -> void;
+
+    /**
+     * Traces one ray per pixel through every resident chunk. The image keeps
+     * the camera's vertical fov, with its aspect ratio set by `width` and
+     * `height`.
+     *
+     * The scene isn't const since each chunk is first brought up to date the
+     * way a buffer update would: pending edits serialized, and its distance
+     * grid patched.
+     */
+    auto render(scene::Scene &scene, const camera::Camera &camera, int width,
+                int height) const -> Image;
+
+  private:
+    glm::vec3 light_dir;
+    glm::vec3 dirlight_color;
+    glm::vec3 ambient_color;
+    glm::vec3 background_color;
+    float lod_threshold;
+};
+
+} // namespace vxng
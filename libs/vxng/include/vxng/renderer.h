@@ -5,6 +5,12 @@
 
 #include <webgpu/webgpu_cpp.h>
 
+#include <memory>
+
+namespace vxng::scene {
+class ChunkGrid;
+}
+
 namespace vxng {
 
 /**
@@ -12,23 +18,98 @@ namespace vxng {
  */
 class Renderer {
   public:
+    /** Octree traversal kernels the chunk shader can be built with */
+    typedef enum Traversal {
+        TRAVERSAL_STACK,      // per-child AABB tests, bounds on a stack
+        TRAVERSAL_PARAMETRIC, // t-spans from precomputed coefficients
+    } Traversal;
+
     Renderer();
     ~Renderer();
 
     /** Sets up program + shader bindings */
     auto init_webgpu(wgpu::Device device) -> bool;
-    auto get_depth_texture_view() const -> wgpu::TextureView;
     auto resize(int width, int height) -> void;
     auto set_light_dir(glm::vec3 light_dir) -> void;
     auto set_dirlight_color(glm::vec3 color) -> void;
     auto set_ambient_color(glm::vec3 color) -> void;
+    /**
+     * Nodes that would cover fewer than this many pixels on screen are drawn
+     * as a single voxel of their average color instead of being traversed,
+     * which trades detail in the distance for speed. 0 turns this off.
+     */
+    auto set_lod_threshold(float pixels) -> void;
+    auto get_lod_threshold() const -> float;
     auto set_background_color(glm::vec3 color) -> void;
     auto set_scene(vxng::scene::Scene const *scene) -> void;
     auto set_active_camera(const vxng::camera::Camera *camera) -> void;
-    auto render(wgpu::RenderPassEncoder &render_pass) const -> void;
+
+    /**
+     * Draws the scene into `target`, clearing it to the background color.
+     * Chunks outside the view are culled and the rest sorted front to back.
+     * The nearest few are drawn first as occluders; every other chunk's
+     * fragments then check their entry depth against those before traversing
+     * anything, so hidden chunks cost next to nothing.
+     *
+     * With the beam prepass on, a low resolution pass first finds how near
+     * anything could be hit in each tile of pixels, and fragments start
+     * traversal from there (or skip empty tiles altogether).
+     *
+     * In single pass mode the whole scene is instead drawn with one
+     * fullscreen triangle, whose rays step through a grid of chunks, falling
+     * back to the above if the scene doesn't fit in one.
+     */
+    auto render(wgpu::CommandEncoder &encoder, wgpu::TextureView target) const
+        -> void;
+
+    /**
+     * Switches traversal kernels, rebuilding the pipeline if we're already
+     * initialized. Both render the same image, so this is for comparing them.
+     *
+     * @return false if the new pipeline couldn't be created
+     */
+    auto set_traversal(Traversal traversal) -> bool;
+    auto get_traversal() const -> Traversal;
+
+    /**
+     * Turns the beam prepass on or off, rebuilding the pipelines if we're
+     * already initialized. Also renders the same image either way.
+     *
+     * @return false if the new pipelines couldn't be created
+     */
+    auto set_beam_prepass(bool enabled) -> bool;
+    auto is_beam_prepass() const -> bool;
+
+    /**
+     * Switches between drawing each chunk's cube and marching every pixel
+     * through one scene-wide chunk grid, which never traverses a pixel more
+     * than once. The same image either way, since both read the same nodes
+     * out of the scene's chunk pool.
+     */
+    auto set_single_pass(bool enabled) -> void;
+    auto is_single_pass() const -> bool;
 
   private:
     auto create_depth_texture(int width, int height) -> void;
+    /** Destroys `previous`, making a depth texture of `size` and view */
+    auto create_depth_target(const char *label, glm::uvec2 size,
+                             wgpu::TextureUsage extra_usage,
+                             wgpu::Texture previous, wgpu::TextureView &view)
+        -> wgpu::Texture;
+    /** Bind group for reading a depth texture (and the beams) as group 3 */
+    auto create_depth_bind_group(wgpu::TextureView view) -> wgpu::BindGroup;
+
+    /**
+     * (Re)creates both render pipelines, with and without the occlusion test,
+     * with the current traversal kernel
+     */
+    auto create_render_pipelines() -> bool;
+    auto create_render_pipeline(bool occlusion_test) -> wgpu::RenderPipeline;
+    auto create_beam_pipeline() -> wgpu::RenderPipeline;
+    auto create_scene_pipeline() -> wgpu::RenderPipeline;
+    /** Draws the chunk grid over a cleared `target` */
+    auto render_single_pass(wgpu::CommandEncoder &encoder,
+                            wgpu::TextureView target) const -> void;
 
     struct {
         bool initialized;
@@ -37,19 +118,39 @@ class Renderer {
         wgpu::Buffer globals_uniforms_buffer;
         wgpu::BindGroupLayout globals_bind_group_layout;
         wgpu::BindGroupLayout camera_bind_group_layout;
+        wgpu::BindGroupLayout occluder_bind_group_layout;
         wgpu::BindGroup globals_bind_group;
         wgpu::BindGroup camera_bind_group;
         wgpu::ShaderModule shader_module;
         wgpu::PipelineLayout pipeline_layout;
+        wgpu::PipelineLayout beam_pipeline_layout; // without group 3
+        wgpu::PipelineLayout scene_pipeline_layout; // chunk grid as group 2
         wgpu::RenderPipeline render_pipeline;
+        wgpu::RenderPipeline occlusion_tested_pipeline;
+        wgpu::RenderPipeline beam_pipeline;
+        wgpu::RenderPipeline scene_pipeline;
+        wgpu::Texture occluder_depth_texture;
+        wgpu::TextureView occluder_depth_texture_view;
+        wgpu::BindGroup occluder_bind_group; // samples the occluder depth
         wgpu::Texture depth_texture;
         wgpu::TextureView depth_texture_view;
+        wgpu::BindGroup depth_bind_group; // placeholder for the occluder pass
+        wgpu::Texture beam_depth_texture; // a texel per tile
+        wgpu::TextureView beam_depth_texture_view;
     } wgpu;
 
     const vxng::camera::Camera *active_camera;
     const vxng::scene::Scene *active_scene;
 
     glm::vec3 background_color;
+    Traversal traversal;
+    bool beam_prepass;
+    float lod_threshold;
+    bool single_pass;
+    // a cache of the scene, brought up to date as we render, hence behind a
+    // pointer
+    std::unique_ptr<scene::ChunkGrid> chunk_grid;
+    glm::uvec2 depth_size;
 };
 
 } // namespace vxng
@@ -8,13 +8,110 @@
 #include <glm/gtx/hash.hpp>
 #include <webgpu/webgpu_cpp.h>
 
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <optional>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace vxng::scene {
 
 class Chunk;
+class ChunkPager;
+class GPUChunkPool;
+
+/**
+ * Counters a long-running load can be watched through from another thread.
+ * Totals may keep growing while loading, e.g. as more models are found.
+ */
+typedef struct LoadProgress {
+    std::atomic<size_t> bytes_total{0};
+    std::atomic<size_t> bytes_parsed{0};
+    std::atomic<size_t> voxels_total{0};
+    std::atomic<size_t> voxels_inserted{0};
+    std::atomic<size_t> chunks_total{0};
+    std::atomic<size_t> chunks_built{0};
+
+    /** Rough overall completion in [0, 1], weighted by phase */
+    auto get_fraction() const -> float;
+} LoadProgress;
+
+/** Limits for streaming chunks in and out around a focus point */
+typedef struct ResidencyBudget {
+    float radius = 256.f;              // world units kept paged in
+    size_t max_cpu_bytes = 512 << 20;  // editable octrees, spilled past this
+    size_t max_gpu_bytes = 1024 << 20; // chunk buffers, released past this
+} ResidencyBudget;
+
+/**
+ * A brush-like edit over many voxels at once, see `Scene::apply_region_edit`.
+ * Offsets are counted in voxels from the one containing `center`.
+ */
+typedef struct RegionEdit {
+    typedef enum Shape {
+        SHAPE_SPHERE, // offsets shorter than `radius`
+        SHAPE_BOX,    // offsets within `half_size` on every axis
+        SHAPE_MASK,   // exactly the offsets in `mask`
+        SHAPE_SPANS,  // the rows in `spans`
+    } Shape;
+    typedef enum Operation {
+        OPERATION_FILL,
+        OPERATION_ERASE,
+        OPERATION_PAINT, // recolors whatever is already filled
+    } Operation;
+
+    /** `length` consecutive offsets along +x, starting at `start` */
+    typedef struct Span {
+        glm::ivec3 start;
+        int length;
+    } Span;
+
+    Shape shape = SHAPE_SPHERE;
+    Operation operation = OPERATION_FILL;
+    int depth = 0; // voxels are chunk_scale / 2^depth across
+    glm::vec3 center = glm::vec3(0.f);
+    glm::u8vec4 color = glm::u8vec4(0);
+
+    float radius = 1.f;
+    glm::ivec3 half_size = glm::ivec3(0);
+    std::vector<glm::ivec3> mask;
+    std::vector<Span> spans;
+} RegionEdit;
+
+/**
+ * What region edits overwrote: the previous contents of just the voxel cells
+ * they touched, each as a compact subtree. Swapping a record into the scene
+ * puts those cells back and leaves it holding what the edits wrote, so
+ * swapping it again redoes them. Both the memory and the work scale with the
+ * edits, never with the size of the chunks they hit.
+ */
+typedef struct EditRecord {
+    typedef struct ChunkCells {
+        glm::ivec3 chunk_coord;
+        int depth;
+        // morton code of each cell, with where its subtree starts in
+        // `tokens`, sorted by code
+        std::vector<std::pair<uint64_t, uint32_t>> cells;
+        std::vector<uint32_t> tokens; // preorder, see `Chunk::capture_cells`
+    } ChunkCells;
+
+    std::vector<ChunkCells> chunks;
+
+    auto is_empty() const -> bool;
+    auto get_memory_usage() const -> size_t;
+} EditRecord;
+
+typedef struct ResidencyStats {
+    size_t resident_chunks; // in memory, editable or frozen
+    size_t gpu_chunks;      // resident with buffers, i.e. being rendered
+    size_t stored_chunks;   // only on disk
+    size_t cpu_bytes;
+    size_t gpu_bytes;
+} ResidencyStats;
 
 class Scene {
   public:
@@ -29,13 +126,53 @@ class Scene {
     auto sample_position(glm::vec3 position) const
         -> std::optional<glm::u8vec4>;
     auto raycast(const geometry::Ray &ray) const -> geometry::RaycastResult;
+    /**
+     * Same results as calling `raycast` on each ray, but much cheaper per ray
+     * for batches of similar rays (e.g. a brush footprint or picking a
+     * region). Rays are cast in packets that cull and order chunks together,
+     * then walk each chunk's octree together, spread across the shared
+     * thread pool.
+     */
+    auto raycast_many(const std::vector<geometry::Ray> &rays) const
+        -> std::vector<geometry::RaycastResult>;
 
-    auto set_voxel_filled(int depth, glm::vec3 position, glm::u8vec4 color,
-                          bool skip_update_buffers = false) -> void;
-    auto set_voxel_empty(int depth, glm::vec3 position,
-                         bool skip_update_buffers = false) -> void;
+    /**
+     * Edits only queue their chunk's buffer update, which happens on the next
+     * `flush_chunk_buffers`, so any number of edits in a frame cost one
+     * upload per chunk.
+     */
+    auto set_voxel_filled(int depth, glm::vec3 position, glm::u8vec4 color)
+        -> void;
+    auto set_voxel_empty(int depth, glm::vec3 position) -> void;
+    /**
+     * Applies an edit to every voxel in a region in one go. Voxels are grouped
+     * by chunk, and each chunk's octree is walked once for the whole group,
+     * merging uniform subtrees on the way back up, instead of digging and
+     * relaxing once per voxel. Fills create chunks as needed; erasing and
+     * painting leave missing chunks alone. Every chunk touched is queued for
+     * the next `flush_chunk_buffers`.
+     *
+     * @param record  Optional, gets whatever the edit overwrites. Cells
+     *                already in the record keep their first capture, so one
+     *                record can collect a whole brush stroke.
+     */
+    auto apply_region_edit(const RegionEdit &edit,
+                           EditRecord *record = nullptr) -> void;
+    /**
+     * Writes a record's cells back into the scene, swapping in what they held
+     * before. Undoes the recorded edits, or redoes them if already undone.
+     */
+    auto swap_edit_record(EditRecord &record) -> void;
     auto force_update_chunk_buffers(glm::vec3 position) -> void;
 
+    /**
+     * Re-serializes every chunk edited since the last call, spread across the
+     * shared thread pool, then uploads the changes from the calling thread.
+     * Also shrinks chunk buffers left mostly empty since. Meant to be called
+     * once a frame, before rendering.
+     */
+    auto flush_chunk_buffers() -> void;
+
     // --------- Utility ---------
 
     auto get_chunk_scale() const -> float;
@@ -44,9 +181,23 @@ class Scene {
 
     // --------- Rendering ---------
 
+    /**
+     * Chunks keep a `resolution`^3 grid of distances to their nearest
+     * occupied cell, which rays use to jump over empty space before walking
+     * the octree. Costs a byte per cell per chunk on the GPU, and the same on
+     * the CPU for chunks with buffers that have been edited or uploaded.
+     *
+     * @param resolution  0 to turn it off, or a power of 2 from 2 to 64, no
+     *                    finer than the chunk resolution
+     */
+    auto set_distance_grid_resolution(int resolution) -> void;
+    auto get_distance_grid_resolution() const -> int;
+
     /** Internal method, for renderer to render chunks */
     auto get_chunks() const
         -> const std::unordered_map<glm::ivec3, std::unique_ptr<Chunk>> &;
+    /** Internal method, for renderer to bind every chunk's buffers at once */
+    auto get_chunk_pool() const -> const GPUChunkPool *;
 
     // --------- Scene setup helpers ---------
 
@@ -56,12 +207,91 @@ class Scene {
     auto fill_basic_plane(glm::u8vec4 color) -> void;
     auto fill_center_cubes(int depth, glm::u8vec4 color) -> void;
 
-    auto load_vox_file(const std::vector<uint8_t> &buffer) -> void;
+    /**
+     * Imports every visible instance of a MagicaVoxel scene, placed by its
+     * instance transform and split across however many chunks it covers.
+     * Models are transformed and chunk octrees built on the shared thread
+     * pool. WebGPU is only touched on the calling thread, once at the end (and
+     * not at all if `init_webgpu` hasn't been called yet), so a scene without
+     * a device can be loaded entirely off the main thread.
+     *
+     * @param progress  Optional counters to update as we go
+     */
+    auto load_vox_file(const std::vector<uint8_t> &buffer,
+                       LoadProgress *progress = nullptr) -> void;
+
+    // --------- Native files ---------
+
+    /**
+     * Writes the scene in our own format: each chunk's octree in GPU layout,
+     * plus an index of chunk coords. Nothing is re-encoded, so this is as fast
+     * as the disk allows.
+     *
+     * @return false (after logging) if the file couldn't be written
+     */
+    auto save_file(const std::string &path) -> bool;
+
+    /**
+     * Memory-maps a file written by `save_file`. Chunk arrays are handed to
+     * the GPU straight out of the mapping, and no octree nodes are built until
+     * a chunk is first edited. Chunks already at a loaded coord are replaced.
+     *
+     * @return false (after logging) if the file is missing or malformed
+     */
+    auto load_file(const std::string &path, LoadProgress *progress = nullptr)
+        -> bool;
+
+    /**
+     * Freezes every resident chunk into a sparse voxel DAG, where identical
+     * subtrees (walls, floors, repeated props) are stored once, shrinking both
+     * memory and GPU buffers. Chunks thaw back into editable octrees on their
+     * next edit. Saving afterwards writes the compressed arrays as-is.
+     */
+    auto compress_chunks() -> void;
+
+    // --------- Streaming ---------
+
+    /**
+     * Turns on chunk paging: from now on `update_residency` keeps chunks near
+     * the focus resident and pushes the rest out to disk under the budget.
+     * Chunks loaded with `load_file` start out on disk, only coming in once
+     * they're in range. Can be called again to change the budget.
+     */
+    auto enable_streaming(const ResidencyBudget &budget) -> void;
+    /** Brings every paged out chunk back in, then stops paging */
+    auto disable_streaming() -> void;
+    auto is_streaming() const -> bool;
+
+    /**
+     * Pages chunks in and out around `focus`. Meant to be called once a frame,
+     * on the same thread as everything else; disk reads happen on the shared
+     * thread pool, and their results are picked up on later calls.
+     *
+     * Chunks out of range (or farthest away, once over budget) lose their GPU
+     * buffers first. Edited chunks over the CPU budget are compressed, written
+     * to spill files and mapped back, and out-of-range chunks that only live on disk
+     * are dropped from memory entirely.
+     */
+    auto update_residency(glm::vec3 focus) -> void;
+    /** As of the last `update_residency` */
+    auto get_residency_stats() const -> ResidencyStats;
 
   private:
     float chunk_scale;
     int chunk_resolution;
+
+    // declared before `chunks` so it outlives any chunk mapping its files
+    std::unique_ptr<ChunkPager> pager;
+    ResidencyBudget residency_budget;
+    ResidencyStats residency_stats;
+    // where every chunk's buffers live, null until we have a device. also
+    // declared before `chunks`, which give their entries back as they go
+    std::unique_ptr<GPUChunkPool> chunk_pool;
+    int distance_grid_resolution; // 0 if off
+
     std::unordered_map<glm::ivec3, std::unique_ptr<Chunk>> chunks;
+    // edited since the last `flush_chunk_buffers`
+    std::unordered_set<glm::ivec3> stale_chunks;
 
     typedef struct ChunkedLocationInfo {
         glm::ivec3 chunk_coord;
@@ -76,13 +306,22 @@ class Scene {
         -> ChunkedLocationInfo;
 
     /**
-     * Instantiates chunk (and runs webgpu init) at given coords if chunk is not
-     * yet instantiated.
+     * Instantiates chunk (and runs webgpu init, if we have a device) at given
+     * coords if chunk is not yet instantiated.
      *
      * @return pointer to the new or existing chunk.
      */
     auto touch_chunk(glm::ivec3 chunk_coord) -> Chunk *;
 
+    /** Instantiates a chunk without any webgpu setup. Chunk must not exist. */
+    auto create_chunk(glm::ivec3 chunk_coord) -> Chunk *;
+
+    /**
+     * Returns the resident chunk at given coords, first bringing it in from
+     * disk if it's been paged out. Null if there's no such chunk at all.
+     */
+    auto page_in_chunk(glm::ivec3 chunk_coord) -> Chunk *;
+
     struct {
         wgpu::Device device;
     } wgpu;
@@ -2,8 +2,9 @@
 
 // This primary file exports all public headers
 
-#include "camera.h"       // IWYU pragma: export
-#include "geometry.h"     // IWYU pragma: export
-#include "orbit-camera.h" // IWYU pragma: export
-#include "renderer.h"     // IWYU pragma: export
-#include "scene.h"        // IWYU pragma: export
+#include "camera.h"             // IWYU pragma: export
+#include "geometry.h"           // IWYU pragma: export
+#include "orbit-camera.h"       // IWYU pragma: export
+#include "reference-renderer.h" // IWYU pragma: export
+#include "renderer.h"           // IWYU pragma: export
+#include "scene.h"              // IWYU pragma: export
@@ -45,7 +45,7 @@ auto Camera::update_webgpu() -> void {
     // compute model matrix and inverse
     glm::mat4 inv_view = glm::mat4(this->rotation);
     inv_view[3] = glm::vec4(this->position, 1.0f);
-    glm::mat4 view = glm::inverse(inv_view);
+    glm::mat4 view = get_view_matrix();
 
     // upload our data to GPU side
     wgpu::Queue queue = this->wgpu.device.GetQueue();
@@ -77,10 +77,46 @@ auto Camera::screen_to_ray(glm::vec2 screen_pos) const -> geometry::Ray {
 
 auto Camera::get_forward() const -> glm::vec3 { return -this->rotation[2]; }
 
+auto Camera::get_position() const -> glm::vec3 { return this->position; }
+
+auto Camera::get_view_matrix() const -> glm::mat4 {
+    glm::mat4 inv_view = glm::mat4(this->rotation);
+    inv_view[3] = glm::vec4(this->position, 1.0f);
+    return glm::inverse(inv_view);
+}
+
+auto Camera::is_visible(const geometry::AABB &aabb) const -> bool {
+    float tan_half_fovy = glm::tan(this->fovy_rad * 0.5f);
+    float tan_half_fovx = tan_half_fovy * this->aspect_ratio;
+
+    // inward side plane normals in camera space (looking down -z), all planes
+    // going through the camera position
+    glm::vec3 normals[4] = {
+        {-1.f, 0.f, -tan_half_fovx}, // right
+        {1.f, 0.f, -tan_half_fovx},  // left
+        {0.f, -1.f, -tan_half_fovy}, // top
+        {0.f, 1.f, -tan_half_fovy},  // bottom
+    };
+
+    for (glm::vec3 camera_normal : normals) {
+        glm::vec3 normal = this->rotation * camera_normal;
+
+        // corner furthest along the normal, if even that's outside we're out
+        glm::vec3 corner(normal.x > 0.f ? aabb.max.x : aabb.min.x,
+                         normal.y > 0.f ? aabb.max.y : aabb.min.y,
+                         normal.z > 0.f ? aabb.max.z : aabb.min.z);
+        if (glm::dot(normal, corner - this->position) < 0.f)
+            return false;
+    }
+    return true;
+}
+
 auto Camera::set_aspect_ratio(float aspect_ratio) -> void {
     this->aspect_ratio = aspect_ratio;
 }
 
 auto Camera::get_aspect_ratio() const -> float { return this->aspect_ratio; }
 
+auto Camera::get_fovy() const -> float { return this->fovy_rad; }
+
 } // namespace vxng::camera
@@ -0,0 +1,104 @@
+#include "mapped-file.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vxng {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+    : data(nullptr), size(0), file_handle(INVALID_HANDLE_VALUE),
+      mapping_handle(nullptr) {}
+
+MappedFile::~MappedFile() {
+    if (this->data)
+        UnmapViewOfFile(this->data);
+    if (this->mapping_handle)
+        CloseHandle(this->mapping_handle);
+    if (this->file_handle != INVALID_HANDLE_VALUE)
+        CloseHandle(this->file_handle);
+}
+
+auto MappedFile::open(const std::string &path) -> std::shared_ptr<MappedFile> {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+
+    file->file_handle =
+        CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file->file_handle == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to open file: '" << path << "'" << std::endl;
+        return nullptr;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->file_handle, &size) || size.QuadPart == 0) {
+        std::cerr << "Failed to size file: '" << path << "'" << std::endl;
+        return nullptr;
+    }
+    file->size = static_cast<size_t>(size.QuadPart);
+
+    file->mapping_handle = CreateFileMappingA(file->file_handle, nullptr,
+                                              PAGE_READONLY, 0, 0, nullptr);
+    if (file->mapping_handle)
+        file->data = static_cast<const uint8_t *>(
+            MapViewOfFile(file->mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (!file->data) {
+        std::cerr << "Failed to map file: '" << path << "'" << std::endl;
+        return nullptr;
+    }
+
+    return file;
+}
+
+#else
+
+MappedFile::MappedFile() : data(nullptr), size(0) {}
+
+MappedFile::~MappedFile() {
+    if (this->data)
+        munmap(const_cast<uint8_t *>(this->data), this->size);
+}
+
+auto MappedFile::open(const std::string &path) -> std::shared_ptr<MappedFile> {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open file: '" << path << "'" << std::endl;
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        std::cerr << "Failed to size file: '" << path << "'" << std::endl;
+        close(fd);
+        return nullptr;
+    }
+    file->size = static_cast<size_t>(info.st_size);
+
+    // the mapping stays valid after the descriptor is closed
+    void *mapped = mmap(nullptr, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Failed to map file: '" << path << "'" << std::endl;
+        return nullptr;
+    }
+    file->data = static_cast<const uint8_t *>(mapped);
+
+    return file;
+}
+
+#endif
+
+} // namespace vxng
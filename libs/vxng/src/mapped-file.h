@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace vxng {
+
+/**
+ * Read-only memory mapping of a whole file. Pages are pulled in by the OS as
+ * they're touched, so large files can be opened without reading them up front.
+ */
+class MappedFile {
+  public:
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /** Maps the file at `path`, or logs and returns null on failure */
+    static auto open(const std::string &path) -> std::shared_ptr<MappedFile>;
+
+    auto get_data() const -> const uint8_t * { return this->data; }
+    auto get_size() const -> size_t { return this->size; }
+
+  private:
+    MappedFile();
+
+    const uint8_t *data;
+    size_t size;
+#ifdef _WIN32
+    void *file_handle;
+    void *mapping_handle;
+#endif
+};
+
+} // namespace vxng
@@ -0,0 +1,198 @@
+#include "vxng/reference-renderer.h"
+
+#include "scene/chunk.h"
+#include "scene/octree-cast.h"
+#include "thread-pool.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+// pixels per tile side, tiles being both the unit of work and of culling
+#define TILE_SIZE 16
+
+namespace vxng {
+
+ReferenceRenderer::ReferenceRenderer()
+    : light_dir(0.f, 1.f, 0.f), dirlight_color(1.f), ambient_color(0.f),
+      background_color(0.3f), lod_threshold(0.f) {}
+
+ReferenceRenderer::~ReferenceRenderer() {}
+
+auto ReferenceRenderer::set_light_dir(glm::vec3 light_dir) -> void {
+    this->light_dir = light_dir;
+}
+
+auto ReferenceRenderer::set_dirlight_color(glm::vec3 color) -> void {
+    this->dirlight_color = color;
+}
+
+auto ReferenceRenderer::set_ambient_color(glm::vec3 color) -> void {
+    this->ambient_color = color;
+}
+
+auto ReferenceRenderer::set_background_color(glm::vec3 color) -> void {
+    this->background_color = color;
+}
+
+auto ReferenceRenderer::set_lod_threshold(float pixels) -> void {
+    this->lod_threshold = pixels;
+}
+
+typedef struct TracedChunk {
+    geometry::AABB bounds;
+    std::vector<scene::GPUCompactNode> nodes;
+    const scene::DistanceGrid *grid; // null if the chunk doesn't keep one
+    float distance; // from the camera to the nearest point of the chunk
+} TracedChunk;
+
+// side planes of the pyramid through a tile's corner rays, inward facing
+typedef struct TileFrustum {
+    std::array<glm::vec3, 4> normals;
+
+    auto contains(glm::vec3 origin, const geometry::AABB &aabb) const -> bool {
+        for (glm::vec3 normal : this->normals) {
+            glm::vec3 corner(normal.x > 0.f ? aabb.max.x : aabb.min.x,
+                             normal.y > 0.f ? aabb.max.y : aabb.min.y,
+                             normal.z > 0.f ? aabb.max.z : aabb.min.z);
+            if (glm::dot(normal, corner - origin) < 0.f)
+                return false;
+        }
+        return true;
+    }
+} TileFrustum;
+
+auto ReferenceRenderer::render(scene::Scene &scene,
+                               const camera::Camera &camera, int width,
+                               int height) const -> Image {
+    if (width <= 0 || height <= 0) {
+        throw std::invalid_argument("Image size must be positive");
+    }
+
+    size_t pixel_count = static_cast<size_t>(width) * height;
+    Image image{width, height, std::vector<glm::u8vec4>(pixel_count),
+                std::vector<float>(pixel_count,
+                                   std::numeric_limits<float>::infinity()),
+                0};
+
+    // screen_to_ray stretches x by the camera's aspect ratio, so rescale ours
+    float x_scale = (static_cast<float>(width) / height) /
+                    camera.get_aspect_ratio();
+    auto pixel_ray = [&camera, width, height, x_scale](float x, float y) {
+        glm::vec2 ndc(x / width * 2.f - 1.f, 1.f - y / height * 2.f);
+        return camera.screen_to_ray(glm::vec2(ndc.x * x_scale, ndc.y));
+    };
+
+    // nodes smaller than this times their distance cover under the
+    // threshold's worth of pixels, same as the shader's `lodScale()`
+    float pixel_angle = 2.f * std::tan(camera.get_fovy() * 0.5f) / height;
+    float lod_scale = this->lod_threshold * pixel_angle;
+
+    // pack every chunk's nodes up front, nearest first
+    glm::vec3 origin = camera.get_position();
+    std::vector<TracedChunk> chunks;
+    for (auto &[coord, chunk] : scene.get_chunks()) {
+        // both of these serialize any pending edits first
+        const scene::DistanceGrid *grid = chunk->get_distance_grid();
+        std::vector<scene::GPUCompactNode> nodes = chunk->pack_nodes();
+        geometry::AABB bounds = chunk->get_bounds();
+        glm::vec3 nearest = glm::clamp(origin, bounds.min, bounds.max);
+        chunks.push_back({bounds, std::move(nodes), grid,
+                          glm::length(nearest - origin)});
+    }
+    std::sort(chunks.begin(), chunks.end(),
+              [](const TracedChunk &a, const TracedChunk &b) {
+                  return a.distance < b.distance;
+              });
+
+    glm::vec3 light = glm::normalize(this->light_dir);
+    glm::u8vec4 background(
+        glm::round(glm::clamp(this->background_color, 0.f, 1.f) * 255.f),
+        255);
+
+    int tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    std::vector<uint64_t> tile_steps(static_cast<size_t>(tiles_x) * tiles_y);
+
+    ThreadPool::get_shared().parallel_for(tile_steps.size(), [&](size_t tile) {
+        int x0 = static_cast<int>(tile % tiles_x) * TILE_SIZE;
+        int y0 = static_cast<int>(tile / tiles_x) * TILE_SIZE;
+        int x1 = std::min(x0 + TILE_SIZE, width);
+        int y1 = std::min(y0 + TILE_SIZE, height);
+
+        // treat the tile's rays as one packet: only chunks inside the
+        // pyramid through its corners need to be traced at all
+        std::array<glm::vec3, 4> corners = {
+            pixel_ray(x0, y0).direction, pixel_ray(x1, y0).direction,
+            pixel_ray(x1, y1).direction, pixel_ray(x0, y1).direction};
+        glm::vec3 center = corners[0] + corners[1] + corners[2] + corners[3];
+        TileFrustum frustum;
+        for (int i = 0; i < 4; ++i) {
+            glm::vec3 normal = glm::cross(corners[i], corners[(i + 1) % 4]);
+            frustum.normals[i] = glm::dot(normal, center) < 0.f ? -normal
+                                                                 : normal;
+        }
+
+        std::vector<const TracedChunk *> tile_chunks;
+        for (const TracedChunk &chunk : chunks) {
+            if (frustum.contains(origin, chunk.bounds))
+                tile_chunks.push_back(&chunk);
+        }
+
+        uint64_t steps = 0;
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                geometry::Ray ray = pixel_ray(x + 0.5f, y + 0.5f);
+
+                scene::FlatRaycastResult closest{false, 1e30f, false,
+                                                 glm::vec3(0.f), 0, 0};
+                for (const TracedChunk *chunk : tile_chunks) {
+                    // chunks are sorted, none of the rest can be closer
+                    if (chunk->distance > closest.t)
+                        break;
+
+                    auto result = scene::raycast_flat(
+                        chunk->nodes.data(), chunk->bounds, ray, chunk->grid,
+                        lod_scale);
+                    steps += result.steps;
+                    if (result.hit && result.t < closest.t)
+                        closest = result;
+                }
+
+                size_t index = static_cast<size_t>(y) * width + x;
+                glm::u8vec4 &pixel = image.pixels[index];
+                if (!closest.hit) {
+                    pixel = background;
+                    continue;
+                }
+                image.depths[index] = closest.t;
+
+                // simple half lambert lighting, same as the shader
+                uint32_t packed = closest.color_packed;
+                glm::vec3 albedo =
+                    glm::vec3(packed & 0xFF, (packed >> 8) & 0xFF,
+                              (packed >> 16) & 0xFF) /
+                    255.f;
+                float diffuse =
+                    std::max(glm::dot(closest.normal, light) * 0.5f + 0.5f,
+                             0.f);
+                glm::vec3 lighting =
+                    this->ambient_color + diffuse * this->dirlight_color;
+                glm::vec3 color = glm::clamp(albedo * lighting, 0.f, 1.f);
+                pixel = glm::u8vec4(glm::round(color * 255.f), packed >> 24);
+            }
+        }
+        tile_steps[tile] = steps;
+    });
+
+    for (uint64_t steps : tile_steps)
+        image.traversal_steps += steps;
+    return image;
+}
+
+} // namespace vxng
@@ -1,17 +1,29 @@
 #include "vxng/renderer.h"
 
+#include "scene/chunk-grid.h"
 #include "scene/chunk.h"
+#include "scene/gpu-chunk-pool.h"
 #include "wgsl/shaders.h"
 
-#include <array>
 #include <glm/glm.hpp>
 #include <webgpu/webgpu_cpp.h>
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <vector>
+
+// nearest chunks drawn first, whose depth the rest are tested against
+#define OCCLUDER_CHUNKS 8
+// pixels per side of a beam prepass tile, keep in sync with the shader
+#define BEAM_TILE_SIZE 8
 
 namespace vxng {
 
-Renderer::Renderer() : background_color(0.3) {};
+Renderer::Renderer()
+    : wgpu(), background_color(0.3), traversal(TRAVERSAL_PARAMETRIC),
+      beam_prepass(true), lod_threshold(0.f), single_pass(false),
+      chunk_grid(std::make_unique<scene::ChunkGrid>()) {};
 Renderer::~Renderer() {
     // WebGPU objects are automatically released when their reference counted
     // handles all go out of scope
@@ -34,7 +46,7 @@ auto Renderer::init_webgpu(wgpu::Device device) -> bool {
     {
         wgpu::BufferDescriptor globals_desc;
         globals_desc.label = "Scene globals uniform buffer";
-        globals_desc.size = 64;
+        globals_desc.size = 80;
         globals_desc.usage =
             wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst;
         globals_buffer = device.CreateBuffer(&globals_desc);
@@ -43,8 +55,9 @@ auto Renderer::init_webgpu(wgpu::Device device) -> bool {
     // create bind group layouts for shaders
     wgpu::BindGroupLayout globals_bind_group_layout = nullptr;
     wgpu::BindGroupLayout camera_bind_group_layout = nullptr;
+    wgpu::BindGroupLayout occluder_bind_group_layout = nullptr;
     wgpu::BindGroupLayout chunk_bind_group_layout =
-        scene::Chunk::get_bindgroup_layout(device);
+        scene::GPUChunkPool::get_bindgroup_layout(device);
     {
         // globals bind group layout (group 0)
         wgpu::BindGroupLayoutEntry globals_layout_entry;
@@ -52,7 +65,7 @@ auto Renderer::init_webgpu(wgpu::Device device) -> bool {
         globals_layout_entry.visibility =
             wgpu::ShaderStage::Vertex | wgpu::ShaderStage::Fragment;
         globals_layout_entry.buffer.type = wgpu::BufferBindingType::Uniform;
-        globals_layout_entry.buffer.minBindingSize = 64;
+        globals_layout_entry.buffer.minBindingSize = 80;
 
         wgpu::BindGroupLayoutDescriptor globals_bgl_desc;
         globals_bgl_desc.label = "Globals bind group layout";
@@ -75,6 +88,23 @@ auto Renderer::init_webgpu(wgpu::Device device) -> bool {
         camera_bgl_desc.entries = &camera_layout_entry;
         camera_bind_group_layout =
             device.CreateBindGroupLayout(&camera_bgl_desc);
+
+        // occluder and beam depth bind group layout (group 3)
+        std::array<wgpu::BindGroupLayoutEntry, 2> occluder_layout_entries;
+        for (uint32_t i = 0; i < occluder_layout_entries.size(); ++i) {
+            auto &entry = occluder_layout_entries[i];
+            entry.binding = i;
+            entry.visibility = wgpu::ShaderStage::Fragment;
+            entry.texture.sampleType = wgpu::TextureSampleType::Depth;
+            entry.texture.viewDimension = wgpu::TextureViewDimension::e2D;
+        }
+
+        wgpu::BindGroupLayoutDescriptor occluder_bgl_desc;
+        occluder_bgl_desc.label = "Occluder depth bind group layout";
+        occluder_bgl_desc.entryCount = occluder_layout_entries.size();
+        occluder_bgl_desc.entries = occluder_layout_entries.data();
+        occluder_bind_group_layout =
+            device.CreateBindGroupLayout(&occluder_bgl_desc);
     }
 
     // create globals bind group (camera bind group created in
@@ -85,7 +115,7 @@ auto Renderer::init_webgpu(wgpu::Device device) -> bool {
         globals_entry.binding = 0;
         globals_entry.buffer = globals_buffer;
         globals_entry.offset = 0;
-        globals_entry.size = 64;
+        globals_entry.size = 80;
 
         wgpu::BindGroupDescriptor bg_desc;
         bg_desc.layout = globals_bind_group_layout;
@@ -111,83 +141,32 @@ auto Renderer::init_webgpu(wgpu::Device device) -> bool {
         }
     }
 
-    // create pipeline layout
+    // create pipeline layouts
     wgpu::PipelineLayout pipeline_layout = nullptr;
+    wgpu::PipelineLayout beam_pipeline_layout = nullptr;
+    wgpu::PipelineLayout scene_pipeline_layout = nullptr;
     {
-        std::array<wgpu::BindGroupLayout, 3> bind_group_layouts = {
+        std::array<wgpu::BindGroupLayout, 4> bind_group_layouts = {
             globals_bind_group_layout, camera_bind_group_layout,
-            chunk_bind_group_layout};
+            chunk_bind_group_layout, occluder_bind_group_layout};
 
         wgpu::PipelineLayoutDescriptor layout_desc;
         layout_desc.label = "Render pipeline layout";
         layout_desc.bindGroupLayoutCount = bind_group_layouts.size();
         layout_desc.bindGroupLayouts = bind_group_layouts.data();
         pipeline_layout = device.CreatePipelineLayout(&layout_desc);
-    }
 
-    // create render pipeline
-    wgpu::RenderPipeline render_pipeline = nullptr;
-    {
-        wgpu::RenderPipelineDescriptor pipeline_desc;
-        pipeline_desc.label = "Fullscreen render pipeline";
-        pipeline_desc.layout = pipeline_layout;
-
-        wgpu::VertexState vertex_state;
-        vertex_state.module = shader_module;
-        vertex_state.entryPoint = "vs_main";
-        vertex_state.bufferCount = 0;
-        vertex_state.buffers = nullptr;
-        pipeline_desc.vertex = vertex_state;
-
-        wgpu::PrimitiveState primitive_state;
-        primitive_state.topology = wgpu::PrimitiveTopology::TriangleList;
-        primitive_state.stripIndexFormat = wgpu::IndexFormat::Undefined;
-        primitive_state.frontFace = wgpu::FrontFace::CCW;
-        primitive_state.cullMode = wgpu::CullMode::None;
-        pipeline_desc.primitive = primitive_state;
-
-        wgpu::FragmentState fragment_state;
-        fragment_state.module = shader_module;
-        fragment_state.entryPoint = "fs_main";
-
-        // color target
-        wgpu::ColorTargetState color_target;
-        color_target.format = wgpu::TextureFormat::BGRA8Unorm;
-        color_target.writeMask = wgpu::ColorWriteMask::All;
-
-        wgpu::BlendState blend_state;
-        blend_state.color.srcFactor = wgpu::BlendFactor::One;
-        blend_state.color.dstFactor = wgpu::BlendFactor::Zero;
-        blend_state.color.operation = wgpu::BlendOperation::Add;
-        blend_state.alpha.srcFactor = wgpu::BlendFactor::One;
-        blend_state.alpha.dstFactor = wgpu::BlendFactor::Zero;
-        blend_state.alpha.operation = wgpu::BlendOperation::Add;
-        color_target.blend = &blend_state;
-
-        fragment_state.targetCount = 1;
-        fragment_state.targets = &color_target;
-        pipeline_desc.fragment = &fragment_state;
-
-        // use our de
-        wgpu::DepthStencilState depth_stencil_state;
-        depth_stencil_state.format = wgpu::TextureFormat::Depth32Float;
-        depth_stencil_state.depthWriteEnabled = true;
-        depth_stencil_state.depthCompare = wgpu::CompareFunction::Less;
-        pipeline_desc.depthStencil = &depth_stencil_state;
-
-        // multisample state
-        wgpu::MultisampleState multisample_state;
-        multisample_state.count = 1;
-        multisample_state.mask = ~0u;
-        multisample_state.alphaToCoverageEnabled = false;
-        pipeline_desc.multisample = multisample_state;
-
-        render_pipeline = device.CreateRenderPipeline(&pipeline_desc);
-        if (!render_pipeline) {
-            std::cerr << "Failed to create render pipeline!" << std::endl;
-            return false;
-        }
+        // the beam pass writes the texture group 3 reads, so it goes without
+        layout_desc.label = "Beam pipeline layout";
+        layout_desc.bindGroupLayoutCount = 3;
+        beam_pipeline_layout = device.CreatePipelineLayout(&layout_desc);
+
+        // and the single pass reads the chunk grid in place of a chunk
+        bind_group_layouts[2] = scene::ChunkGrid::get_bindgroup_layout(device);
+        layout_desc.label = "Single pass pipeline layout";
+        scene_pipeline_layout = device.CreatePipelineLayout(&layout_desc);
     }
+    this->chunk_grid->init_webgpu(device);
 
     // store all objects in member struct
     this->wgpu.initialized = true;
@@ -196,20 +175,231 @@ auto Renderer::init_webgpu(wgpu::Device device) -> bool {
     this->wgpu.globals_uniforms_buffer = globals_buffer;
     this->wgpu.globals_bind_group_layout = globals_bind_group_layout;
     this->wgpu.camera_bind_group_layout = camera_bind_group_layout;
+    this->wgpu.occluder_bind_group_layout = occluder_bind_group_layout;
     this->wgpu.globals_bind_group = globals_bind_group;
     // camera_bind_group is set in set_active_camera
     this->wgpu.shader_module = shader_module;
     this->wgpu.pipeline_layout = pipeline_layout;
-    this->wgpu.render_pipeline = render_pipeline;
+    this->wgpu.beam_pipeline_layout = beam_pipeline_layout;
+    this->wgpu.scene_pipeline_layout = scene_pipeline_layout;
+
+    return create_render_pipelines();
+}
+
+auto Renderer::set_traversal(Traversal traversal) -> bool {
+    if (traversal == this->traversal)
+        return true;
+
+    this->traversal = traversal;
+    if (!this->wgpu.initialized)
+        return true;
+    return create_render_pipelines();
+}
+
+auto Renderer::get_traversal() const -> Traversal { return this->traversal; }
+
+auto Renderer::set_beam_prepass(bool enabled) -> bool {
+    if (enabled == this->beam_prepass)
+        return true;
+
+    this->beam_prepass = enabled;
+    if (!this->wgpu.initialized)
+        return true;
+    return create_render_pipelines();
+}
+
+auto Renderer::is_beam_prepass() const -> bool { return this->beam_prepass; }
+
+auto Renderer::set_single_pass(bool enabled) -> void {
+    this->single_pass = enabled;
+}
 
+auto Renderer::is_single_pass() const -> bool { return this->single_pass; }
+
+auto Renderer::create_render_pipelines() -> bool {
+    wgpu::RenderPipeline render_pipeline = create_render_pipeline(false);
+    wgpu::RenderPipeline occlusion_tested_pipeline =
+        create_render_pipeline(true);
+    wgpu::RenderPipeline beam_pipeline = create_beam_pipeline();
+    wgpu::RenderPipeline scene_pipeline = create_scene_pipeline();
+    if (!render_pipeline || !occlusion_tested_pipeline || !beam_pipeline ||
+        !scene_pipeline) {
+        std::cerr << "Failed to create render pipeline!" << std::endl;
+        return false;
+    }
+
+    this->wgpu.render_pipeline = render_pipeline;
+    this->wgpu.occlusion_tested_pipeline = occlusion_tested_pipeline;
+    this->wgpu.beam_pipeline = beam_pipeline;
+    this->wgpu.scene_pipeline = scene_pipeline;
     return true;
 }
 
+auto Renderer::create_render_pipeline(bool occlusion_test)
+    -> wgpu::RenderPipeline {
+    wgpu::RenderPipelineDescriptor pipeline_desc;
+    pipeline_desc.label = occlusion_test
+                              ? "Occlusion tested render pipeline"
+                              : "Fullscreen render pipeline";
+    pipeline_desc.layout = this->wgpu.pipeline_layout;
+
+    wgpu::VertexState vertex_state;
+    vertex_state.module = this->wgpu.shader_module;
+    vertex_state.entryPoint = "vs_main";
+    vertex_state.bufferCount = 0;
+    vertex_state.buffers = nullptr;
+    pipeline_desc.vertex = vertex_state;
+
+    wgpu::PrimitiveState primitive_state;
+    primitive_state.topology = wgpu::PrimitiveTopology::TriangleList;
+    primitive_state.stripIndexFormat = wgpu::IndexFormat::Undefined;
+    primitive_state.frontFace = wgpu::FrontFace::CCW;
+    // back faces only: one fragment per pixel per chunk, and they're still
+    // there with the camera inside the chunk
+    primitive_state.cullMode = wgpu::CullMode::Front;
+    pipeline_desc.primitive = primitive_state;
+
+    wgpu::FragmentState fragment_state;
+    fragment_state.module = this->wgpu.shader_module;
+    fragment_state.entryPoint = "fs_main";
+
+    // picks the traversal kernel, occlusion test and beam prepass, see the
+    // shader
+    std::array<wgpu::ConstantEntry, 3> constants;
+    constants[0].key = "TRAVERSAL";
+    constants[0].value = static_cast<double>(this->traversal);
+    constants[1].key = "OCCLUSION_TEST";
+    constants[1].value = occlusion_test ? 1.0 : 0.0;
+    constants[2].key = "BEAM_PREPASS";
+    constants[2].value = this->beam_prepass ? 1.0 : 0.0;
+    fragment_state.constantCount = constants.size();
+    fragment_state.constants = constants.data();
+
+    // color target
+    wgpu::ColorTargetState color_target;
+    color_target.format = wgpu::TextureFormat::BGRA8Unorm;
+    color_target.writeMask = wgpu::ColorWriteMask::All;
+
+    wgpu::BlendState blend_state;
+    blend_state.color.srcFactor = wgpu::BlendFactor::One;
+    blend_state.color.dstFactor = wgpu::BlendFactor::Zero;
+    blend_state.color.operation = wgpu::BlendOperation::Add;
+    blend_state.alpha.srcFactor = wgpu::BlendFactor::One;
+    blend_state.alpha.dstFactor = wgpu::BlendFactor::Zero;
+    blend_state.alpha.operation = wgpu::BlendOperation::Add;
+    color_target.blend = &blend_state;
+
+    fragment_state.targetCount = 1;
+    fragment_state.targets = &color_target;
+    pipeline_desc.fragment = &fragment_state;
+
+    // use our de
+    wgpu::DepthStencilState depth_stencil_state;
+    depth_stencil_state.format = wgpu::TextureFormat::Depth32Float;
+    depth_stencil_state.depthWriteEnabled = true;
+    depth_stencil_state.depthCompare = wgpu::CompareFunction::Less;
+    pipeline_desc.depthStencil = &depth_stencil_state;
+
+    // multisample state
+    wgpu::MultisampleState multisample_state;
+    multisample_state.count = 1;
+    multisample_state.mask = ~0u;
+    multisample_state.alphaToCoverageEnabled = false;
+    pipeline_desc.multisample = multisample_state;
+
+    return this->wgpu.device.CreateRenderPipeline(&pipeline_desc);
+}
+
+auto Renderer::create_beam_pipeline() -> wgpu::RenderPipeline {
+    wgpu::RenderPipelineDescriptor pipeline_desc;
+    pipeline_desc.label = "Beam prepass pipeline";
+    pipeline_desc.layout = this->wgpu.beam_pipeline_layout;
+
+    wgpu::VertexState vertex_state;
+    vertex_state.module = this->wgpu.shader_module;
+    vertex_state.entryPoint = "vs_beam";
+    pipeline_desc.vertex = vertex_state;
+
+    wgpu::PrimitiveState primitive_state;
+    primitive_state.topology = wgpu::PrimitiveTopology::TriangleList;
+    primitive_state.frontFace = wgpu::FrontFace::CCW;
+    // back faces, same as the chunks themselves
+    primitive_state.cullMode = wgpu::CullMode::Front;
+    pipeline_desc.primitive = primitive_state;
+
+    // depth only, which keeps the nearest beam t for us
+    wgpu::FragmentState fragment_state;
+    fragment_state.module = this->wgpu.shader_module;
+    fragment_state.entryPoint = "fs_beam";
+    fragment_state.targetCount = 0;
+    pipeline_desc.fragment = &fragment_state;
+
+    wgpu::DepthStencilState depth_stencil_state;
+    depth_stencil_state.format = wgpu::TextureFormat::Depth32Float;
+    depth_stencil_state.depthWriteEnabled = true;
+    depth_stencil_state.depthCompare = wgpu::CompareFunction::Less;
+    pipeline_desc.depthStencil = &depth_stencil_state;
+
+    wgpu::MultisampleState multisample_state;
+    multisample_state.count = 1;
+    multisample_state.mask = ~0u;
+    multisample_state.alphaToCoverageEnabled = false;
+    pipeline_desc.multisample = multisample_state;
+
+    return this->wgpu.device.CreateRenderPipeline(&pipeline_desc);
+}
+
+auto Renderer::create_scene_pipeline() -> wgpu::RenderPipeline {
+    wgpu::RenderPipelineDescriptor pipeline_desc;
+    pipeline_desc.label = "Single pass pipeline";
+    pipeline_desc.layout = this->wgpu.scene_pipeline_layout;
+
+    wgpu::VertexState vertex_state;
+    vertex_state.module = this->wgpu.shader_module;
+    vertex_state.entryPoint = "vs_scene";
+    pipeline_desc.vertex = vertex_state;
+
+    wgpu::PrimitiveState primitive_state;
+    primitive_state.topology = wgpu::PrimitiveTopology::TriangleList;
+    primitive_state.cullMode = wgpu::CullMode::None;
+    pipeline_desc.primitive = primitive_state;
+
+    wgpu::FragmentState fragment_state;
+    fragment_state.module = this->wgpu.shader_module;
+    fragment_state.entryPoint = "fs_scene";
+
+    wgpu::ConstantEntry traversal_constant;
+    traversal_constant.key = "TRAVERSAL";
+    traversal_constant.value = static_cast<double>(this->traversal);
+    fragment_state.constantCount = 1;
+    fragment_state.constants = &traversal_constant;
+
+    // nothing else is drawn, so no blending or depth
+    wgpu::ColorTargetState color_target;
+    color_target.format = wgpu::TextureFormat::BGRA8Unorm;
+    color_target.writeMask = wgpu::ColorWriteMask::All;
+    fragment_state.targetCount = 1;
+    fragment_state.targets = &color_target;
+    pipeline_desc.fragment = &fragment_state;
+
+    wgpu::MultisampleState multisample_state;
+    multisample_state.count = 1;
+    multisample_state.mask = ~0u;
+    multisample_state.alphaToCoverageEnabled = false;
+    pipeline_desc.multisample = multisample_state;
+
+    return this->wgpu.device.CreateRenderPipeline(&pipeline_desc);
+}
+
 auto Renderer::resize(int width, int height) -> void {
     float aspect = (float)width / (float)height;
     this->wgpu.queue.WriteBuffer(this->wgpu.globals_uniforms_buffer, 0, &aspect,
                                  sizeof(float));
 
+    glm::vec2 viewport_size(width, height);
+    this->wgpu.queue.WriteBuffer(this->wgpu.globals_uniforms_buffer, 64,
+                                 &viewport_size, sizeof(float) * 2);
+
     create_depth_texture(width, height);
 };
 
@@ -228,6 +418,16 @@ auto Renderer::set_ambient_color(glm::vec3 color) -> void {
                                  sizeof(float) * 3);
 }
 
+auto Renderer::set_lod_threshold(float pixels) -> void {
+    this->lod_threshold = pixels;
+    this->wgpu.queue.WriteBuffer(this->wgpu.globals_uniforms_buffer, 72,
+                                 &pixels, sizeof(float));
+}
+
+auto Renderer::get_lod_threshold() const -> float {
+    return this->lod_threshold;
+}
+
 auto Renderer::set_background_color(glm::vec3 color) -> void {
     this->background_color = color;
 }
@@ -253,40 +453,220 @@ auto Renderer::set_active_camera(const vxng::camera::Camera *camera) -> void {
     this->wgpu.camera_bind_group = this->wgpu.device.CreateBindGroup(&bg_desc);
 }
 
-auto Renderer::render(wgpu::RenderPassEncoder &render_pass) const -> void {
-    // set the render pipeline
-    render_pass.SetPipeline(this->wgpu.render_pipeline);
+auto Renderer::render(wgpu::CommandEncoder &encoder,
+                      wgpu::TextureView target) const -> void {
+    if (this->single_pass && this->chunk_grid->update(*this->active_scene)) {
+        render_single_pass(encoder, target);
+        return;
+    }
 
-    // bind the uniform bind groups
-    render_pass.SetBindGroup(0, this->wgpu.globals_bind_group);
-    render_pass.SetBindGroup(1, this->wgpu.camera_bind_group);
+    // cull anything out of view, then sort what's left front to back
+    typedef struct DrawnChunk {
+        const scene::Chunk *chunk;
+        float distance;
+    } DrawnChunk;
 
+    std::vector<DrawnChunk> drawn;
+    glm::vec3 camera_pos = this->active_camera->get_position();
     for (auto &[coord, chunk] : this->active_scene->get_chunks()) {
-        render_pass.SetBindGroup(2, chunk->get_bindgroup());
+        // paged out of gpu memory (or out of pool), nothing to draw with
+        if (!chunk->is_webgpu_initialized() || chunk->get_gpu_slot_count() == 0)
+            continue;
+
+        geometry::AABB bounds = chunk->get_bounds();
+        if (!this->active_camera->is_visible(bounds))
+            continue;
 
-        // draw chunk AABB cube (36 vertices = 12 triangles)
-        render_pass.Draw(36, 1, 0, 0);
+        glm::vec3 nearest = glm::clamp(camera_pos, bounds.min, bounds.max);
+        drawn.push_back({chunk.get(), glm::length(nearest - camera_pos)});
     }
-};
+    std::sort(drawn.begin(), drawn.end(),
+              [](const DrawnChunk &a, const DrawnChunk &b) {
+                  return a.distance < b.distance;
+              });
+
+    size_t occluder_count = std::min<size_t>(drawn.size(), OCCLUDER_CHUNKS);
+
+    auto draw_chunks = [&drawn](wgpu::RenderPassEncoder &render_pass,
+                                size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            // every chunk shares the pool's bind group, the offset picks
+            // out which one's metadata we're drawing
+            uint32_t metadata_offset = drawn[i].chunk->get_metadata_offset();
+            render_pass.SetBindGroup(2, drawn[i].chunk->get_bindgroup(), 1,
+                                     &metadata_offset);
+
+            // draw chunk AABB cube (36 vertices = 12 triangles)
+            render_pass.Draw(36, 1, 0, 0);
+        }
+    };
+
+    wgpu::RenderPassColorAttachment color_attachment;
+    color_attachment.view = target;
+    color_attachment.resolveTarget = nullptr;
+    color_attachment.loadOp = wgpu::LoadOp::Clear;
+    color_attachment.storeOp = wgpu::StoreOp::Store;
+    color_attachment.clearValue =
+        wgpu::Color{this->background_color.r, this->background_color.g,
+                    this->background_color.b, 1.0};
+
+    wgpu::RenderPassDepthStencilAttachment depth_attachment;
+    depth_attachment.view = this->wgpu.occluder_depth_texture_view;
+    depth_attachment.depthLoadOp = wgpu::LoadOp::Clear;
+    depth_attachment.depthStoreOp = wgpu::StoreOp::Store;
+    depth_attachment.depthClearValue = 1.0f; // far plane
+    depth_attachment.stencilLoadOp = wgpu::LoadOp::Undefined;
+    depth_attachment.stencilStoreOp = wgpu::StoreOp::Undefined;
+
+    wgpu::RenderPassDescriptor pass_desc;
+    pass_desc.colorAttachmentCount = 1;
+    pass_desc.colorAttachments = &color_attachment;
+    pass_desc.depthStencilAttachment = &depth_attachment;
+    pass_desc.timestampWrites = nullptr;
+
+    // --------- Beam prepass: nearest possible hit per tile ---------
+
+    if (this->beam_prepass && !drawn.empty()) {
+        wgpu::RenderPassDepthStencilAttachment beam_attachment;
+        beam_attachment.view = this->wgpu.beam_depth_texture_view;
+        beam_attachment.depthLoadOp = wgpu::LoadOp::Clear;
+        beam_attachment.depthStoreOp = wgpu::StoreOp::Store;
+        beam_attachment.depthClearValue = 1.0f; // nothing to hit
+        beam_attachment.stencilLoadOp = wgpu::LoadOp::Undefined;
+        beam_attachment.stencilStoreOp = wgpu::StoreOp::Undefined;
+
+        wgpu::RenderPassDescriptor beam_pass_desc;
+        beam_pass_desc.label = "Beam prepass";
+        beam_pass_desc.colorAttachmentCount = 0;
+        beam_pass_desc.depthStencilAttachment = &beam_attachment;
+
+        wgpu::RenderPassEncoder render_pass =
+            encoder.BeginRenderPass(&beam_pass_desc);
+        render_pass.SetPipeline(this->wgpu.beam_pipeline);
+        render_pass.SetBindGroup(0, this->wgpu.globals_bind_group);
+        render_pass.SetBindGroup(1, this->wgpu.camera_bind_group);
+        draw_chunks(render_pass, 0, drawn.size());
+        render_pass.End();
+    }
+
+    // --------- Occluders: nearest chunks, drawn as usual ---------
+
+    {
+        pass_desc.label = "Occluder chunks pass";
+        wgpu::RenderPassEncoder render_pass = encoder.BeginRenderPass(&pass_desc);
+        render_pass.SetPipeline(this->wgpu.render_pipeline);
+        render_pass.SetBindGroup(0, this->wgpu.globals_bind_group);
+        render_pass.SetBindGroup(1, this->wgpu.camera_bind_group);
+        // not read by this pipeline, but the layout still wants it
+        render_pass.SetBindGroup(3, this->wgpu.depth_bind_group);
+        draw_chunks(render_pass, 0, occluder_count);
+        render_pass.End();
+    }
+
+    if (occluder_count == drawn.size())
+        return;
+
+    // --------- Everything else, tested against the occluders ---------
+
+    // carry the occluders' depth over so the depth test still sorts us out
+    // against them, while the shader reads the original
+    wgpu::TexelCopyTextureInfo copy_src;
+    copy_src.texture = this->wgpu.occluder_depth_texture;
+    wgpu::TexelCopyTextureInfo copy_dst;
+    copy_dst.texture = this->wgpu.depth_texture;
+    wgpu::Extent3D copy_size = {this->depth_size.x, this->depth_size.y, 1};
+    encoder.CopyTextureToTexture(&copy_src, &copy_dst, &copy_size);
+
+    color_attachment.loadOp = wgpu::LoadOp::Load;
+    depth_attachment.view = this->wgpu.depth_texture_view;
+    depth_attachment.depthLoadOp = wgpu::LoadOp::Load;
+
+    {
+        pass_desc.label = "Occlusion tested chunks pass";
+        wgpu::RenderPassEncoder render_pass = encoder.BeginRenderPass(&pass_desc);
+        render_pass.SetPipeline(this->wgpu.occlusion_tested_pipeline);
+        render_pass.SetBindGroup(0, this->wgpu.globals_bind_group);
+        render_pass.SetBindGroup(1, this->wgpu.camera_bind_group);
+        render_pass.SetBindGroup(3, this->wgpu.occluder_bind_group);
+        draw_chunks(render_pass, occluder_count, drawn.size());
+        render_pass.End();
+    }
+}
+
+auto Renderer::render_single_pass(wgpu::CommandEncoder &encoder,
+                                  wgpu::TextureView target) const -> void {
+    wgpu::RenderPassColorAttachment color_attachment;
+    color_attachment.view = target;
+    color_attachment.resolveTarget = nullptr;
+    color_attachment.loadOp = wgpu::LoadOp::Clear;
+    color_attachment.storeOp = wgpu::StoreOp::Store;
+    color_attachment.clearValue =
+        wgpu::Color{this->background_color.r, this->background_color.g,
+                    this->background_color.b, 1.0};
+
+    wgpu::RenderPassDescriptor pass_desc;
+    pass_desc.label = "Single pass";
+    pass_desc.colorAttachmentCount = 1;
+    pass_desc.colorAttachments = &color_attachment;
+
+    wgpu::RenderPassEncoder render_pass = encoder.BeginRenderPass(&pass_desc);
+    if (this->chunk_grid->get_chunk_count() != 0) {
+        render_pass.SetPipeline(this->wgpu.scene_pipeline);
+        render_pass.SetBindGroup(0, this->wgpu.globals_bind_group);
+        render_pass.SetBindGroup(1, this->wgpu.camera_bind_group);
+        render_pass.SetBindGroup(2, this->chunk_grid->get_bindgroup());
+        render_pass.Draw(3, 1, 0, 0);
+    }
+    render_pass.End();
+}
 
 auto Renderer::create_depth_texture(int width, int height) -> void {
-    if (this->wgpu.depth_texture) {
-        this->wgpu.depth_texture.Destroy();
+    this->depth_size = {static_cast<uint32_t>(width),
+                        static_cast<uint32_t>(height)};
+
+    // one for the occluder pass, sampled by the next one drawing into the other
+    this->wgpu.occluder_depth_texture = create_depth_target(
+        "Occluder depth texture", this->depth_size,
+        wgpu::TextureUsage::CopySrc, this->wgpu.occluder_depth_texture,
+        this->wgpu.occluder_depth_texture_view);
+    this->wgpu.depth_texture = create_depth_target(
+        "Depth texture", this->depth_size, wgpu::TextureUsage::CopyDst,
+        this->wgpu.depth_texture, this->wgpu.depth_texture_view);
+
+    // a texel per tile, covering any partial ones at the edges
+    glm::uvec2 beam_size =
+        (this->depth_size + glm::uvec2(BEAM_TILE_SIZE - 1)) / BEAM_TILE_SIZE;
+    this->wgpu.beam_depth_texture = create_depth_target(
+        "Beam depth texture", beam_size, wgpu::TextureUsage::None,
+        this->wgpu.beam_depth_texture, this->wgpu.beam_depth_texture_view);
+
+    this->wgpu.occluder_bind_group =
+        create_depth_bind_group(this->wgpu.occluder_depth_texture_view);
+    this->wgpu.depth_bind_group =
+        create_depth_bind_group(this->wgpu.depth_texture_view);
+}
+
+auto Renderer::create_depth_target(const char *label, glm::uvec2 size,
+                                   wgpu::TextureUsage extra_usage,
+                                   wgpu::Texture previous,
+                                   wgpu::TextureView &view) -> wgpu::Texture {
+    if (previous) {
+        previous.Destroy();
     }
 
     wgpu::TextureDescriptor desc;
-    desc.label = "Depth texture";
-    desc.size = {static_cast<uint32_t>(width), static_cast<uint32_t>(height),
-                 1};
+    desc.label = label;
+    desc.size = {size.x, size.y, 1};
     desc.mipLevelCount = 1;
     desc.sampleCount = 1;
     desc.dimension = wgpu::TextureDimension::e2D;
     desc.format = wgpu::TextureFormat::Depth32Float;
-    desc.usage = wgpu::TextureUsage::RenderAttachment;
-    this->wgpu.depth_texture = this->wgpu.device.CreateTexture(&desc);
+    desc.usage = wgpu::TextureUsage::RenderAttachment |
+                 wgpu::TextureUsage::TextureBinding | extra_usage;
+    wgpu::Texture texture = this->wgpu.device.CreateTexture(&desc);
 
     wgpu::TextureViewDescriptor view_desc;
-    view_desc.label = "Depth texture view";
+    view_desc.label = label;
     view_desc.format = wgpu::TextureFormat::Depth32Float;
     view_desc.dimension = wgpu::TextureViewDimension::e2D;
     view_desc.baseMipLevel = 0;
@@ -294,12 +674,24 @@ auto Renderer::create_depth_texture(int width, int height) -> void {
     view_desc.baseArrayLayer = 0;
     view_desc.arrayLayerCount = 1;
     view_desc.aspect = wgpu::TextureAspect::DepthOnly;
-    this->wgpu.depth_texture_view =
-        this->wgpu.depth_texture.CreateView(&view_desc);
+    view = texture.CreateView(&view_desc);
+
+    return texture;
 }
 
-auto Renderer::get_depth_texture_view() const -> wgpu::TextureView {
-    return this->wgpu.depth_texture_view;
+auto Renderer::create_depth_bind_group(wgpu::TextureView view)
+    -> wgpu::BindGroup {
+    std::array<wgpu::BindGroupEntry, 2> entries;
+    entries[0].binding = 0;
+    entries[0].textureView = view;
+    entries[1].binding = 1;
+    entries[1].textureView = this->wgpu.beam_depth_texture_view;
+
+    wgpu::BindGroupDescriptor bg_desc;
+    bg_desc.layout = this->wgpu.occluder_bind_group_layout;
+    bg_desc.entryCount = entries.size();
+    bg_desc.entries = entries.data();
+    return this->wgpu.device.CreateBindGroup(&bg_desc);
 }
 
 } // namespace vxng
@@ -0,0 +1,218 @@
+#include "chunk-grid.h"
+#include "chunk.h"
+#include "gpu-chunk-pool.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+// a 16MB grid, about 160 chunks along each side
+#define MAX_GRID_CELLS (1u << 22)
+
+namespace vxng::scene {
+
+wgpu::BindGroupLayout ChunkGrid::bindgroup_layout = nullptr;
+
+ChunkGrid::ChunkGrid() : cells(), chunks(), info(), overflowed(false), wgpu() {}
+
+ChunkGrid::~ChunkGrid() {
+    if (!this->wgpu.initialized)
+        return;
+
+    if (this->wgpu.cells_buffer)
+        this->wgpu.cells_buffer.Destroy();
+    if (this->wgpu.chunks_buffer)
+        this->wgpu.chunks_buffer.Destroy();
+    this->wgpu.info_buffer.Destroy();
+}
+
+auto ChunkGrid::init_webgpu(wgpu::Device device) -> void {
+    this->wgpu.initialized = true;
+    this->wgpu.device = device;
+
+    wgpu::BufferDescriptor desc;
+    desc.label = "Chunk grid info uniform buffer";
+    desc.size = sizeof(GPUChunkGridInfo);
+    desc.usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst;
+    this->wgpu.info_buffer = device.CreateBuffer(&desc);
+}
+
+auto ChunkGrid::update(const Scene &scene) -> bool {
+    // no device yet, so no chunk has anything up either
+    const GPUChunkPool *pool = scene.get_chunk_pool();
+    if (!pool)
+        return false;
+
+    // chunks with nodes up on the gpu, and the coords they span
+    std::vector<std::pair<glm::ivec3, const Chunk *>> resident;
+    glm::ivec3 coord_min(INT_MAX);
+    glm::ivec3 coord_max(INT_MIN);
+    for (auto &[coord, chunk] : scene.get_chunks()) {
+        if (!chunk->is_webgpu_initialized() || chunk->get_gpu_slot_count() == 0)
+            continue;
+
+        resident.push_back({coord, chunk.get()});
+        coord_min = glm::min(coord_min, coord);
+        coord_max = glm::max(coord_max, coord);
+    }
+
+    glm::ivec3 dims =
+        resident.empty() ? glm::ivec3(0) : coord_max - coord_min + 1;
+    size_t cell_count = static_cast<size_t>(dims.x) * dims.y * dims.z;
+    if (cell_count > MAX_GRID_CELLS) {
+        if (!this->overflowed)
+            std::cerr << "Scene spans too many chunks for a chunk grid ("
+                      << cell_count << " cells, at most " << MAX_GRID_CELLS
+                      << ")" << std::endl;
+        this->overflowed = true;
+        return false;
+    }
+
+    std::vector<uint32_t> cells(std::max<size_t>(cell_count, 1), 0);
+    std::vector<GPUChunkMetadata> chunks;
+    chunks.reserve(resident.size());
+    for (auto &[coord, chunk] : resident) {
+        // where their nodes and grids are in the pool, too
+        chunks.push_back(chunk->get_metadata());
+
+        glm::ivec3 cell = coord - coord_min;
+        cells[(static_cast<size_t>(cell.z) * dims.y + cell.y) * dims.x +
+              cell.x] = static_cast<uint32_t>(chunks.size());
+    }
+
+    float scale = scene.get_chunk_scale();
+    GPUChunkGridInfo info = {};
+    for (int axis = 0; axis < 3; ++axis) {
+        info.origin[axis] = (coord_min[axis] - 0.5f) * scale;
+        info.dims[axis] = static_cast<uint32_t>(dims[axis]);
+    }
+    info.cell_size = scale;
+
+    // only upload what's actually changed, which most frames is nothing
+    wgpu::Queue queue = this->wgpu.device.GetQueue();
+    bool buffers_changed = false;
+    if (cells != this->cells) {
+        buffers_changed |= reserve_buffer(
+            this->wgpu.cells_buffer, "Chunk grid cells storage buffer",
+            sizeof(uint32_t) * cells.size());
+        queue.WriteBuffer(this->wgpu.cells_buffer, 0, cells.data(),
+                          sizeof(uint32_t) * cells.size());
+        this->cells = std::move(cells);
+    }
+
+    if (!this->wgpu.chunks_buffer || chunks.size() != this->chunks.size() ||
+        std::memcmp(chunks.data(), this->chunks.data(),
+                    sizeof(GPUChunkMetadata) * chunks.size()) != 0) {
+        buffers_changed |= reserve_buffer(
+            this->wgpu.chunks_buffer, "Chunk grid chunks storage buffer",
+            sizeof(GPUChunkMetadata) * std::max<size_t>(chunks.size(), 1));
+        queue.WriteBuffer(this->wgpu.chunks_buffer, 0, chunks.data(),
+                          sizeof(GPUChunkMetadata) * chunks.size());
+        this->chunks = std::move(chunks);
+    }
+
+    if (std::memcmp(&info, &this->info, sizeof(GPUChunkGridInfo)) != 0) {
+        queue.WriteBuffer(this->wgpu.info_buffer, 0, &info,
+                          sizeof(GPUChunkGridInfo));
+        this->info = info;
+    }
+
+    // the pool replaces its buffers as it grows (or shrinks)
+    wgpu::Buffer pool_buffers[] = {pool->get_node_buffer(),
+                                   pool->get_grid_buffer()};
+    wgpu::Buffer *bound_buffers[] = {&this->wgpu.node_buffer,
+                                     &this->wgpu.grid_buffer};
+    for (size_t i = 0; i < 2; ++i) {
+        if (pool_buffers[i].Get() != bound_buffers[i]->Get()) {
+            *bound_buffers[i] = pool_buffers[i];
+            buffers_changed = true;
+        }
+    }
+
+    if (buffers_changed || !this->wgpu.bindgroup)
+        create_bindgroup();
+
+    this->overflowed = false;
+    return true;
+}
+
+auto ChunkGrid::get_chunk_count() const -> size_t {
+    return this->chunks.size();
+}
+
+auto ChunkGrid::get_bindgroup() const -> wgpu::BindGroup {
+    return this->wgpu.bindgroup;
+}
+
+auto ChunkGrid::get_bindgroup_layout(wgpu::Device device)
+    -> wgpu::BindGroupLayout {
+    if (bindgroup_layout)
+        return bindgroup_layout;
+
+    // same bindings as the chunk pool's where they overlap, so the shader's
+    // traversal reads either. the chunk metadata uniform (1) isn't used
+    std::array<wgpu::BindGroupLayoutEntry, 5> entries;
+    uint32_t storage_bindings[] = {0, 2, 3, 4};
+    for (size_t i = 0; i < 4; ++i) {
+        entries[i].binding = storage_bindings[i];
+        entries[i].visibility = wgpu::ShaderStage::Fragment;
+        entries[i].buffer.type = wgpu::BufferBindingType::ReadOnlyStorage;
+    }
+
+    auto &info_entry = entries[4];
+    info_entry.binding = 5;
+    info_entry.visibility = wgpu::ShaderStage::Fragment;
+    info_entry.buffer.type = wgpu::BufferBindingType::Uniform;
+    info_entry.buffer.minBindingSize = sizeof(GPUChunkGridInfo);
+
+    wgpu::BindGroupLayoutDescriptor desc;
+    desc.label = "Chunk grid bind group layout";
+    desc.entryCount = entries.size();
+    desc.entries = entries.data();
+    bindgroup_layout = device.CreateBindGroupLayout(&desc);
+    return bindgroup_layout;
+}
+
+auto ChunkGrid::reserve_buffer(wgpu::Buffer &buffer, const char *label,
+                               size_t size) -> bool {
+    size_t previous_size = buffer ? buffer.GetSize() : 0;
+    if (previous_size >= size)
+        return false;
+
+    if (buffer)
+        buffer.Destroy();
+
+    // grown geometrically, as chunks tend to come in one at a time
+    wgpu::BufferDescriptor desc;
+    desc.label = label;
+    desc.size = std::max<size_t>(size, previous_size * 2);
+    desc.usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst;
+    buffer = this->wgpu.device.CreateBuffer(&desc);
+    return true;
+}
+
+auto ChunkGrid::create_bindgroup() -> void {
+    std::array<wgpu::BindGroupEntry, 5> entries;
+    std::array<wgpu::Buffer, 5> buffers = {
+        this->wgpu.node_buffer, this->wgpu.grid_buffer,
+        this->wgpu.cells_buffer, this->wgpu.chunks_buffer,
+        this->wgpu.info_buffer};
+    uint32_t bindings[] = {0, 2, 3, 4, 5};
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entries[i].binding = bindings[i];
+        entries[i].buffer = buffers[i];
+        entries[i].offset = 0;
+        entries[i].size = buffers[i].GetSize();
+    }
+
+    wgpu::BindGroupDescriptor desc;
+    desc.label = "Chunk grid bind group";
+    desc.layout = get_bindgroup_layout(this->wgpu.device);
+    desc.entryCount = entries.size();
+    desc.entries = entries.data();
+    this->wgpu.bindgroup = this->wgpu.device.CreateBindGroup(&desc);
+}
+
+} // namespace vxng::scene
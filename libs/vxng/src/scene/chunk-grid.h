@@ -0,0 +1,75 @@
+#pragma once
+
+#include "gpu-types.h"
+#include "vxng/scene.h"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace vxng::scene {
+
+/**
+ * Everything the single pass renderer needs to draw a whole scene with one
+ * fullscreen triangle: the scene's `GPUChunkPool`, which already holds every
+ * chunk's nodes and grid, plus a grid over chunk coords pointing at their
+ * metadata, which rays step through cell by cell before walking each chunk's
+ * octree.
+ */
+class ChunkGrid {
+  public:
+    ChunkGrid();
+    ~ChunkGrid();
+
+    auto init_webgpu(wgpu::Device device) -> void;
+
+    /**
+     * Brings the grid up to date with the scene, uploading only what changed
+     * since last time.
+     *
+     * @return false if the scene has no buffers yet, or (after logging) spans
+     *         too many chunks for the grid, in which case there's nothing to
+     *         draw with
+     */
+    auto update(const Scene &scene) -> bool;
+
+    auto get_chunk_count() const -> size_t;
+    /** For rendering: binds the pool's buffers and the grid as group 2 */
+    auto get_bindgroup() const -> wgpu::BindGroup;
+
+    /** Layout of `get_bindgroup`, created on first use */
+    static auto get_bindgroup_layout(wgpu::Device device)
+        -> wgpu::BindGroupLayout;
+
+  private:
+    static wgpu::BindGroupLayout bindgroup_layout;
+
+    /**
+     * Makes a storage `buffer` at least `size` bytes, returning whether it
+     * had to be replaced (contents and all)
+     */
+    auto reserve_buffer(wgpu::Buffer &buffer, const char *label, size_t size)
+        -> bool;
+    auto create_bindgroup() -> void;
+
+    // what's up on the gpu, so unchanged frames don't upload anything
+    std::vector<uint32_t> cells; // index + 1 into `chunks`, 0 if empty
+    std::vector<GPUChunkMetadata> chunks;
+    GPUChunkGridInfo info;
+    bool overflowed; // already logged that we don't fit, until we do again
+
+    struct {
+        bool initialized;
+        wgpu::Device device;
+        wgpu::Buffer cells_buffer;
+        wgpu::Buffer chunks_buffer;
+        wgpu::Buffer info_buffer;
+        // the pool's, as of our bind group, which it replaces as it grows
+        wgpu::Buffer node_buffer;
+        wgpu::Buffer grid_buffer;
+        wgpu::BindGroup bindgroup;
+    } wgpu;
+};
+
+} // namespace vxng::scene
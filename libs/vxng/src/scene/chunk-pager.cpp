@@ -0,0 +1,122 @@
+#include "chunk-pager.h"
+
+#include "scene-file.h"
+#include "thread-pool.h"
+
+#include <iostream>
+#include <string>
+
+// touch one byte per page to fault a chunk's arrays in
+#define PREFETCH_PAGE_STRIDE 4096
+
+namespace vxng::scene {
+
+static auto touch_pages(const void *data, size_t size) -> void {
+    const volatile uint8_t *bytes = static_cast<const volatile uint8_t *>(data);
+    for (size_t i = 0; i < size; i += PREFETCH_PAGE_STRIDE) {
+        (void)bytes[i];
+    }
+}
+
+ChunkPager::ChunkPager(std::filesystem::path spill_dir)
+    : spill_dir(std::move(spill_dir)), spill_paths(), next_spill_id(0),
+      stored(), prefetching(),
+      prefetch_results(std::make_shared<PrefetchResults>()) {
+    std::error_code error;
+    std::filesystem::create_directories(this->spill_dir, error);
+    if (error) {
+        std::cerr << "Failed to create spill directory '"
+                  << this->spill_dir.string() << "': " << error.message()
+                  << std::endl;
+    }
+}
+
+ChunkPager::~ChunkPager() {
+    // mappings can outlive their files, so this is fine even if chunks are
+    // still frozen from spills (it just might not succeed on windows)
+    std::error_code error;
+    std::filesystem::remove_all(this->spill_dir, error);
+}
+
+auto ChunkPager::store(glm::ivec3 coord, StoredChunk stored) -> void {
+    this->stored[coord] = std::move(stored);
+}
+
+auto ChunkPager::take(glm::ivec3 coord) -> std::optional<StoredChunk> {
+    auto it = this->stored.find(coord);
+    if (it == this->stored.end())
+        return {};
+
+    StoredChunk stored = std::move(it->second);
+    this->stored.erase(it);
+    return stored;
+}
+
+auto ChunkPager::get_stored() const
+    -> const std::unordered_map<glm::ivec3, StoredChunk> & {
+    return this->stored;
+}
+
+auto ChunkPager::prefetch(glm::ivec3 coord) -> void {
+    auto it = this->stored.find(coord);
+    if (it == this->stored.end() || this->prefetching.count(coord))
+        return;
+    this->prefetching.insert(coord);
+
+    // the task holds its own references, so the record can go away meanwhile
+    StoredChunk stored = it->second;
+    auto results = this->prefetch_results;
+    ThreadPool::get_shared().submit([stored, results, coord]() {
+        touch_pages(stored.data.octree_nodes,
+                    sizeof(GPUOctreeNode) * stored.data.slot_count);
+        touch_pages(stored.data.voxel_datas,
+                    sizeof(GPUVoxelData) * stored.data.slot_count);
+
+        std::lock_guard<std::mutex> lock(results->mutex);
+        results->finished.push_back(coord);
+    });
+}
+
+auto ChunkPager::take_prefetched() -> std::vector<glm::ivec3> {
+    std::vector<glm::ivec3> finished;
+    {
+        std::lock_guard<std::mutex> lock(this->prefetch_results->mutex);
+        finished.swap(this->prefetch_results->finished);
+    }
+
+    std::vector<glm::ivec3> ready;
+    for (glm::ivec3 coord : finished) {
+        this->prefetching.erase(coord);
+        if (this->stored.count(coord))
+            ready.push_back(coord);
+    }
+    return ready;
+}
+
+auto ChunkPager::spill(glm::ivec3 coord, Chunk::SerializedOctree data,
+                       int chunk_resolution, float chunk_scale)
+    -> std::optional<StoredChunk> {
+    // spills are just single-chunk scene files
+    std::filesystem::path path =
+        this->spill_dir /
+        ("chunk-" + std::to_string(this->next_spill_id++) + ".vxng");
+    if (!write_scene_file(path.string(), chunk_resolution, chunk_scale,
+                          {SceneFileChunk{coord, data}}))
+        return {};
+
+    auto contents = read_scene_file(path.string());
+    if (!contents || contents->chunks.size() != 1)
+        return {};
+
+    // the previous spill is no longer referenced once the chunk refreezes
+    auto previous = this->spill_paths.find(coord);
+    if (previous != this->spill_paths.end()) {
+        std::error_code error;
+        std::filesystem::remove(previous->second, error);
+    }
+    this->spill_paths[coord] = path;
+
+    return StoredChunk{contents->backing, contents->chunks[0].data};
+}
+
+} // namespace vxng::scene
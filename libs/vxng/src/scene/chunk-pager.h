@@ -0,0 +1,79 @@
+#pragma once
+
+#include "chunk.h"
+
+#include <glm/glm.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace vxng::scene {
+
+/** A chunk that lives only on disk, as mapped serialized arrays */
+typedef struct StoredChunk {
+    std::shared_ptr<const void> backing; // the mapping, see `Chunk::get_backing`
+    Chunk::SerializedOctree data;
+} StoredChunk;
+
+/**
+ * Bookkeeping for chunks that aren't resident in a `Scene`: where their data
+ * lives on disk, which ones are being paged in on the thread pool, and the
+ * spill files that edited chunks get written to when evicted.
+ *
+ * Everything here is driven from the scene's thread; only the page-in reads
+ * themselves happen on workers.
+ */
+class ChunkPager {
+  public:
+    /** @param spill_dir  Created if needed, and removed with the pager */
+    ChunkPager(std::filesystem::path spill_dir);
+    ~ChunkPager();
+
+    /** Records a chunk as living on disk, replacing any previous record */
+    auto store(glm::ivec3 coord, StoredChunk stored) -> void;
+    /** Removes and returns a chunk's record, e.g. to make it resident */
+    auto take(glm::ivec3 coord) -> std::optional<StoredChunk>;
+    auto get_stored() const
+        -> const std::unordered_map<glm::ivec3, StoredChunk> &;
+
+    /**
+     * Starts reading a stored chunk's pages in on the thread pool, so that
+     * making it resident later doesn't stall on the disk.
+     */
+    auto prefetch(glm::ivec3 coord) -> void;
+    /** Stored chunks whose prefetch finished since the last call */
+    auto take_prefetched() -> std::vector<glm::ivec3>;
+
+    /**
+     * Writes serialized arrays to a fresh spill file and maps them back, so
+     * they no longer take up heap memory. Replaces the chunk's previous spill
+     * file, if any.
+     */
+    auto spill(glm::ivec3 coord, Chunk::SerializedOctree data,
+               int chunk_resolution, float chunk_scale)
+        -> std::optional<StoredChunk>;
+
+  private:
+    std::filesystem::path spill_dir;
+    std::unordered_map<glm::ivec3, std::filesystem::path> spill_paths;
+    uint64_t next_spill_id;
+
+    std::unordered_map<glm::ivec3, StoredChunk> stored;
+    std::unordered_set<glm::ivec3> prefetching;
+
+    // filled in by pool tasks, which may outlive us
+    typedef struct PrefetchResults {
+        std::mutex mutex;
+        std::vector<glm::ivec3> finished;
+    } PrefetchResults;
+    std::shared_ptr<PrefetchResults> prefetch_results;
+};
+
+} // namespace vxng::scene
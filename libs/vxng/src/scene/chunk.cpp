@@ -1,79 +1,124 @@
 #include "chunk.h"
+#include "octree-dag.h"
+#include "octree-view.h"
 
 #include <webgpu/webgpu_cpp.h>
 
+#include <algorithm>
+#include <array>
+#include <climits>
 #include <cmath>
-#include <memory>
-#include <queue>
+#include <iostream>
 #include <stdexcept>
 #include <vector>
 
+// smallest ray direction component, flatter than this counts as parallel
+#define RAYCAST_MIN_DIRECTION 1e-12f
+// each level pops one node and pushes up to four, so this covers 32 levels
+#define RAYCAST_STACK_SIZE (3 * 32 + 1)
+// rays walked together by `raycast_packet`, one bit each in a mask
+#define RAYCAST_PACKET_RAYS 64
+
+// captured cell token for a leaf, above the 8 child mask bits of an internal
+// node. an empty cell is just a 0 mask
+#define CELL_TOKEN_LEAF (1u << 8)
+
+// compact nodes only have 24 bits for the first child index
+#define MAX_GPU_SLOTS (1u << 24)
+// frozen arrays get packed and uploaded this many slots at a time
+#define UPLOAD_BATCH_SLOTS (1u << 16)
+
 namespace vxng::scene {
 
-auto VoxelData::operator==(const VoxelData &rhs) -> bool {
-    return this->color == rhs.color;
-}
-auto VoxelData::operator!=(const VoxelData &rhs) -> bool {
-    return !(*this == rhs);
+// interleaves voxel coords so each octree level is one octant digit, with the
+// same bit layout as octants (x lowest)
+static auto morton_encode(glm::ivec3 voxel, int depth) -> uint64_t {
+    uint64_t code = 0;
+    for (int bit = 0; bit < depth; ++bit) {
+        code |= static_cast<uint64_t>((voxel.x >> bit) & 1) << (3 * bit + 0);
+        code |= static_cast<uint64_t>((voxel.y >> bit) & 1) << (3 * bit + 1);
+        code |= static_cast<uint64_t>((voxel.z >> bit) & 1) << (3 * bit + 2);
+    }
+    return code;
 }
 
-auto OctreeNode::has_children() -> bool {
-    for (const auto &child : this->children) {
-        if (child)
-            return true;
+static auto morton_decode(uint64_t code, int depth) -> glm::ivec3 {
+    glm::ivec3 voxel(0);
+    for (int bit = 0; bit < depth; ++bit) {
+        voxel.x |= static_cast<int>((code >> (3 * bit + 0)) & 1) << bit;
+        voxel.y |= static_cast<int>((code >> (3 * bit + 1)) & 1) << bit;
+        voxel.z |= static_cast<int>((code >> (3 * bit + 2)) & 1) << bit;
     }
-    return false;
+    return voxel;
 }
 
-// static stuffs
-wgpu::BindGroupLayout Chunk::bindgroup_layout = nullptr;
-bool Chunk::bindgroup_layout_created = false;
+// the voxel `dig_into_tree` ends up in, give or take rounding
+static auto get_voxel(glm::vec3 local_position, int depth) -> glm::ivec3 {
+    int side = 1 << depth;
+    return glm::clamp(glm::ivec3(glm::floor((local_position + 0.5f) *
+                                            static_cast<float>(side))),
+                      glm::ivec3(0), glm::ivec3(side - 1));
+}
 
-Chunk::Chunk(glm::vec3 pos, float scale, int resolution)
-    : position(pos), scale(scale), resolution(resolution) {
-    this->root_node = std::make_unique<OctreeNode>();
-    this->root_node->parent = nullptr;
-};
+static auto pack_color(glm::u8vec4 color) -> uint32_t {
+    return color.r | (color.g << 8) | (color.b << 16) |
+           (static_cast<uint32_t>(color.a) << 24);
+}
 
-Chunk::~Chunk() {
-    if (!this->wgpu.initialized)
+template <typename View>
+static auto encode_subtree(const View &view, typename View::Node node,
+                           std::vector<uint32_t> &tokens) -> void {
+    if (view.is_leaf(node)) {
+        tokens.push_back(CELL_TOKEN_LEAF);
+        tokens.push_back(pack_color(view.get_color(node)));
         return;
+    }
 
-    this->wgpu.octree_buffer.Destroy();
-    this->wgpu.vxdata_buffer.Destroy();
-    this->wgpu.metadata_buffer.Destroy();
-};
-
-auto Chunk::init_webgpu(wgpu::Device device) -> void {
-    this->wgpu.initialized = true;
-    this->wgpu.device = device;
-
-    // get starting data to the gpu!
-    update_buffers();
-}
-
-auto Chunk::get_bindgroup() const -> wgpu::BindGroup {
-    return this->wgpu.bindgroup;
+    uint32_t mask = 0;
+    for (int i = 0; i < 8; ++i) {
+        if (view.get_child(node, i) != View::NONE)
+            mask |= 1u << i;
+    }
+    tokens.push_back(mask);
+    for (int i = 0; i < 8; ++i) {
+        if (mask & (1u << i))
+            encode_subtree(view, view.get_child(node, i), tokens);
+    }
 }
 
-auto Chunk::get_bounds() const -> geometry::AABB {
-    float half_size = scale * 0.5f;
-    geometry::AABB bounds;
-    bounds.min = position - glm::vec3(half_size);
-    bounds.max = position + glm::vec3(half_size);
-    return bounds;
+// appends the tokens for whatever is at cell `code`, which may be part of a
+// bigger leaf or of nothing at all
+template <typename View>
+static auto encode_cell(const View &view, uint64_t code, int depth,
+                        std::vector<uint32_t> &tokens) -> void {
+    typename View::Node node = view.get_root();
+    for (int level = depth - 1; level >= 0; --level) {
+        if (view.is_leaf(node))
+            break;
+
+        node = view.get_child(node, static_cast<int>((code >> (3 * level)) & 7));
+        if (node == View::NONE) {
+            tokens.push_back(0);
+            return;
+        }
+    }
+    if (view.is_leaf(node)) {
+        tokens.push_back(CELL_TOKEN_LEAF);
+        tokens.push_back(pack_color(view.get_color(node)));
+        return;
+    }
+    encode_subtree(view, node, tokens);
 }
 
-auto Chunk::sample_position(glm::vec3 local_position) const
-    -> std::optional<glm::u8vec4> {
-    const OctreeNode *node = this->root_node.get();
+template <typename View>
+static auto sample_view(const View &view, glm::vec3 local_position,
+                        int resolution) -> std::optional<glm::u8vec4> {
+    typename View::Node node = view.get_root();
 
-    // create required nodes to specific depth
-    for (int trav_depth = 0; (1u << trav_depth) <= this->resolution;
-         ++trav_depth) {
+    for (int trav_depth = 0; (1u << trav_depth) <= resolution; ++trav_depth) {
         // if solid, just return color
-        if (node->is_leaf)
-            return node->leaf_data.color;
+        if (view.is_leaf(node))
+            return view.get_color(node);
 
         // dig into specific child node based on position
         int child_index = ((uint32_t)(local_position.x >= 0) << 0) +
@@ -81,116 +126,466 @@ auto Chunk::sample_position(glm::vec3 local_position) const
                           ((uint32_t)(local_position.z >= 0) << 2);
 
         // if we're internal, but child doesn't exist, there's nothing there
-        if (!node->children[child_index]) {
+        node = view.get_child(node, child_index);
+        if (node == View::NONE)
             return {};
-        }
 
         // put local position into terms of new node bounds
         local_position = glm::fract((local_position + glm::vec3(0.5f)) * 2.0f) -
                          glm::vec3(0.5f);
-        node = node->children[child_index].get();
     }
 
     return {};
 }
 
-auto Chunk::raycast(const geometry::Ray &ray) const -> geometry::RaycastResult {
-    // If not leaf but no children, return miss
-    if (!root_node->is_leaf && !root_node->has_children()) {
-        return geometry::RaycastResult{.hit = false};
+// inverse ray direction, nudging flat axes so plane crossings stay finite.
+// mirror gets the octant bits we travel down, i.e. from the high half of a
+// node to the low half
+static auto raycast_inverse_direction(glm::vec3 direction, int &mirror)
+    -> glm::vec3 {
+    glm::vec3 inv_dir;
+    mirror = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        float d = direction[axis];
+        if (std::abs(d) < RAYCAST_MIN_DIRECTION)
+            d = std::copysign(RAYCAST_MIN_DIRECTION, d);
+        inv_dir[axis] = 1.f / d;
+        if (d < 0.f)
+            mirror |= 1 << axis;
     }
+    return inv_dir;
+}
 
-    // Compute root AABB from chunk position and scale
-    geometry::AABB root_aabb = get_bounds();
+// t along the ray spent inside a box, negative if we start inside it. false
+// if the ray misses it or it's behind us
+static auto raycast_box_range(const geometry::AABB &aabb,
+                              const geometry::Ray &ray, glm::vec3 inv_dir,
+                              float &t_enter, float &t_exit) -> bool {
+    glm::vec3 t0 = (aabb.min - ray.origin) * inv_dir;
+    glm::vec3 t1 = (aabb.max - ray.origin) * inv_dir;
+    glm::vec3 t_near = glm::min(t0, t1), t_far = glm::max(t0, t1);
+    t_enter = std::max(std::max(t_near.x, t_near.y), t_near.z);
+    t_exit = std::min(std::min(t_far.x, t_far.y), t_far.z);
+    return !(t_enter > t_exit || t_exit < 0.f);
+}
 
-    // Check if ray hits root AABB at all
-    if (!geometry::ray_aabb_intersect(ray, root_aabb).hit) {
-        return geometry::RaycastResult{.hit = false};
+// a ray's stretch through one child of a node, by mirrored octant
+typedef struct RaycastSegment {
+    int octant;
+    float t_enter;
+    float t_exit;
+} RaycastSegment;
+
+// the children a ray passes through inside a node, at most four, in order
+static auto raycast_segments(const geometry::AABB &aabb,
+                             const geometry::Ray &ray, glm::vec3 inv_dir,
+                             float t_enter, float t_exit,
+                             RaycastSegment segments[4]) -> int {
+    // the child we start in has every mid plane crossed before entering (in
+    // mirrored terms), then we move into the next at each crossing
+    glm::vec3 mid = (aabb.min + aabb.max) * 0.5f;
+    glm::vec3 t_mid = (mid - ray.origin) * inv_dir;
+    int octant = 0;
+    int crossings[3];
+    int crossing_count = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (t_mid[axis] <= t_enter)
+            octant |= 1 << axis;
+        else if (t_mid[axis] < t_exit)
+            crossings[crossing_count++] = axis;
+    }
+    std::sort(crossings, crossings + crossing_count,
+              [&t_mid](int a, int b) { return t_mid[a] < t_mid[b]; });
+
+    int segment_count = 0;
+    float t = t_enter;
+    for (int i = 0; i < crossing_count; ++i) {
+        float t_cross = t_mid[crossings[i]];
+        segments[segment_count++] = {octant, t, t_cross};
+        octant |= 1 << crossings[i];
+        t = t_cross;
     }
+    segments[segment_count++] = {octant, t, t_exit};
+    return segment_count;
+}
+
+static auto raycast_child_aabb(const geometry::AABB &aabb, int octant)
+    -> geometry::AABB {
+    glm::vec3 mid = (aabb.min + aabb.max) * 0.5f;
+
+    // Octant bit layout: xyz
+    geometry::AABB child_aabb;
+    child_aabb.min.x = (octant & 1) ? mid.x : aabb.min.x;
+    child_aabb.min.y = (octant & 2) ? mid.y : aabb.min.y;
+    child_aabb.min.z = (octant & 4) ? mid.z : aabb.min.z;
+    child_aabb.max.x = (octant & 1) ? aabb.max.x : mid.x;
+    child_aabb.max.y = (octant & 2) ? aabb.max.y : mid.y;
+    child_aabb.max.z = (octant & 4) ? aabb.max.z : mid.z;
+    return child_aabb;
+}
+
+static auto raycast_leaf_hit(const geometry::AABB &aabb,
+                             const geometry::Ray &ray, float t_enter,
+                             float t_exit) -> geometry::RaycastResult {
+    geometry::RaycastResult result;
+    result.hit = true;
+    result.inside = t_enter < 0.f;
+    result.t = result.inside ? t_exit : t_enter;
+    result.normal = geometry::compute_aabb_normal(
+        aabb, ray.origin + result.t * ray.direction);
+    return result;
+}
+
+template <typename View>
+static auto raycast_view(const View &view, const geometry::Ray &ray,
+                         const geometry::AABB &root_aabb)
+    -> geometry::RaycastResult {
+    typedef typename View::Node Node;
+
+    int mirror;
+    glm::vec3 inv_dir = raycast_inverse_direction(ray.direction, mirror);
 
-    // Stack for iterative DFS traversal
     struct StackEntry {
-        const OctreeNode *node;
+        Node node;
+        geometry::AABB aabb;
+        float t_enter;
+        float t_exit;
+    };
+
+    float t_enter, t_exit;
+    if (!raycast_box_range(root_aabb, ray, inv_dir, t_enter, t_exit))
+        return geometry::RaycastResult{.hit = false};
+
+    std::array<StackEntry, RAYCAST_STACK_SIZE> stack;
+    size_t stack_size = 0;
+    stack[stack_size++] = {view.get_root(), root_aabb, t_enter, t_exit};
+
+    while (stack_size > 0) {
+        StackEntry entry = stack[--stack_size];
+
+        // children come off the stack nearest first, so the first leaf we
+        // reach is the hit
+        if (view.is_leaf(entry.node))
+            return raycast_leaf_hit(entry.aabb, ray, entry.t_enter,
+                                    entry.t_exit);
+
+        RaycastSegment segments[4];
+        int segment_count = raycast_segments(entry.aabb, ray, inv_dir,
+                                             entry.t_enter, entry.t_exit,
+                                             segments);
+
+        // farthest first, so the nearest is popped next. anything deeper than
+        // the stack allows is far below float precision anyway
+        if (stack_size + segment_count > stack.size())
+            continue;
+        for (int i = segment_count - 1; i >= 0; --i) {
+            if (segments[i].t_exit < 0.f)
+                continue;
+
+            int child_octant = segments[i].octant ^ mirror;
+            Node child = view.get_child(entry.node, child_octant);
+            if (child == View::NONE)
+                continue;
+
+            stack[stack_size++] = {child,
+                                   raycast_child_aabb(entry.aabb, child_octant),
+                                   segments[i].t_enter, segments[i].t_exit};
+        }
+    }
+
+    return geometry::RaycastResult{.hit = false};
+}
+
+// `raycast_view` for rays that all travel down the same octants, walking the
+// tree once for all of them. any ray's children along it come in increasing
+// mirrored octant order, so visiting children in that order is front to back
+// for every ray at once. each stack entry carries the rays inside its node,
+// and a ray drops out at the first leaf it reaches, same as on its own
+template <typename View>
+static auto raycast_packet_view(const View &view, const geometry::Ray *rays,
+                                const glm::vec3 *inv_dirs, uint64_t mask,
+                                int mirror, const geometry::AABB &root_aabb,
+                                geometry::RaycastResult *results) -> void {
+    typedef typename View::Node Node;
+
+    struct PacketEntry {
+        Node node;
         geometry::AABB aabb;
+        uint64_t mask;
+        // only meaningful for rays in the mask
+        float t_enter[RAYCAST_PACKET_RAYS];
+        float t_exit[RAYCAST_PACKET_RAYS];
     };
 
-    std::vector<StackEntry> stack;
-    stack.push_back({root_node.get(), root_aabb});
+    PacketEntry root;
+    root.node = view.get_root();
+    root.aabb = root_aabb;
+    root.mask = 0;
+    for (int i = 0; i < RAYCAST_PACKET_RAYS; ++i) {
+        if (!(mask >> i & 1))
+            continue;
+
+        results[i] = geometry::RaycastResult{.hit = false};
+        if (raycast_box_range(root_aabb, rays[i], inv_dirs[i],
+                              root.t_enter[i], root.t_exit[i]))
+            root.mask |= 1ull << i;
+    }
 
-    geometry::RaycastResult closest_hit{.hit = false};
-    float closest_t = 1e30f;
+    // unlike a single ray's, this grows up to seven entries a level
+    std::vector<PacketEntry> stack;
+    if (root.mask != 0)
+        stack.push_back(root);
+    uint64_t done = 0;
 
     while (!stack.empty()) {
-        StackEntry entry = stack.back();
+        PacketEntry entry = stack.back();
         stack.pop_back();
-
-        const OctreeNode *node = entry.node;
-        const geometry::AABB &aabb = entry.aabb;
-
-        // Check if this is a leaf node (no children)
-        if (node->is_leaf) {
-            // Raycast against this leaf's AABB
-            auto result = geometry::ray_aabb_intersect(ray, aabb);
-            if (result.hit) {
-                // Check if this is the closest hit so far
-                if (result.t >= 0.0f && result.t < closest_t) {
-                    closest_t = result.t;
-
-                    // Compute hit point and normal
-                    glm::vec3 hit_point = ray.origin + result.t * ray.direction;
-                    closest_hit.hit = true;
-                    closest_hit.t = result.t;
-                    closest_hit.inside = result.inside;
-                    closest_hit.normal =
-                        geometry::compute_aabb_normal(aabb, hit_point);
-                }
+        uint64_t active = entry.mask & ~done;
+        if (active == 0)
+            continue;
+
+        if (view.is_leaf(entry.node)) {
+            for (int i = 0; i < RAYCAST_PACKET_RAYS; ++i) {
+                if (active >> i & 1)
+                    results[i] = raycast_leaf_hit(entry.aabb, rays[i],
+                                                  entry.t_enter[i],
+                                                  entry.t_exit[i]);
             }
-        } else {
-            // Internal node - push children onto stack in reverse order (for
-            // DFS) We want to visit them in order 0-7, so push in reverse 7-0
-            bool ray_origin_inside = aabb.contains(ray.origin);
-            for (int i = 7; i >= 0; --i) {
-                if (node->children[i]) {
-                    // Compute child AABB
-                    glm::vec3 mid = (aabb.min + aabb.max) * 0.5f;
-                    geometry::AABB child_aabb;
-
-                    // Octant bit layout: xyz
-                    child_aabb.min.x = (i & 1) ? mid.x : aabb.min.x;
-                    child_aabb.min.y = (i & 2) ? mid.y : aabb.min.y;
-                    child_aabb.min.z = (i & 4) ? mid.z : aabb.min.z;
-
-                    child_aabb.max.x = (i & 1) ? aabb.max.x : mid.x;
-                    child_aabb.max.y = (i & 2) ? aabb.max.y : mid.y;
-                    child_aabb.max.z = (i & 4) ? aabb.max.z : mid.z;
-
-                    // Check if ray could hit this child AABB before closest hit
-                    auto child_result =
-                        geometry::ray_aabb_intersect(ray, child_aabb);
-                    if (child_result.hit &&
-                        (ray_origin_inside || child_result.t < closest_t)) {
-                        stack.push_back({node->children[i].get(), child_aabb});
-                    }
-                }
+            done |= active;
+            continue;
+        }
+
+        // sort each ray's stretch into the children it passes through
+        PacketEntry children[8];
+        for (PacketEntry &child : children)
+            child.mask = 0;
+        for (int i = 0; i < RAYCAST_PACKET_RAYS; ++i) {
+            if (!(active >> i & 1))
+                continue;
+
+            RaycastSegment segments[4];
+            int segment_count =
+                raycast_segments(entry.aabb, rays[i], inv_dirs[i],
+                                 entry.t_enter[i], entry.t_exit[i], segments);
+            for (int s = 0; s < segment_count; ++s) {
+                if (segments[s].t_exit < 0.f)
+                    continue;
+
+                PacketEntry &child = children[segments[s].octant];
+                child.mask |= 1ull << i;
+                child.t_enter[i] = segments[s].t_enter;
+                child.t_exit[i] = segments[s].t_exit;
             }
         }
+
+        // farthest first, so the nearest is popped next
+        for (int octant = 7; octant >= 0; --octant) {
+            PacketEntry &child = children[octant];
+            if (child.mask == 0)
+                continue;
+
+            int child_octant = octant ^ mirror;
+            child.node = view.get_child(entry.node, child_octant);
+            if (child.node == View::NONE)
+                continue;
+
+            child.aabb = raycast_child_aabb(entry.aabb, child_octant);
+            stack.push_back(child);
+        }
+    }
+}
+
+Chunk::Chunk(glm::vec3 pos, float scale, int resolution)
+    : position(pos), scale(scale), resolution(resolution), nodes(),
+      gpu_mirror(), frozen(), empty_space(), lod(), wgpu() {
+    this->root_node = this->nodes.allocate();
+    this->empty_space.dirty_min = glm::ivec3(INT_MAX);
+    this->empty_space.dirty_max = glm::ivec3(INT_MIN);
+};
+
+Chunk::~Chunk() {
+    if (!this->wgpu.initialized)
+        return;
+
+    this->wgpu.pool->release_entry(this->wgpu.entry);
+};
+
+auto Chunk::init_webgpu(GPUChunkPool *pool) -> void {
+    // initializing twice starts over in a fresh entry
+    release_webgpu();
+
+    this->wgpu.initialized = true;
+    this->wgpu.pool = pool;
+    this->wgpu.entry = pool->create_entry();
+    this->wgpu.slot_capacity = 0;
+    this->wgpu.slot_count = 0;
+
+    reserve_grid_range();
+    write_metadata();
+
+    // get starting data to the gpu! (first flush lays out the whole tree)
+    update_buffers();
+}
+
+auto Chunk::release_webgpu() -> void {
+    if (!this->wgpu.initialized)
+        return;
+
+    this->wgpu.pool->release_entry(this->wgpu.entry);
+
+    this->wgpu.initialized = false;
+    this->wgpu.pool = nullptr;
+    this->wgpu.slot_capacity = 0;
+    this->wgpu.slot_count = 0;
+    this->wgpu.grid_reserved = false;
+
+    // frozen arrays (and the grid) will need to go up again next time, and
+    // everything else in full, so there's no point keeping averages or the
+    // grid around
+    this->frozen.uploaded = false;
+    this->empty_space.grid = DistanceGrid();
+    this->empty_space.stale = true;
+    this->empty_space.uploaded = false;
+    this->lod = {};
+}
+
+auto Chunk::is_webgpu_initialized() const -> bool {
+    return this->wgpu.initialized;
+}
+
+auto Chunk::set_distance_grid_resolution(int resolution) -> void {
+    if (resolution == this->empty_space.resolution)
+        return;
+
+    this->empty_space.resolution = resolution;
+    this->empty_space.grid = DistanceGrid();
+    this->empty_space.stale = true;
+    if (!this->wgpu.initialized)
+        return;
+
+    // nodes stay where they are, only the grid needs a new range
+    reserve_grid_range();
+    write_metadata();
+
+    update_buffers();
+}
+
+auto Chunk::get_distance_grid() -> const DistanceGrid * {
+    if (this->empty_space.resolution == 0)
+        return nullptr;
+
+    update_distance_grid();
+    return &this->empty_space.grid;
+}
+
+auto Chunk::get_bindgroup() const -> wgpu::BindGroup {
+    return this->wgpu.pool->get_bindgroup();
+}
+
+auto Chunk::get_metadata_offset() const -> uint32_t {
+    return this->wgpu.pool->get_metadata_offset(this->wgpu.entry);
+}
+
+auto Chunk::get_metadata() const -> GPUChunkMetadata {
+    return this->wgpu.pool->get_metadata(this->wgpu.entry);
+}
+
+auto Chunk::get_gpu_slot_count() const -> uint32_t {
+    return this->wgpu.slot_count;
+}
+
+auto Chunk::get_bounds() const -> geometry::AABB {
+    float half_size = scale * 0.5f;
+    geometry::AABB bounds;
+    bounds.min = position - glm::vec3(half_size);
+    bounds.max = position + glm::vec3(half_size);
+    return bounds;
+}
+
+auto Chunk::sample_position(glm::vec3 local_position) const
+    -> std::optional<glm::u8vec4> {
+    if (is_frozen()) {
+        return sample_view(FlatView{this->frozen.data.octree_nodes,
+                                    this->frozen.data.voxel_datas},
+                           local_position, this->resolution);
+    }
+    return sample_view(TreeView{this->nodes, this->root_node}, local_position,
+                       this->resolution);
+}
+
+auto Chunk::raycast(const geometry::Ray &ray) const -> geometry::RaycastResult {
+    if (is_frozen()) {
+        return raycast_view(FlatView{this->frozen.data.octree_nodes,
+                                     this->frozen.data.voxel_datas},
+                            ray, get_bounds());
+    }
+    return raycast_view(TreeView{this->nodes, this->root_node}, ray,
+                        get_bounds());
+}
+
+auto Chunk::raycast_packet(const geometry::Ray *rays, uint64_t mask,
+                           geometry::RaycastResult *results) const -> void {
+    // rays heading down different octants take children in different orders,
+    // so each direction gets a walk of its own
+    glm::vec3 inv_dirs[RAYCAST_PACKET_RAYS];
+    uint64_t by_mirror[8] = {};
+    for (int i = 0; i < RAYCAST_PACKET_RAYS; ++i) {
+        if (!(mask >> i & 1))
+            continue;
+
+        int mirror;
+        inv_dirs[i] = raycast_inverse_direction(rays[i].direction, mirror);
+        by_mirror[mirror] |= 1ull << i;
     }
 
-    return closest_hit;
+    geometry::AABB bounds = get_bounds();
+    for (int mirror = 0; mirror < 8; ++mirror) {
+        if (by_mirror[mirror] == 0)
+            continue;
+
+        if (is_frozen()) {
+            raycast_packet_view(FlatView{this->frozen.data.octree_nodes,
+                                         this->frozen.data.voxel_datas},
+                                rays, inv_dirs, by_mirror[mirror], mirror,
+                                bounds, results);
+        } else {
+            raycast_packet_view(TreeView{this->nodes, this->root_node}, rays,
+                                inv_dirs, by_mirror[mirror], mirror, bounds,
+                                results);
+        }
+    }
 }
 
 auto Chunk::set_voxel_filled(int depth, glm::vec3 local_position,
                              glm::u8vec4 color, bool skip_update_buffers)
     -> void {
-    // dig first for the node we want to edit
-    OctreeNode *node = dig_into_tree(local_position, depth);
+    if (depth < 0 || depth > std::log2(this->resolution)) {
+        throw std::invalid_argument(
+            "Depth must be >= 0 and <= log2(resolution)");
+    }
 
-    // we have gotten to our desired depth, now just set active node to leaf
-    node->is_leaf = true;
-    node->leaf_data.color = color;
+    // a voxel either side too, in case rounding digs into a neighbor
+    glm::ivec3 voxel = get_voxel(local_position, depth);
+    begin_edit(depth, voxel - 1, voxel + 1);
+
+    // dig first for the node we want to edit
+    NodeIndex node_index = dig_into_tree(local_position, depth);
+    OctreeNode &node = this->nodes[node_index];
+
+    // we have gotten to our desired depth, now just set active node to leaf,
+    // giving back any children it may have had
+    for (NodeIndex &child : node.children) {
+        if (child != NULL_NODE) {
+            release_subtree(child);
+            child = NULL_NODE;
+        }
+    }
+    node.is_leaf = true;
+    node.leaf_data.color = color;
+    this->gpu_mirror.mark_dirty(node_index);
 
     // relax upwards if possible
-    try_relax_up_from_node(node);
+    try_relax_up_from_node(node_index);
 
     // and of course update buffers for rendering
     if (!skip_update_buffers)
@@ -199,271 +594,468 @@ auto Chunk::set_voxel_filled(int depth, glm::vec3 local_position,
 
 auto Chunk::set_voxel_empty(int depth, glm::vec3 local_position,
                             bool skip_update_buffers) -> void {
+    if (depth < 0 || depth > std::log2(this->resolution)) {
+        throw std::invalid_argument(
+            "Depth must be >= 0 and <= log2(resolution)");
+    }
+
+    glm::ivec3 voxel = get_voxel(local_position, depth);
+    begin_edit(depth, voxel - 1, voxel + 1);
+
     // dig first for the node we want to edit
-    OctreeNode *node = dig_into_tree(local_position, depth);
+    NodeIndex node_index = dig_into_tree(local_position, depth);
+    OctreeNode &node = this->nodes[node_index];
+
+    // we have gotten to our desired depth, now just clear out the node
+    node.is_leaf = false;
+    for (NodeIndex &child : node.children) {
+        if (child != NULL_NODE) {
+            release_subtree(child);
+            child = NULL_NODE;
+        }
+    }
 
-    // we have gotten to our desired depth, now just set active node to leaf
-    node->is_leaf = false;
-    node->children = {};
+    this->gpu_mirror.mark_dirty(node_index);
 
     // could be optimized by digging to the depth 1 above, then just setting the
-    // matching child to nullptr
+    // matching child to NULL_NODE
 
     // relax upwards if possible
-    try_relax_up_from_node(node);
+    try_relax_up_from_node(node_index);
 
     // and of course update buffers for rendering
     if (!skip_update_buffers)
         update_buffers();
 }
 
+auto Chunk::apply_region(int depth, const std::vector<glm::ivec3> &voxels,
+                         RegionEdit::Operation operation, glm::u8vec4 color,
+                         bool skip_update_buffers) -> void {
+    if (depth < 0 || depth > std::log2(this->resolution)) {
+        throw std::invalid_argument(
+            "Depth must be >= 0 and <= log2(resolution)");
+    }
+    if (voxels.empty())
+        return;
+
+    std::vector<uint64_t> codes;
+    codes.reserve(voxels.size());
+    int side = 1 << depth;
+    glm::ivec3 voxel_min(side);
+    glm::ivec3 voxel_max(-1);
+    for (glm::ivec3 voxel : voxels) {
+        if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) ||
+            glm::any(glm::greaterThanEqual(voxel, glm::ivec3(side)))) {
+            throw std::invalid_argument("Region voxel is outside the chunk");
+        }
+        codes.push_back(morton_encode(voxel, depth));
+        voxel_min = glm::min(voxel_min, voxel);
+        voxel_max = glm::max(voxel_max, voxel);
+    }
+    std::sort(codes.begin(), codes.end());
+    codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+
+    begin_edit(depth, voxel_min, voxel_max);
+    apply_region_node(this->root_node, depth, codes.data(),
+                      codes.data() + codes.size(), operation,
+                      VoxelData{color});
+
+    if (!skip_update_buffers)
+        update_buffers();
+}
+
+auto Chunk::capture_cells(const std::vector<glm::ivec3> &voxels,
+                          EditRecord::ChunkCells &cells) const -> void {
+    std::vector<uint64_t> codes;
+    codes.reserve(voxels.size());
+    for (glm::ivec3 voxel : voxels)
+        codes.push_back(morton_encode(voxel, cells.depth));
+    std::sort(codes.begin(), codes.end());
+    codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+
+    auto by_code = [](const std::pair<uint64_t, uint32_t> &a,
+                      const std::pair<uint64_t, uint32_t> &b) {
+        return a.first < b.first;
+    };
+
+    size_t captured = cells.cells.size();
+    for (uint64_t code : codes) {
+        // anything captured earlier is older, keep that
+        std::pair<uint64_t, uint32_t> cell(code, 0);
+        if (std::binary_search(cells.cells.begin(),
+                               cells.cells.begin() + captured, cell, by_code))
+            continue;
+
+        cell.second = static_cast<uint32_t>(cells.tokens.size());
+        cells.cells.push_back(cell);
+        if (is_frozen()) {
+            encode_cell(FlatView{this->frozen.data.octree_nodes,
+                                 this->frozen.data.voxel_datas},
+                        code, cells.depth, cells.tokens);
+        } else {
+            encode_cell(TreeView{this->nodes, this->root_node}, code,
+                        cells.depth, cells.tokens);
+        }
+    }
+
+    // both halves are sorted already
+    std::inplace_merge(cells.cells.begin(), cells.cells.begin() + captured,
+                       cells.cells.end(), by_code);
+}
+
+auto Chunk::swap_cells(EditRecord::ChunkCells &cells, bool skip_update_buffers)
+    -> void {
+    if (cells.depth < 0 || cells.depth > std::log2(this->resolution)) {
+        throw std::invalid_argument(
+            "Depth must be >= 0 and <= log2(resolution)");
+    }
+
+    glm::ivec3 voxel_min(1 << cells.depth);
+    glm::ivec3 voxel_max(-1);
+    for (auto [code, start] : cells.cells) {
+        glm::ivec3 voxel = morton_decode(code, cells.depth);
+        voxel_min = glm::min(voxel_min, voxel);
+        voxel_max = glm::max(voxel_max, voxel);
+    }
+    begin_edit(cells.depth, voxel_min, voxel_max);
+
+    EditRecord::ChunkCells previous{cells.chunk_coord, cells.depth, {}, {}};
+    previous.cells.reserve(cells.cells.size());
+    float side = static_cast<float>(1 << cells.depth);
+    for (auto [code, start] : cells.cells) {
+        previous.cells.push_back(
+            {code, static_cast<uint32_t>(previous.tokens.size())});
+        encode_cell(TreeView{this->nodes, this->root_node}, code, cells.depth,
+                    previous.tokens);
+
+        // digging splits any leaf we're in, so the rest of it keeps its color
+        glm::vec3 local_position =
+            (glm::vec3(morton_decode(code, cells.depth)) + 0.5f) / side -
+            glm::vec3(0.5f);
+        NodeIndex node_index = dig_into_tree(local_position, cells.depth);
+
+        OctreeNode &node = this->nodes[node_index];
+        for (NodeIndex &child : node.children) {
+            if (child != NULL_NODE) {
+                release_subtree(child);
+                child = NULL_NODE;
+            }
+        }
+        const uint32_t *token = cells.tokens.data() + start;
+        decode_cell_subtree(node_index, token);
+
+        // captured subtrees were already merged, so only the way up is left
+        try_relax_up_from_node(node_index);
+    }
+    cells = std::move(previous);
+
+    if (!skip_update_buffers)
+        update_buffers();
+}
+
 auto Chunk::reposition(glm::vec3 pos, float scale) -> void {
     this->position = pos;
     this->scale = scale;
 
-    update_buffers();
+    // octree itself is unaffected, only metadata needs to go up
+    if (this->wgpu.initialized)
+        write_metadata();
 }
 
 auto Chunk::force_update_buffers() -> void { update_buffers(); }
 
+auto Chunk::prepare_buffers() -> void {
+    // frozen arrays are uploaded as they are
+    if (!is_frozen())
+        this->gpu_mirror.flush(this->nodes, this->root_node);
+
+    // only worth (re)building if it's going up
+    if (this->wgpu.grid_reserved && !this->empty_space.uploaded)
+        update_distance_grid();
+}
+
 auto Chunk::set_voxel_grid_data(const uint8_t *data, glm::ivec3 size,
                                 const std::array<glm::u8vec4, 256> &palette,
-                                glm::ivec3 offset) -> void {
+                                glm::ivec3 offset, bool skip_update_buffers)
+    -> void {
     // assume indices are:
     // x + (y * model->size_x) + (z * model->size_x * model->size_y)
 
-    // very jank, we can optimize much better by digging out octree structure in
-    // our region of effect first, and getting a grid-layout vector of
-    // OctreeNode pointers/refs to mutate with our data
+    int max_depth = static_cast<int>(std::log2(this->resolution));
+    begin_edit(max_depth, offset, offset + size - 1);
 
-    for (int x = 0; x < size.x; ++x) {
-        int filled = 0;
-        for (int y = 0; y < size.y; ++y) {
-            for (int z = 0; z < size.z; ++z) {
-                int voxel_index = x + (y * size.x) + (z * size.x * size.y);
+    // merge uniform blocks bottom-up first, so building the tree only has to
+    // descend wherever a block is mixed
+    GridPyramid pyramid(data, size, offset, max_depth);
 
-                auto palette_index = data[voxel_index];
-                if (palette_index == 0)
-                    continue;
+    apply_grid_pyramid(this->root_node, pyramid, max_depth, glm::ivec3(0),
+                       palette);
 
-                glm::u8vec4 color = palette[palette_index];
+    if (!skip_update_buffers)
+        this->update_buffers();
+}
 
-                glm::vec3 coord = glm::ivec3(x, y, z) + offset;
-                glm::vec3 local_position =
-                    glm::vec3(-0.5) +
-                    glm::vec3(1.0f / (float)this->resolution) * coord;
+auto Chunk::update_buffers() -> void {
+    if (!this->wgpu.initialized)
+        return;
 
-                this->set_voxel_filled(9, local_position, color, true);
-                filled++;
-            }
-        }
+    // the grid is its own buffer, so it doesn't care how nodes go up
+    upload_distance_grid();
+
+    // frozen arrays never change, they only have to go up once
+    if (is_frozen()) {
+        if (this->frozen.uploaded)
+            return;
+
+        // exact fit, also shrinking if we were just compressed
+        uint32_t slot_count = this->frozen.data.slot_count;
+        if (!check_gpu_slot_count(slot_count))
+            return;
+        if ((slot_count > this->wgpu.slot_capacity ||
+             slot_count * 2 < this->wgpu.slot_capacity) &&
+            !reserve_node_slots(slot_count))
+            return;
+
+        mark_lod_stale(this->lod, 0, slot_count);
+        upload_slots(this->frozen.data.octree_nodes,
+                     this->frozen.data.voxel_datas, 0, slot_count);
+        this->frozen.uploaded = true;
+        this->lod = {};
+        this->wgpu.slot_count = slot_count;
+        return;
     }
-    this->update_buffers();
-}
 
-auto Chunk::create_bindgroup_layout(wgpu::Device device) -> void {
-    wgpu::BindGroupLayoutEntry bgl_entries[3];
+    // serialize whatever changed since last time (if `prepare_buffers`
+    // hasn't already), picking up every range written since the last upload
+    this->gpu_mirror.flush(this->nodes, this->root_node);
+    auto ranges = this->gpu_mirror.take_dirty_ranges();
+
+    const auto &octree_nodes = this->gpu_mirror.get_octree_nodes();
+    const auto &voxel_datas = this->gpu_mirror.get_voxel_datas();
+    uint32_t slot_count = this->gpu_mirror.get_slot_count();
+    if (!check_gpu_slot_count(slot_count)) {
+        // the ranges we just took get lost, so once we fit again everything
+        // goes up in full
+        this->wgpu.slot_capacity = 0;
+        return;
+    }
 
-    auto &octree_entry = bgl_entries[0];
-    octree_entry.binding = 0;
-    octree_entry.visibility = wgpu::ShaderStage::Fragment;
-    octree_entry.buffer.type = wgpu::BufferBindingType::ReadOnlyStorage;
-    octree_entry.buffer.minBindingSize = sizeof(uint32_t) * 3;
+    // grow our range geometrically if we've run out of room, which means a
+    // full upload into wherever it ends up
+    if (slot_count > this->wgpu.slot_capacity) {
+        if (!reserve_node_slots(
+                std::max(slot_count, this->wgpu.slot_capacity * 2)))
+            return;
+        ranges = {{0, slot_count}};
+    }
 
-    auto &vxdata_entry = bgl_entries[1];
-    vxdata_entry.binding = 1;
-    vxdata_entry.visibility = wgpu::ShaderStage::Fragment;
-    vxdata_entry.buffer.type = wgpu::BufferBindingType::ReadOnlyStorage;
-    vxdata_entry.buffer.minBindingSize = sizeof(uint32_t);
+    // averages depend on the slots below them, which may be in a later range
+    for (const auto &range : ranges) {
+        mark_lod_stale(this->lod, range.begin, range.end);
+    }
 
-    auto &metadata_entry = bgl_entries[2];
-    metadata_entry.binding = 2;
-    metadata_entry.visibility =
-        wgpu::ShaderStage::Vertex | wgpu::ShaderStage::Fragment;
-    metadata_entry.buffer.type = wgpu::BufferBindingType::Uniform;
+    // send just the changed ranges over to the gpu
+    for (const auto &range : ranges) {
+        upload_slots(octree_nodes.data(), voxel_datas.data(), range.begin,
+                     range.end);
+    }
 
-    wgpu::BindGroupLayoutDescriptor bgl_descriptor = {};
-    bgl_descriptor.label = "Chunk data bind group layout";
-    bgl_descriptor.entryCount = 3;
-    bgl_descriptor.entries = &bgl_entries[0];
+    this->wgpu.slot_count = slot_count;
+}
 
-    bindgroup_layout = device.CreateBindGroupLayout(&bgl_descriptor);
+auto Chunk::upload_slots(const GPUOctreeNode *octree_nodes,
+                         const GPUVoxelData *voxel_datas, uint32_t begin,
+                         uint32_t end) -> void {
+    // pack in batches, so a whole frozen chunk doesn't need a second copy
+    std::vector<GPUCompactNode> packed;
+    for (uint32_t batch = begin; batch < end; batch += UPLOAD_BATCH_SLOTS) {
+        uint32_t batch_end = std::min(end, batch + UPLOAD_BATCH_SLOTS);
+        packed.resize(batch_end - batch);
+        pack_slots(octree_nodes, voxel_datas, batch, batch_end, this->lod,
+                   packed.data());
+
+        this->wgpu.pool->write_nodes(this->wgpu.entry, batch, packed.data(),
+                                     static_cast<uint32_t>(packed.size()));
+    }
 }
 
-auto Chunk::get_bindgroup_layout(wgpu::Device device) -> wgpu::BindGroupLayout {
-    if (!bindgroup_layout_created) {
-        create_bindgroup_layout(device);
-        bindgroup_layout_created = true;
+auto Chunk::pack_slots(const GPUOctreeNode *octree_nodes,
+                       const GPUVoxelData *voxel_datas, uint32_t begin,
+                       uint32_t end, LODColors &lod, GPUCompactNode *packed)
+    -> void {
+    for (uint32_t slot = begin; slot < end; ++slot) {
+        const GPUOctreeNode &node = octree_nodes[slot];
+        GPUCompactNode &compact = packed[slot - begin];
+
+        // internal nodes only need their children (and an average color to
+        // stand in for them), leaves only a color
+        if (node.child_mask != 0) {
+            compact.header = node.child_mask | (node.first_child_idx << 8);
+            compact.payload =
+                get_filled_leaf_mask(octree_nodes, voxel_datas, node) << 24 |
+                (get_lod_color(octree_nodes, voxel_datas, slot, lod) &
+                 0xFFFFFF);
+            continue;
+        }
+
+        compact.header = 0;
+        compact.payload = voxel_datas[node.voxel_data_idx].color_packed;
     }
+}
 
-    return bindgroup_layout;
+auto Chunk::get_filled_leaf_mask(const GPUOctreeNode *octree_nodes,
+                                 const GPUVoxelData *voxel_datas,
+                                 const GPUOctreeNode &node) -> uint32_t {
+    uint32_t leaf_mask = 0;
+    uint32_t child_idx = node.first_child_idx;
+    for (int octant = 0; octant < 8; ++octant) {
+        if (!(node.child_mask & (1u << octant)))
+            continue;
+
+        const GPUOctreeNode &child = octree_nodes[child_idx++];
+        uint32_t alpha = voxel_datas[child.voxel_data_idx].color_packed >> 24;
+        if (child.child_mask == 0 && alpha != 0)
+            leaf_mask |= 1u << octant;
+    }
+    return leaf_mask;
 }
 
-auto Chunk::update_buffers() -> void {
-    std::vector<GPUOctreeNode> octree_nodes;
-    std::vector<GPUVoxelData> voxel_datas;
-
-    // fill up buffers
-    build_buffer_data(&octree_nodes, &voxel_datas);
-
-    // destroy old buffers (if they exist)
-    if (this->wgpu.octree_buffer) {
-        this->wgpu.octree_buffer.Destroy();
-    }
-    if (this->wgpu.vxdata_buffer) {
-        this->wgpu.vxdata_buffer.Destroy();
-    }
-    if (this->wgpu.metadata_buffer) {
-        this->wgpu.metadata_buffer.Destroy();
-    }
-
-    auto device = this->wgpu.device;
-    auto octree_size = sizeof(GPUOctreeNode) * octree_nodes.size();
-    auto vxdata_size = sizeof(GPUVoxelData) * voxel_datas.size();
-
-    // new buffers time!
-    {
-        wgpu::BufferDescriptor desc;
-        desc.label = "Octree nodes storage buffer";
-        desc.size = octree_size;
-        desc.usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst;
-        this->wgpu.octree_buffer = device.CreateBuffer(&desc);
-    }
-    {
-        wgpu::BufferDescriptor desc;
-        desc.label = "Voxel data storage buffer";
-        desc.size = vxdata_size;
-        desc.usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst;
-        this->wgpu.vxdata_buffer = device.CreateBuffer(&desc);
-    }
-    {
-        wgpu::BufferDescriptor desc;
-        desc.label = "Chunk metadata uniform buffer";
-        desc.size = sizeof(GPUChunkMetadata);
-        desc.usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst;
-        this->wgpu.metadata_buffer = device.CreateBuffer(&desc);
-    }
-
-    // send it over to the gpu
-    wgpu::Queue queue = device.GetQueue();
-    queue.WriteBuffer(this->wgpu.octree_buffer, 0, octree_nodes.data(),
-                      octree_size);
-    queue.WriteBuffer(this->wgpu.vxdata_buffer, 0, voxel_datas.data(),
-                      vxdata_size);
-
-    GPUChunkMetadata metadata;
-    metadata.position[0] = this->position.x;
-    metadata.position[1] = this->position.y;
-    metadata.position[2] = this->position.z;
-    metadata.size = this->scale;
-    queue.WriteBuffer(this->wgpu.metadata_buffer, 0, &metadata,
-                      sizeof(GPUChunkMetadata));
-
-    // bind group (re)creation!
-    {
-        wgpu::BindGroupEntry entries[3];
-
-        auto &octree_entry = entries[0];
-        octree_entry.binding = 0;
-        octree_entry.buffer = this->wgpu.octree_buffer;
-        octree_entry.offset = 0;
-        octree_entry.size = octree_size;
-
-        auto &vxdata_entry = entries[1];
-        vxdata_entry.binding = 1;
-        vxdata_entry.buffer = this->wgpu.vxdata_buffer;
-        vxdata_entry.offset = 0;
-        vxdata_entry.size = vxdata_size;
-
-        auto &metadata_entry = entries[2];
-        metadata_entry.binding = 2;
-        metadata_entry.buffer = this->wgpu.metadata_buffer;
-        metadata_entry.offset = 0;
-        metadata_entry.size = sizeof(GPUChunkMetadata);
-
-        wgpu::BindGroupDescriptor bg_desc;
-        bg_desc.label = "Chunk data bind group";
-        bg_desc.layout = get_bindgroup_layout(device);
-        bg_desc.entryCount = 3;
-        bg_desc.entries = &entries[0];
-        this->wgpu.bindgroup = device.CreateBindGroup(&bg_desc);
-    }
-}
-
-auto Chunk::build_buffer_data(std::vector<GPUOctreeNode> *octree_nodes,
-                              std::vector<GPUVoxelData> *voxel_datas) const
+auto Chunk::mark_lod_stale(LODColors &lod, uint32_t begin, uint32_t end)
     -> void {
+    if (end > lod.colors.size()) {
+        lod.colors.resize(end, 0);
+        lod.stale.resize(end, true);
+    }
+    std::fill(lod.stale.begin() + begin, lod.stale.begin() + end, true);
+}
 
-    // guarantee at least one voxel data entry (satisfies minBindingSize)
-    // it will have zero opacity LOL
-    // TODO: this should probably be made more intentionally
-    GPUVoxelData empty_voxel{};
-    empty_voxel.color_packed = 0;
-    voxel_datas->push_back(empty_voxel);
-
-    // if no octree yet, push a single empty leaf node.
-    if (!root_node) {
-        GPUOctreeNode empty_leaf{};
-        empty_leaf.child_mask = 0;
-        empty_leaf.first_child_idx = 0;
-        empty_leaf.voxel_data_idx = 0;
-        octree_nodes->push_back(empty_leaf);
-        return;
+auto Chunk::get_lod_color(const GPUOctreeNode *octree_nodes,
+                          const GPUVoxelData *voxel_datas, uint32_t slot,
+                          LODColors &lod) -> uint32_t {
+    const GPUOctreeNode &node = octree_nodes[slot];
+    if (node.child_mask == 0) {
+        // filled leaves cover all of themselves, empty ones nothing
+        uint32_t color = voxel_datas[node.voxel_data_idx].color_packed;
+        return (color >> 24) != 0 ? (color & 0xFFFFFF) | 0xFF000000 : 0;
     }
 
-    // bfs, spit out all children contiguous just how the GPU likes it
-    // (first_child_idx + bitcount to get a specific child)
-    std::queue<const OctreeNode *> bfs;
-    bfs.push(root_node.get());
-
-    while (!bfs.empty()) {
-        const OctreeNode *node = bfs.front();
-        bfs.pop();
-
-        GPUOctreeNode gpu_node{};
-        gpu_node.child_mask = 0;
-        gpu_node.first_child_idx = 0;
-        gpu_node.voxel_data_idx = 0;
-
-        if (node->is_leaf) {
-            // leaf -> child_mask stays 0
-            gpu_node.voxel_data_idx =
-                static_cast<uint32_t>(voxel_datas->size());
-
-            auto c = node->leaf_data.color;
-            GPUVoxelData vdata{};
-            vdata.color_packed = (static_cast<uint32_t>(c.r) << 0) |
-                                 (static_cast<uint32_t>(c.g) << 8) |
-                                 (static_cast<uint32_t>(c.b) << 16) |
-                                 (static_cast<uint32_t>(c.a) << 24);
-            voxel_datas->push_back(vdata);
-        } else {
-            // internal node -> make child_mask from non-null children.
-            for (int i = 0; i < 8; i++) {
-                if (node->children[i]) {
-                    gpu_node.child_mask |= (1u << i);
-                }
-            }
+    if (!lod.stale[slot])
+        return lod.colors[slot];
+
+    // freed slots can get packed along with their neighbors, and whatever
+    // they point at may have been reused since, so guard against cycles
+    lod.colors[slot] = 0;
+    lod.stale[slot] = false;
+
+    // weight each child's color by how much of it is filled
+    uint32_t sums[3] = {0, 0, 0};
+    uint32_t coverage = 0;
+    uint32_t child_idx = node.first_child_idx;
+    for (int octant = 0; octant < 8; ++octant) {
+        if (!(node.child_mask & (1u << octant)))
+            continue;
+
+        uint32_t child =
+            get_lod_color(octree_nodes, voxel_datas, child_idx++, lod);
+        uint32_t child_coverage = child >> 24;
+        for (int channel = 0; channel < 3; ++channel)
+            sums[channel] += ((child >> (channel * 8)) & 0xFF) * child_coverage;
+        coverage += child_coverage;
+    }
 
-            // children will go after all emitted + queued nodes
-            //   index = (emitted) + (queue size) + 1 (this node)
-            gpu_node.first_child_idx =
-                static_cast<uint32_t>(octree_nodes->size() + bfs.size() + 1);
+    uint32_t color = 0;
+    if (coverage != 0) {
+        for (int channel = 0; channel < 3; ++channel)
+            color |= (sums[channel] / coverage) << (channel * 8);
 
-            // enqueue non-null children in octant order (0-7).
-            for (int i = 0; i < 8; i++) {
-                if (node->children[i]) {
-                    bfs.push(node->children[i].get());
-                }
-            }
-        }
+        // rounded up, so a speck of something never averages out to nothing
+        color |= ((coverage + 7) / 8) << 24;
+    }
+
+    lod.colors[slot] = color;
+    return color;
+}
 
-        octree_nodes->push_back(gpu_node);
+auto Chunk::check_gpu_slot_count(uint32_t slot_count) const -> bool {
+    if (slot_count <= MAX_GPU_SLOTS)
+        return true;
+
+    std::cerr << "Chunk has too many nodes to upload (" << slot_count
+              << ", at most " << MAX_GPU_SLOTS << ")" << std::endl;
+    return false;
+}
+
+auto Chunk::reserve_grid_range() -> void {
+    this->empty_space.uploaded = false;
+
+    // a byte per cell, the pool rounds it up to whole words for the shader
+    size_t resolution = this->empty_space.resolution;
+    this->wgpu.grid_reserved =
+        this->wgpu.pool->reserve_grid(this->wgpu.entry,
+                                      resolution * resolution * resolution) &&
+        resolution != 0;
+}
+
+auto Chunk::update_distance_grid() -> void {
+    bool dirty = glm::all(glm::lessThanEqual(this->empty_space.dirty_min,
+                                             this->empty_space.dirty_max));
+    if (this->empty_space.resolution == 0 ||
+        (!this->empty_space.stale && !dirty))
+        return;
+
+    SerializedOctree data = serialize();
+    FlatView view{data.octree_nodes, data.voxel_datas};
+    if (this->empty_space.stale) {
+        this->empty_space.grid.build(view, this->empty_space.resolution);
+    } else {
+        this->empty_space.grid.update(view, this->empty_space.dirty_min,
+                                      this->empty_space.dirty_max);
     }
+    this->empty_space.stale = false;
+    this->empty_space.dirty_min = glm::ivec3(INT_MAX);
+    this->empty_space.dirty_max = glm::ivec3(INT_MIN);
+}
+
+auto Chunk::upload_distance_grid() -> void {
+    if (!this->wgpu.grid_reserved || this->empty_space.uploaded)
+        return;
+
+    update_distance_grid();
+
+    const auto &distances = this->empty_space.grid.get_distances();
+    this->wgpu.pool->write_grid(this->wgpu.entry, distances.data(),
+                                distances.size());
+    this->empty_space.uploaded = true;
 }
 
-auto Chunk::dig_into_tree(glm::vec3 local_position, int depth) -> OctreeNode * {
-    OctreeNode *node = this->root_node.get();
+auto Chunk::reserve_node_slots(uint32_t slot_capacity) -> bool {
+    // whatever we had up is gone either way
+    this->wgpu.slot_count = 0;
+    this->wgpu.slot_capacity = 0;
+    bool reserved =
+        this->wgpu.pool->reserve_nodes(this->wgpu.entry, slot_capacity);
+    if (reserved)
+        this->wgpu.slot_capacity = slot_capacity;
+
+    // our range's base goes in the metadata
+    write_metadata();
+    return reserved;
+}
+
+auto Chunk::write_metadata() -> void {
+    // the pool fills in where our nodes and grid are
+    GPUChunkMetadata metadata = {};
+    metadata.position[0] = this->position.x;
+    metadata.position[1] = this->position.y;
+    metadata.position[2] = this->position.z;
+    metadata.size = this->scale;
+    metadata.grid_resolution =
+        this->wgpu.grid_reserved ? this->empty_space.resolution : 0;
+    this->wgpu.pool->write_metadata(this->wgpu.entry, metadata);
+}
+
+auto Chunk::dig_into_tree(glm::vec3 local_position, int depth) -> NodeIndex {
+    NodeIndex node_index = this->root_node;
 
     if (depth < 0 || depth > std::log2(this->resolution)) {
         throw std::invalid_argument(
@@ -472,19 +1064,11 @@ auto Chunk::dig_into_tree(glm::vec3 local_position, int depth) -> OctreeNode * {
 
     // create required nodes to specific depth
     for (int trav_depth = 0; trav_depth < depth; ++trav_depth) {
-        bool node_is_leaf = node->is_leaf;
-        if (node_is_leaf) {
-            // if we were filled, then fill all children
-            for (int i = 0; i < 8; ++i) {
-                node->children[i] = std::make_unique<OctreeNode>();
-                auto &child = node->children[i];
-
-                child->parent = node;
-                child->is_leaf = true;
-                child->leaf_data = node->leaf_data;
-            }
-        }
-        node->is_leaf = false;
+        // if we were filled, then fill all children
+        split_leaf(node_index);
+
+        // pool slabs never move, so this reference survives allocations
+        OctreeNode &node = this->nodes[node_index];
 
         // dig into specific child node based on position
         int child_index = ((uint32_t)(local_position.x >= 0) << 0) +
@@ -492,70 +1076,463 @@ auto Chunk::dig_into_tree(glm::vec3 local_position, int depth) -> OctreeNode * {
                           ((uint32_t)(local_position.z >= 0) << 2);
 
         // make child node if not exists
-        if (!node->children[child_index]) {
-            node->children[child_index] = std::make_unique<OctreeNode>();
-            auto &child = node->children[child_index];
-
-            child->parent = node;
-            child->is_leaf = node_is_leaf;
-            child->leaf_data = node->leaf_data;
+        if (node.children[child_index] == NULL_NODE) {
+            NodeIndex new_index = this->nodes.allocate();
+            this->nodes[new_index].parent = node_index;
+            node.children[child_index] = new_index;
+            this->gpu_mirror.mark_dirty(node_index);
         }
 
         // put local position into terms of new node bounds
         local_position = glm::fract((local_position + glm::vec3(0.5f)) * 2.0f) -
                          glm::vec3(0.5f);
-        node = node->children[child_index].get();
+        node_index = node.children[child_index];
     }
 
-    return node;
+    return node_index;
 }
 
-auto Chunk::dig_to_depth_everywhere(int depth) -> void {
-    // TODO: implement
+auto Chunk::apply_grid_pyramid(NodeIndex node_index,
+                               const GridPyramid &pyramid, int level,
+                               glm::ivec3 cell,
+                               const std::array<glm::u8vec4, 256> &palette)
+    -> void {
+    uint16_t value = pyramid.sample(level, cell);
+
+    // nothing to write here
+    if (value == 0)
+        return;
+
+    OctreeNode &node = this->nodes[node_index];
+
+    // whole cell is one color, just make a leaf
+    if (value != GridPyramid::MIXED) {
+        for (NodeIndex &child : node.children) {
+            if (child != NULL_NODE) {
+                release_subtree(child);
+                child = NULL_NODE;
+            }
+        }
+        node.is_leaf = true;
+        node.leaf_data.color = palette[value];
+        this->gpu_mirror.mark_dirty(node_index);
+        return;
+    }
+
+    // mixed cell: split leaves so untouched parts keep their color
+    split_leaf(node_index);
+
+    for (int i = 0; i < 8; ++i) {
+        // octant bit layout: xyz, high half of the cell is bit set
+        glm::ivec3 child_cell =
+            cell * 2 + glm::ivec3(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+        if (pyramid.sample(level - 1, child_cell) == 0)
+            continue;
+
+        if (node.children[i] == NULL_NODE) {
+            NodeIndex child_index = this->nodes.allocate();
+            this->nodes[child_index].parent = node_index;
+            node.children[i] = child_index;
+            this->gpu_mirror.mark_dirty(node_index);
+        }
+
+        apply_grid_pyramid(node.children[i], pyramid, level - 1, child_cell,
+                           palette);
+    }
+
+    // merge back up if all children ended up the same leaf
+    try_merge_children(node_index);
 }
 
-auto Chunk::get_grid_pointers(int depth) -> std::vector<OctreeNode *> {
-    // TODO: implement
-    return {};
+auto Chunk::apply_region_node(NodeIndex node_index, int levels,
+                              const uint64_t *begin, const uint64_t *end,
+                              RegionEdit::Operation operation, VoxelData data)
+    -> void {
+    OctreeNode &node = this->nodes[node_index];
+    bool covered = static_cast<uint64_t>(end - begin) ==
+                   static_cast<uint64_t>(1) << (3 * levels);
+
+    // nothing here to erase or paint
+    if (!node.is_leaf && !node.has_children() &&
+        operation != RegionEdit::OPERATION_FILL)
+        return;
+
+    // already the color we want
+    if (node.is_leaf && operation != RegionEdit::OPERATION_ERASE &&
+        node.leaf_data == data)
+        return;
+
+    // whole node is in the region, so it ends up a single leaf (or nothing)
+    if (covered && (node.is_leaf || operation != RegionEdit::OPERATION_PAINT)) {
+        for (NodeIndex &child : node.children) {
+            if (child != NULL_NODE) {
+                release_subtree(child);
+                child = NULL_NODE;
+            }
+        }
+        node.is_leaf = operation != RegionEdit::OPERATION_ERASE;
+        node.leaf_data = data;
+        this->gpu_mirror.mark_dirty(node_index);
+        return;
+    }
+
+    if (covered) {
+        // painting over finer detail: every child is covered too, which a
+        // single code at level 0 stands for
+        for (NodeIndex child : node.children) {
+            if (child != NULL_NODE)
+                apply_region_node(child, 0, begin, begin + 1, operation, data);
+        }
+    } else {
+        // partly covered: split leaves so the rest keeps its color
+        split_leaf(node_index);
+
+        // codes are sorted, so each child's share is the next run of them
+        int shift = 3 * (levels - 1);
+        const uint64_t *run = begin;
+        for (int i = 0; i < 8 && run != end; ++i) {
+            const uint64_t *run_end = std::upper_bound(
+                run, end, i, [shift](int octant, uint64_t code) {
+                    return octant < static_cast<int>((code >> shift) & 7);
+                });
+            if (run == run_end)
+                continue;
+
+            if (node.children[i] == NULL_NODE) {
+                if (operation != RegionEdit::OPERATION_FILL) {
+                    run = run_end;
+                    continue;
+                }
+                NodeIndex child_index = this->nodes.allocate();
+                this->nodes[child_index].parent = node_index;
+                node.children[i] = child_index;
+                this->gpu_mirror.mark_dirty(node_index);
+            }
+
+            apply_region_node(node.children[i], levels - 1, run, run_end,
+                              operation, data);
+            run = run_end;
+
+            // drop children we emptied out
+            const OctreeNode &child = this->nodes[node.children[i]];
+            if (!child.is_leaf && !child.has_children()) {
+                release_node(node.children[i]);
+                node.children[i] = NULL_NODE;
+                this->gpu_mirror.mark_dirty(node_index);
+            }
+        }
+    }
+
+    // merge back up if all children ended up the same leaf
+    try_merge_children(node_index);
 }
 
-auto Chunk::try_relax_up_from_node(OctreeNode *node) -> OctreeNode * {
-    OctreeNode *parent = node->parent;
-    if (!parent)
-        return node;
+auto Chunk::split_leaf(NodeIndex node_index) -> void {
+    // pool slabs never move, so this reference survives allocations
+    OctreeNode &node = this->nodes[node_index];
+    if (!node.is_leaf)
+        return;
+
+    for (int i = 0; i < 8; ++i) {
+        NodeIndex child_index = this->nodes.allocate();
+        OctreeNode &child = this->nodes[child_index];
+
+        child.parent = node_index;
+        child.is_leaf = true;
+        child.leaf_data = node.leaf_data;
+        node.children[i] = child_index;
+    }
+    node.is_leaf = false;
+    this->gpu_mirror.mark_dirty(node_index);
+}
+
+auto Chunk::try_merge_children(NodeIndex node_index) -> bool {
+    OctreeNode &node = this->nodes[node_index];
+    if (node.children[0] == NULL_NODE || !this->nodes[node.children[0]].is_leaf)
+        return false;
 
-    if (!node->is_leaf) {
+    VoxelData data = this->nodes[node.children[0]].leaf_data;
+    for (NodeIndex child : node.children) {
+        if (child == NULL_NODE || !this->nodes[child].is_leaf ||
+            this->nodes[child].leaf_data != data)
+            return false;
+    }
+
+    // copy leaf data up and give the (leaf) children back to the pool
+    node.is_leaf = true;
+    node.leaf_data = data;
+    for (NodeIndex &child : node.children) {
+        release_node(child);
+        child = NULL_NODE;
+    }
+    this->gpu_mirror.mark_dirty(node_index);
+    return true;
+}
+
+auto Chunk::decode_cell_subtree(NodeIndex node_index, const uint32_t *&token)
+    -> void {
+    OctreeNode &node = this->nodes[node_index];
+    uint32_t header = *token++;
+    this->gpu_mirror.mark_dirty(node_index);
+
+    if (header & CELL_TOKEN_LEAF) {
+        uint32_t packed = *token++;
+        node.is_leaf = true;
+        node.leaf_data.color =
+            glm::u8vec4(packed & 0xFF, (packed >> 8) & 0xFF,
+                        (packed >> 16) & 0xFF, (packed >> 24) & 0xFF);
+        return;
+    }
+
+    node.is_leaf = false;
+    for (int i = 0; i < 8; ++i) {
+        if ((header & (1u << i)) == 0)
+            continue;
+
+        NodeIndex child_index = this->nodes.allocate();
+        this->nodes[child_index].parent = node_index;
+        node.children[i] = child_index;
+        decode_cell_subtree(child_index, token);
+    }
+}
+
+auto Chunk::try_relax_up_from_node(NodeIndex node_index) -> NodeIndex {
+    OctreeNode &node = this->nodes[node_index];
+    NodeIndex parent_index = node.parent;
+    if (parent_index == NULL_NODE)
+        return node_index;
+
+    OctreeNode &parent = this->nodes[parent_index];
+
+    if (!node.is_leaf) {
         // internal node: do nothing if still have any children
-        if (node->has_children())
-            return node;
+        if (node.has_children())
+            return node_index;
 
         // delete our node child
-        for (auto &child : parent->children) {
-            if (child.get() == node) {
-                child = nullptr;
+        for (NodeIndex &child : parent.children) {
+            if (child == node_index) {
+                child = NULL_NODE;
                 break;
             }
         }
+        release_node(node_index);
+        this->gpu_mirror.mark_dirty(parent_index);
 
         // recurse up octree
-        return try_relax_up_from_node(parent);
+        return try_relax_up_from_node(parent_index);
     } else {
-        // node is leaf, try to join into parent if all children match
+        // node is leaf, try to join into parent if all children match, ending
+        // recursion if not
+        if (!try_merge_children(parent_index))
+            return node_index;
+
+        // traverse up octree
+        return try_relax_up_from_node(parent_index);
+    }
+}
+
+auto Chunk::serialize() -> SerializedOctree {
+    if (is_frozen())
+        return this->frozen.data;
+
+    // anything flushed here still goes up on the next buffer update
+    this->gpu_mirror.flush(this->nodes, this->root_node);
+    return SerializedOctree{
+        .octree_nodes = this->gpu_mirror.get_octree_nodes().data(),
+        .voxel_datas = this->gpu_mirror.get_voxel_datas().data(),
+        .slot_count = this->gpu_mirror.get_slot_count(),
+    };
+}
+
+auto Chunk::pack_nodes() -> std::vector<GPUCompactNode> {
+    SerializedOctree data = serialize();
 
-        // end recursion if not all children match
-        VoxelData &node_data = node->leaf_data;
-        for (auto &child : parent->children) {
-            if (!child || child->leaf_data != node_data)
-                return node;
+    // averages of our own, so the ones kept for uploads aren't disturbed
+    LODColors lod;
+    mark_lod_stale(lod, 0, data.slot_count);
+    std::vector<GPUCompactNode> packed(data.slot_count);
+    pack_slots(data.octree_nodes, data.voxel_datas, 0, data.slot_count, lod,
+               packed.data());
+    return packed;
+}
+
+auto Chunk::load_serialized(std::shared_ptr<const void> backing,
+                            SerializedOctree data) -> void {
+    if (data.slot_count == 0) {
+        throw std::invalid_argument("Serialized octree must have a root slot");
+    }
+
+    adopt_frozen(std::move(backing), data);
+    this->empty_space.uploaded = false;
+    update_buffers();
+}
+
+auto Chunk::freeze(std::shared_ptr<const void> backing,
+                   SerializedOctree data) -> void {
+    // get any edits that haven't gone up yet onto the gpu first, after which
+    // it holds exactly `data`
+    update_buffers();
+
+    adopt_frozen(std::move(backing), data);
+    this->frozen.uploaded = this->wgpu.initialized;
+}
+
+auto Chunk::adopt_frozen(std::shared_ptr<const void> backing,
+                         SerializedOctree data) -> void {
+    // drop the tree, we'll read from the arrays until someone edits us
+    this->nodes.clear();
+    this->gpu_mirror = OctreeMirror();
+    this->root_node = NULL_NODE;
+
+    this->frozen.backing = std::move(backing);
+    this->frozen.data = data;
+    this->frozen.uploaded = false;
+    this->frozen.heap_bytes = 0;
+
+    // whatever's uploaded still goes with what we hold if we just froze our
+    // own contents, but the cpu copy isn't worth keeping until the next edit
+    this->empty_space.grid = DistanceGrid();
+    this->empty_space.stale = true;
+}
+
+auto Chunk::compress(bool skip_update_buffers) -> void {
+    auto dag = std::make_shared<DagArrays>(
+        is_frozen() ? build_dag(FlatView{this->frozen.data.octree_nodes,
+                                         this->frozen.data.voxel_datas})
+                    : build_dag(TreeView{this->nodes, this->root_node}));
+
+    SerializedOctree data{
+        .octree_nodes = dag->octree_nodes.data(),
+        .voxel_datas = dag->voxel_datas.data(),
+        .slot_count = static_cast<uint32_t>(dag->octree_nodes.size()),
+    };
+    size_t heap_bytes = dag->octree_nodes.capacity() * sizeof(GPUOctreeNode) +
+                        dag->voxel_datas.capacity() * sizeof(GPUVoxelData);
+
+    // the layout is all new, so this goes up in full
+    adopt_frozen(std::move(dag), data);
+    this->frozen.heap_bytes = heap_bytes;
+
+    if (!skip_update_buffers)
+        update_buffers();
+}
+
+auto Chunk::get_backing() const -> std::shared_ptr<const void> {
+    return this->frozen.backing;
+}
+
+auto Chunk::get_cpu_memory_usage() const -> size_t {
+    return this->nodes.get_memory_usage() +
+           this->gpu_mirror.get_memory_usage() + this->frozen.heap_bytes +
+           (this->empty_space.stale
+                ? 0
+                : this->empty_space.grid.get_memory_usage()) +
+           this->lod.colors.capacity() * sizeof(uint32_t) +
+           this->lod.stale.capacity() / 8;
+}
+
+auto Chunk::get_gpu_memory_usage() const -> size_t {
+    // colors are inlined in the nodes
+    size_t slot_size = sizeof(GPUCompactNode);
+    size_t resolution = this->empty_space.resolution;
+    size_t fixed_size =
+        sizeof(GPUChunkMetadata) + resolution * resolution * resolution;
+    if (this->wgpu.initialized)
+        return this->wgpu.slot_capacity * slot_size + fixed_size;
+
+    size_t slot_count = is_frozen()
+                            ? this->frozen.data.slot_count
+                            : std::max<size_t>(this->gpu_mirror.get_slot_count(),
+                                               this->nodes.get_live_count());
+    return slot_count * slot_size + fixed_size;
+}
+
+auto Chunk::is_frozen() const -> bool {
+    return this->frozen.data.octree_nodes != nullptr;
+}
+
+auto Chunk::thaw() -> void {
+    if (!is_frozen())
+        return;
+
+    FlatView view{this->frozen.data.octree_nodes,
+                  this->frozen.data.voxel_datas};
+    this->root_node = this->nodes.allocate();
+
+    // walk the arrays, giving each reachable slot a node
+    std::vector<std::pair<FlatView::Node, NodeIndex>> stack = {
+        {view.get_root(), this->root_node}};
+    while (!stack.empty()) {
+        auto [slot, node_index] = stack.back();
+        stack.pop_back();
+
+        OctreeNode &node = this->nodes[node_index];
+        if (view.is_leaf(slot)) {
+            node.is_leaf = true;
+            node.leaf_data.color = view.get_color(slot);
+            continue;
         }
 
-        // copy leaf data to parent and reset its children to nullptr
-        parent->is_leaf = true;
-        parent->leaf_data = node_data;
-        parent->children = {};
+        for (int i = 0; i < 8; ++i) {
+            FlatView::Node child_slot = view.get_child(slot, i);
+            if (child_slot == FlatView::NONE)
+                continue;
 
-        // traverse up octree
-        return try_relax_up_from_node(parent);
+            NodeIndex child_index = this->nodes.allocate();
+            this->nodes[child_index].parent = node_index;
+            node.children[i] = child_index;
+            stack.push_back({child_slot, child_index});
+        }
+    }
+
+    this->frozen.backing.reset();
+    this->frozen.data = {};
+    this->frozen.heap_bytes = 0;
+
+    // the frozen layout had no free lists, so just start a fresh one; this
+    // re-uploads the chunk once, on its first edit
+    this->gpu_mirror.rebuild(this->nodes, this->root_node);
+}
+
+auto Chunk::begin_edit(int depth, glm::ivec3 voxel_min, glm::ivec3 voxel_max)
+    -> void {
+    thaw();
+
+    this->empty_space.uploaded = false;
+    int resolution = this->empty_space.resolution;
+    if (resolution == 0 || this->empty_space.stale ||
+        glm::any(glm::greaterThan(voxel_min, voxel_max)))
+        return;
+
+    // every cell the voxels overlap, however many voxels a cell is across
+    int side = 1 << depth;
+    voxel_min = glm::clamp(voxel_min, glm::ivec3(0), glm::ivec3(side - 1));
+    voxel_max = glm::clamp(voxel_max, glm::ivec3(0), glm::ivec3(side - 1));
+    glm::ivec3 cell_min = voxel_min * resolution / side;
+    glm::ivec3 cell_max = ((voxel_max + 1) * resolution - 1) / side;
+    this->empty_space.dirty_min =
+        glm::min(this->empty_space.dirty_min, cell_min);
+    this->empty_space.dirty_max =
+        glm::max(this->empty_space.dirty_max, cell_max);
+}
+
+auto Chunk::release_node(NodeIndex node) -> void {
+    this->gpu_mirror.forget(node);
+    this->nodes.release(node);
+}
+
+auto Chunk::release_subtree(NodeIndex node) -> void {
+    std::vector<NodeIndex> stack = {node};
+    while (!stack.empty()) {
+        NodeIndex current = stack.back();
+        stack.pop_back();
+
+        for (NodeIndex child : this->nodes[current].children) {
+            if (child != NULL_NODE)
+                stack.push_back(child);
+        }
+        release_node(current);
     }
 }
 
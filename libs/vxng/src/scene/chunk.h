@@ -1,49 +1,25 @@
 #pragma once
 
+#include "distance-grid.h"
+#include "gpu-chunk-pool.h"
+#include "gpu-types.h"
+#include "grid-pyramid.h"
+#include "node-pool.h"
+#include "octree-mirror.h"
 #include "vxng/geometry.h"
+#include "vxng/scene.h"
 
 #include <glm/glm.hpp>
 #include <webgpu/webgpu_cpp.h>
 
 #include <array>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <vector>
 
 namespace vxng::scene {
 
-typedef struct VoxelData {
-    glm::u8vec4 color; // so much memory eek
-
-    auto operator==(const VoxelData &rhs) -> bool;
-    auto operator!=(const VoxelData &rhs) -> bool;
-} VoxelData;
-
-typedef struct OctreeNode {
-    OctreeNode *parent;
-    bool is_leaf;
-    VoxelData leaf_data;
-    std::array<std::unique_ptr<OctreeNode>, 8> children;
-
-    auto has_children() -> bool;
-} OctreeNode;
-
-typedef struct GPUOctreeNode {
-    uint32_t child_mask;      // leaf node if this is empty
-    uint32_t first_child_idx; // we can find subsequent child indices
-                              // (contiguous) using bitCount(child_mask)
-    uint32_t voxel_data_idx;
-} GPUOctreeNode;
-
-typedef struct GPUVoxelData {
-    uint32_t color_packed;
-} GPUVoxelData;
-
-typedef struct GPUChunkMetadata {
-    float position[3];
-    float size;
-} GPUChunkMetadata;
-
 class Chunk {
   public:
     Chunk(glm::vec3 pos, float scale, int resolution);
@@ -51,13 +27,36 @@ class Chunk {
 
     // --------- Lifecycle ---------
 
-    auto init_webgpu(wgpu::Device device) -> void;
+    /** Takes an entry in `pool` for our nodes, which has to outlive us */
+    auto init_webgpu(GPUChunkPool *pool) -> void;
+    /** Gives our pool entry back, keeping the octree */
+    auto release_webgpu() -> void;
+    auto is_webgpu_initialized() const -> bool;
+    /**
+     * Keeps a `DistanceGrid` of the given resolution alongside the octree,
+     * which the shader uses to skip empty space, or none if 0. Patched
+     * around edits whenever buffers update, and only kept in memory while
+     * it's uploaded or asked for.
+     */
+    auto set_distance_grid_resolution(int resolution) -> void;
 
     // --------- Querying ---------
 
     auto sample_position(glm::vec3 local_position) const
         -> std::optional<glm::u8vec4>;
     auto raycast(const geometry::Ray &ray) const -> geometry::RaycastResult;
+    /**
+     * Same results as `raycast` for each of up to 64 rays, one per bit of
+     * `mask`, walking the octree once for all of them. Rays outside the mask
+     * are skipped, leaving their results alone.
+     */
+    auto raycast_packet(const geometry::Ray *rays, uint64_t mask,
+                        geometry::RaycastResult *results) const -> void;
+    /**
+     * The distance grid for the octree `serialize` returns, brought up to
+     * date first. Null if we don't keep one.
+     */
+    auto get_distance_grid() -> const DistanceGrid *;
 
     // --------- Mutation ---------
 
@@ -66,9 +65,96 @@ class Chunk {
         -> void;
     auto set_voxel_empty(int depth, glm::vec3 local_position,
                          bool skip_update_buffers = false) -> void;
+    /**
+     * Applies `operation` to a set of voxels at `depth`, touching each
+     * affected node once and merging uniform subtrees on the way back up.
+     *
+     * @param voxels  Voxel coords in `[0, 2^depth)`, duplicates are fine
+     */
+    auto apply_region(int depth, const std::vector<glm::ivec3> &voxels,
+                      RegionEdit::Operation operation, glm::u8vec4 color,
+                      bool skip_update_buffers = false) -> void;
+    /**
+     * Appends the current contents of the given cells at `depth` to `cells`,
+     * skipping any it already holds. Each cell becomes a preorder run of
+     * tokens: an internal node is its child mask, followed by its children;
+     * a leaf is a flag above the mask bits, followed by its packed
+     * color. Works frozen.
+     *
+     * @param voxels  Cell coords in `[0, 2^depth)`
+     */
+    auto capture_cells(const std::vector<glm::ivec3> &voxels,
+                       EditRecord::ChunkCells &cells) const -> void;
+    /**
+     * Writes `cells` back into the octree, leaving it holding what those
+     * cells contained before.
+     */
+    auto swap_cells(EditRecord::ChunkCells &cells,
+                    bool skip_update_buffers = false) -> void;
     auto set_voxel_grid_data(const uint8_t *data, glm::ivec3 size,
                              const std::array<glm::u8vec4, 256> &palette,
-                             glm::ivec3 offset) -> void;
+                             glm::ivec3 offset,
+                             bool skip_update_buffers = false) -> void;
+
+    // --------- Serialization ---------
+
+    typedef struct SerializedOctree {
+        const GPUOctreeNode *octree_nodes;
+        const GPUVoxelData *voxel_datas;
+        uint32_t slot_count;
+    } SerializedOctree;
+
+    /**
+     * This chunk's octree in GPU layout, exactly as it gets uploaded. Pending
+     * edits are serialized first. Pointers are valid until the next edit.
+     */
+    auto serialize() -> SerializedOctree;
+    /**
+     * The whole octree packed the way it's uploaded, leaf masks and LOD
+     * averages included, for tracing what the GPU sees on the CPU. Pending
+     * edits are serialized first.
+     */
+    auto pack_nodes() -> std::vector<GPUCompactNode>;
+
+    /**
+     * Adopts already-serialized arrays (e.g. straight out of a mapped scene
+     * file) without building a single node. The chunk stays frozen, answering
+     * queries and uploading straight from `data`, until its first edit thaws
+     * it back into an editable tree.
+     *
+     * @param backing  Keeps the memory behind `data` alive while frozen
+     */
+    auto load_serialized(std::shared_ptr<const void> backing,
+                         SerializedOctree data) -> void;
+
+    /**
+     * Like `load_serialized`, but for a copy of our own `serialize()` output
+     * (e.g. written to disk and mapped back). Frees the node tree without
+     * re-uploading anything, since the GPU already has these arrays.
+     */
+    auto freeze(std::shared_ptr<const void> backing,
+                SerializedOctree data) -> void;
+
+    /**
+     * Freezes this chunk into a sparse voxel DAG (see `build_dag`), so
+     * identical subtrees are stored, and uploaded, only once. Like any frozen
+     * chunk it thaws back into an editable tree on its first edit. Already
+     * frozen chunks are re-encoded from their arrays.
+     */
+    auto compress(bool skip_update_buffers = false) -> void;
+
+    auto is_frozen() const -> bool;
+    /** Whatever keeps the frozen arrays alive, null if not frozen */
+    auto get_backing() const -> std::shared_ptr<const void>;
+
+    // --------- Memory ---------
+
+    /** Heap bytes held by the node tree, or by compressed arrays */
+    auto get_cpu_memory_usage() const -> size_t;
+    /**
+     * Bytes of the pool we hold, estimated from the octree if not initialized
+     */
+    auto get_gpu_memory_usage() const -> size_t;
 
     // --------- Utility ---------
 
@@ -77,50 +163,132 @@ class Chunk {
     /** Sets new position and scale, then updates buffers */
     auto reposition(glm::vec3 pos, float scale) -> void;
     auto force_update_buffers() -> void;
+    /**
+     * The CPU half of a buffer update: re-serializes whatever changed, so the
+     * next update only has uploading left to do. Touches nothing outside this
+     * chunk, so different chunks can prepare on different threads.
+     */
+    auto prepare_buffers() -> void;
 
     // --------- Rendering ---------
 
-    /** For rendering: we can hook up bindgroup to render this chunk */
+    /**
+     * For rendering: the pool's bind group, shared by every chunk, to be set
+     * with `get_metadata_offset` to pick out ours
+     */
     auto get_bindgroup() const -> wgpu::BindGroup;
-
-    /** runs create_bindgroup_layout if not bindgroup_layout_created */
-    static auto get_bindgroup_layout(wgpu::Device device)
-        -> wgpu::BindGroupLayout;
+    auto get_metadata_offset() const -> uint32_t;
+    /** Our metadata as uploaded, including where we are in the pool */
+    auto get_metadata() const -> GPUChunkMetadata;
+    /** Slots at the start of our pool range that are in use */
+    auto get_gpu_slot_count() const -> uint32_t;
 
   private:
-    static wgpu::BindGroupLayout bindgroup_layout; // shared bindgroup layout
-    static bool bindgroup_layout_created;
-    /** should only run this once using `bindgroup_layout_created` */
-    static auto create_bindgroup_layout(wgpu::Device device) -> void;
+    /** Internal nodes' average colors by slot, and which need redoing */
+    typedef struct LODColors {
+        std::vector<uint32_t> colors;
+        std::vector<bool> stale;
+    } LODColors;
 
+    /**
+     * Re-serializes nodes touched since the last update and uploads only the
+     * changed slot ranges. Our pool range is only moved when the node array
+     * outgrows it.
+     */
     auto update_buffers() -> void;
-    auto build_buffer_data(std::vector<GPUOctreeNode> *octree_nodes,
-                           std::vector<GPUVoxelData> *voxel_datas) const
+    /**
+     * Moves our nodes to a pool range of `slot_capacity`, leaving us with
+     * nothing uploaded (and returning false) if the pool is out of room
+     */
+    auto reserve_node_slots(uint32_t slot_capacity) -> bool;
+    /** Packs slots `[begin, end)` of the given arrays and uploads them */
+    auto upload_slots(const GPUOctreeNode *octree_nodes,
+                      const GPUVoxelData *voxel_datas, uint32_t begin,
+                      uint32_t end) -> void;
+    /**
+     * Packs slots `[begin, end)` of the given arrays into `GPUCompactNode`s.
+     * Leaves get their color inlined, and internal nodes get a mask of which
+     * children are filled leaves plus their average color, for LOD.
+     */
+    static auto pack_slots(const GPUOctreeNode *octree_nodes,
+                           const GPUVoxelData *voxel_datas, uint32_t begin,
+                           uint32_t end, LODColors &lod,
+                           GPUCompactNode *packed) -> void;
+    /** Octants of `node`'s children that are leaves with nonzero alpha */
+    static auto get_filled_leaf_mask(const GPUOctreeNode *octree_nodes,
+                                     const GPUVoxelData *voxel_datas,
+                                     const GPUOctreeNode &node) -> uint32_t;
+    /** Averages in `[begin, end)` need redoing before they're next packed */
+    static auto mark_lod_stale(LODColors &lod, uint32_t begin, uint32_t end)
         -> void;
+    /**
+     * Average color of everything below a slot, with how much of the node it
+     * covers (255 being all of it) in place of alpha. Recomputes stale
+     * averages on the way.
+     */
+    static auto get_lod_color(const GPUOctreeNode *octree_nodes,
+                              const GPUVoxelData *voxel_datas, uint32_t slot,
+                              LODColors &lod) -> uint32_t;
+    /** Logs and returns false if compact nodes can't address this many */
+    auto check_gpu_slot_count(uint32_t slot_count) const -> bool;
+    /** Resizes our pool range for the distance grid, if we keep a grid */
+    auto reserve_grid_range() -> void;
+    /**
+     * Builds the distance grid if it's stale, or redoes whatever edits have
+     * touched since
+     */
+    auto update_distance_grid() -> void;
+    auto upload_distance_grid() -> void;
+    auto write_metadata() -> void;
 
     /**
      * Dig into the octree, splitting nodes into children if necessary to reach
-     * the given depth. Returns a pointer to the node at the given depth.
+     * the given depth. Returns the index of the node at the given depth.
      *
      * @param local_position  An internal voxel position, in range [-0.5, 0.5]
      * @param depth           The depth to dig, maxing out at `log2(resolution)`
      */
-    auto dig_into_tree(glm::vec3 local_position, int depth) -> OctreeNode *;
+    auto dig_into_tree(glm::vec3 local_position, int depth) -> NodeIndex;
+
+    /**
+     * Writes a pyramid level's cell into the given node, then recurses into
+     * its children only where the cell is `MIXED`. Empty (0) cells leave
+     * existing voxels untouched. Children that come back uniform are merged
+     * into their parent on the way out, so each node is visited once.
+     *
+     * @param level  Pyramid level matching this node, i.e. `log2(resolution)
+     *               - depth`
+     */
+    auto apply_grid_pyramid(NodeIndex node, const GridPyramid &pyramid,
+                            int level, glm::ivec3 cell,
+                            const std::array<glm::u8vec4, 256> &palette)
+        -> void;
 
     /**
-     * Creates octree internal nodes everywhere within this chunk, up to the
-     * given depth. Should generally be followed by `get_grid_pointers` to get
-     * a structured array of pointers to the new octree nodes.
+     * `apply_region` for one node, `levels` above the edited depth. The node's
+     * voxels are given as sorted Morton codes, so each child's share of them
+     * is a contiguous run.
      */
-    auto dig_to_depth_everywhere(int depth) -> void;
+    auto apply_region_node(NodeIndex node, int levels, const uint64_t *begin,
+                           const uint64_t *end,
+                           RegionEdit::Operation operation, VoxelData data)
+        -> void;
 
     /**
-     * Gets a structured array of pointers to octree nodes at a certain depth.
-     * Should be run after `dig_to_depth_everywhere` for grid-based operations.
+     * Gives a leaf eight leaf children of its color, so part of it can
+     * change while the rest keeps it. Internal nodes are left alone.
+     */
+    auto split_leaf(NodeIndex node) -> void;
+    /**
+     * Turns a node whose children are all leaves of one color into a single
+     * leaf of that color, giving the children back to the pool.
      *
-     * TODO: maybe combine dig_to_depth_everywhere into this
+     * @return whether it merged
      */
-    auto get_grid_pointers(int depth) -> std::vector<OctreeNode *>;
+    auto try_merge_children(NodeIndex node) -> bool;
+
+    /** Rebuilds a node's subtree from tokens, moving `token` past them */
+    auto decode_cell_subtree(NodeIndex node, const uint32_t *&token) -> void;
 
     /**
      * Recursively relax this chunk's octree, starting from the given node.
@@ -128,26 +296,69 @@ class Chunk {
      *
      * A) is a leaf node, or
      *
-     * B) is an internal node, but the `children` array is all `nullptr`
+     * B) is an internal node, but the `children` array is all `NULL_NODE`
      *
-     * Returns a pointer to the upmost relaxed resulting node, which will be the
+     * Released nodes are returned to the chunk's node pool.
+     *
+     * Returns the index of the upmost relaxed resulting node, which will be the
      * same as the input if no relaxation was performed.
      */
-    auto try_relax_up_from_node(OctreeNode *node) -> OctreeNode *;
+    auto try_relax_up_from_node(NodeIndex node) -> NodeIndex;
+
+    /** Frees the node tree and switches over to the given arrays */
+    auto adopt_frozen(std::shared_ptr<const void> backing,
+                      SerializedOctree data) -> void;
+    /** Rebuilds the node tree from frozen arrays, if we're frozen */
+    auto thaw() -> void;
+    /**
+     * Every edit starts here: thaws us, and marks the distance grid cells
+     * under voxels `[voxel_min, voxel_max]` at `depth` for redoing
+     */
+    auto begin_edit(int depth, glm::ivec3 voxel_min, glm::ivec3 voxel_max)
+        -> void;
+
+    /** Gives a node back to the pool, letting the GPU mirror know */
+    auto release_node(NodeIndex node) -> void;
+    auto release_subtree(NodeIndex node) -> void;
 
     glm::vec3 position;
     float scale;
     int resolution;
 
-    std::unique_ptr<OctreeNode> root_node;
+    NodePool nodes;
+    NodeIndex root_node;
+    OctreeMirror gpu_mirror;
+
+    // serialized arrays we were loaded from, in use until the first edit
+    struct {
+        std::shared_ptr<const void> backing;
+        SerializedOctree data;
+        bool uploaded;
+        size_t heap_bytes; // owned by us rather than a mapping
+    } frozen;
+
+    // coarse empty-space map, built from the serialized arrays when stale
+    // (or freed) and otherwise only redone where edits have been since
+    struct {
+        DistanceGrid grid;
+        int resolution; // 0 if we don't keep one
+        bool stale;
+        glm::ivec3 dirty_min; // cells edited since, none if min > max
+        glm::ivec3 dirty_max;
+        bool uploaded; // the pool holds the grid for what we hold now
+    } empty_space;
+
+    // internal nodes' average colors by slot, kept between incremental
+    // uploads. frozen arrays go up in one go, so they don't keep any
+    LODColors lod;
 
     struct {
         bool initialized;
-        wgpu::Device device;
-        wgpu::Buffer octree_buffer;
-        wgpu::Buffer vxdata_buffer;
-        wgpu::Buffer metadata_buffer;
-        wgpu::BindGroup bindgroup;
+        GPUChunkPool *pool;
+        GPUChunkPool::Entry entry;
+        uint32_t slot_capacity; // node slots our pool range can hold
+        uint32_t slot_count;    // of those, how many were last uploaded
+        bool grid_reserved;     // whether the pool has room for our grid
     } wgpu;
 };
 
@@ -0,0 +1,243 @@
+#include "distance-grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+// what empty cells start out as, and the furthest a distance can go
+#define MAX_DISTANCE 255
+// a cell this close to something occupied is where the octree takes over
+#define MIN_SKIP_DISTANCE 2
+// keep in sync with the shader, so both give up at the same point
+#define MAX_SKIP_STEPS 64
+// how far (in cells) past a jump to look up the next cell, so it's the cell
+// being entered rather than the one being left
+#define SKIP_NUDGE 1e-3f
+// flatter ray direction components count as parallel
+#define MIN_DIRECTION 1e-12f
+
+namespace vxng::scene {
+
+DistanceGrid::DistanceGrid() : resolution(0), distances() {}
+
+DistanceGrid::~DistanceGrid() {}
+
+auto DistanceGrid::build(const FlatView &view, int resolution) -> void {
+    this->resolution = resolution;
+
+    size_t cell_count = static_cast<size_t>(resolution) * resolution *
+                        resolution;
+    this->distances.assign((cell_count + 3) & ~size_t(3), MAX_DISTANCE);
+
+    glm::ivec3 grid_max(resolution - 1);
+    mark_occupied(view, view.get_root(), glm::ivec3(0), resolution,
+                  glm::ivec3(0), grid_max);
+    transform_distances(glm::ivec3(0), grid_max);
+}
+
+auto DistanceGrid::update(const FlatView &view, glm::ivec3 dirty_min,
+                          glm::ivec3 dirty_max) -> void {
+    glm::ivec3 grid_max(this->resolution - 1);
+    dirty_min = glm::clamp(dirty_min, glm::ivec3(0), grid_max);
+    dirty_max = glm::clamp(dirty_max, glm::ivec3(0), grid_max);
+
+    // a cell within `margin` of something outside the window is nearer to
+    // that than to anything edited, so it keeps its distance. once the
+    // window is the whole grid there's nothing left outside to check
+    int margin = MIN_SKIP_DISTANCE;
+    glm::ivec3 window_min = glm::max(dirty_min - margin, glm::ivec3(0));
+    glm::ivec3 window_max = glm::min(dirty_max + margin, grid_max);
+    while (!is_border_within(window_min, window_max, margin)) {
+        margin *= 2;
+        window_min = glm::max(dirty_min - margin, glm::ivec3(0));
+        window_max = glm::min(dirty_max + margin, grid_max);
+    }
+
+    // edited cells start over, the rest of the window keeps its occupancy
+    for (int z = window_min.z; z <= window_max.z; ++z) {
+        for (int y = window_min.y; y <= window_max.y; ++y) {
+            for (int x = window_min.x; x <= window_max.x; ++x) {
+                glm::ivec3 cell(x, y, z);
+                uint8_t &distance = this->distances[get_cell_index(cell)];
+                bool dirty = glm::all(glm::greaterThanEqual(cell, dirty_min)) &&
+                             glm::all(glm::lessThanEqual(cell, dirty_max));
+                if (dirty || distance != 0)
+                    distance = MAX_DISTANCE;
+            }
+        }
+    }
+
+    mark_occupied(view, view.get_root(), glm::ivec3(0), this->resolution,
+                  dirty_min, dirty_max);
+    transform_distances(window_min, window_max);
+}
+
+auto DistanceGrid::get_resolution() const -> int { return this->resolution; }
+
+auto DistanceGrid::get_distance(glm::ivec3 cell) const -> uint32_t {
+    return this->distances[get_cell_index(cell)];
+}
+
+auto DistanceGrid::get_distances() const -> const std::vector<uint8_t> & {
+    return this->distances;
+}
+
+auto DistanceGrid::get_memory_usage() const -> size_t {
+    return this->distances.capacity();
+}
+
+auto DistanceGrid::skip_empty_space(const geometry::AABB &bounds,
+                                    const geometry::Ray &ray, float t_min,
+                                    float t_max, uint32_t &steps) const
+    -> float {
+    if (this->resolution == 0)
+        return t_min;
+
+    float cell_size = (bounds.max.x - bounds.min.x) / this->resolution;
+
+    glm::vec3 direction = ray.direction;
+    for (int i = 0; i < 3; ++i) {
+        if (std::fabs(direction[i]) < MIN_DIRECTION)
+            direction[i] = direction[i] < 0.f ? -MIN_DIRECTION : MIN_DIRECTION;
+    }
+    glm::vec3 inv_dir = 1.f / direction;
+    glm::vec3 abs_dir = glm::abs(direction);
+    float nudge = SKIP_NUDGE * cell_size /
+                  std::max(std::max(abs_dir.x, abs_dir.y), abs_dir.z);
+
+    float t = t_min;
+    for (int i = 0; i < MAX_SKIP_STEPS && t < t_max; ++i) {
+        glm::vec3 p =
+            (ray.origin + ray.direction * (t + nudge) - bounds.min) / cell_size;
+        glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor(p)), glm::ivec3(0),
+                                     glm::ivec3(this->resolution - 1));
+
+        // next to something, which the nudge may even have stepped over a
+        // corner of, so let the octree take it from here
+        int distance = static_cast<int>(get_distance(cell));
+        if (distance < MIN_SKIP_DISTANCE)
+            return t;
+
+        // every cell within distance - 1 of this one is empty, so jump to
+        // where the ray leaves that box
+        glm::vec3 box_min =
+            glm::vec3(cell - glm::ivec3(distance - 1)) * cell_size + bounds.min;
+        glm::vec3 box_max =
+            glm::vec3(cell + glm::ivec3(distance)) * cell_size + bounds.min;
+        glm::vec3 t_far;
+        for (int axis = 0; axis < 3; ++axis) {
+            float plane = direction[axis] > 0.f ? box_max[axis] : box_min[axis];
+            t_far[axis] = (plane - ray.origin[axis]) * inv_dir[axis];
+        }
+        t = std::max(t, std::min(std::min(t_far.x, t_far.y), t_far.z));
+        steps++;
+    }
+    return std::min(t, t_max);
+}
+
+auto DistanceGrid::get_cell_index(glm::ivec3 cell) const -> size_t {
+    return static_cast<size_t>(
+        (cell.z * this->resolution + cell.y) * this->resolution + cell.x);
+}
+
+auto DistanceGrid::mark_occupied(const FlatView &view, FlatView::Node node,
+                                 glm::ivec3 cell_min, int cell_span,
+                                 glm::ivec3 clip_min, glm::ivec3 clip_max)
+    -> void {
+    glm::ivec3 min = glm::max(cell_min, clip_min);
+    glm::ivec3 max = glm::min(cell_min + (cell_span - 1), clip_max);
+    if (glm::any(glm::greaterThan(min, max)))
+        return;
+
+    if (view.is_leaf(node)) {
+        for (int z = min.z; z <= max.z; ++z) {
+            for (int y = min.y; y <= max.y; ++y) {
+                size_t row = get_cell_index(glm::ivec3(min.x, y, z));
+                std::fill_n(&this->distances[row], max.x - min.x + 1, 0);
+            }
+        }
+        return;
+    }
+
+    int half_span = cell_span / 2;
+    for (int octant = 0; octant < 8; ++octant) {
+        FlatView::Node child = view.get_child(node, octant);
+        if (child == FlatView::NONE)
+            continue;
+
+        // anything smaller than a cell makes the whole cell count
+        if (cell_span == 1) {
+            this->distances[get_cell_index(cell_min)] = 0;
+            return;
+        }
+
+        glm::ivec3 offset((octant >> 0) & 1, (octant >> 1) & 1,
+                          (octant >> 2) & 1);
+        mark_occupied(view, child, cell_min + offset * half_span, half_span,
+                      clip_min, clip_max);
+    }
+}
+
+auto DistanceGrid::is_border_within(glm::ivec3 min, glm::ivec3 max,
+                                    int distance) const -> bool {
+    glm::ivec3 border_min = glm::max(min - 1, glm::ivec3(0));
+    glm::ivec3 border_max = glm::min(max + 1, glm::ivec3(this->resolution - 1));
+    for (int z = border_min.z; z <= border_max.z; ++z) {
+        for (int y = border_min.y; y <= border_max.y; ++y) {
+            bool crosses = z >= min.z && z <= max.z && y >= min.y &&
+                           y <= max.y;
+            for (int x = border_min.x; x <= border_max.x; ++x) {
+                // rows through the box only have a cell at either end
+                if (crosses && x == min.x) {
+                    x = max.x;
+                    continue;
+                }
+                if (get_distance(glm::ivec3(x, y, z)) >
+                    static_cast<uint32_t>(distance))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+auto DistanceGrid::transform_distances(glm::ivec3 min, glm::ivec3 max)
+    -> void {
+    // two raster passes over the 26-neighborhood give exact chessboard
+    // distances: each pass looks at the neighbors it's already been past
+    int res = this->resolution;
+    auto relax = [this, res](glm::ivec3 cell, int direction) {
+        uint8_t &distance = this->distances[get_cell_index(cell)];
+        for (int dz = -1; dz <= 0; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    // only neighbors strictly before us in this pass
+                    if (dz == 0 && (dy > 0 || (dy == 0 && dx >= 0)))
+                        continue;
+
+                    glm::ivec3 neighbor =
+                        cell + glm::ivec3(dx, dy, dz) * direction;
+                    if (glm::any(glm::lessThan(neighbor, glm::ivec3(0))) ||
+                        glm::any(glm::greaterThanEqual(neighbor,
+                                                       glm::ivec3(res))))
+                        continue;
+
+                    int through = this->distances[get_cell_index(neighbor)] + 1;
+                    if (through < distance)
+                        distance = static_cast<uint8_t>(through);
+                }
+            }
+        }
+    };
+
+    for (int z = min.z; z <= max.z; ++z)
+        for (int y = min.y; y <= max.y; ++y)
+            for (int x = min.x; x <= max.x; ++x)
+                relax(glm::ivec3(x, y, z), 1);
+
+    for (int z = max.z; z >= min.z; --z)
+        for (int y = max.y; y >= min.y; --y)
+            for (int x = max.x; x >= min.x; --x)
+                relax(glm::ivec3(x, y, z), -1);
+}
+
+} // namespace vxng::scene
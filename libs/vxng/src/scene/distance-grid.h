@@ -0,0 +1,87 @@
+#pragma once
+
+#include "octree-view.h"
+#include "vxng/geometry.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace vxng::scene {
+
+/**
+ * Coarse empty-space map of a chunk: a cube of `resolution`^3 cells over it,
+ * each holding the Chebyshev distance (in cells) to the nearest cell with
+ * anything in it, 0 being such a cell. Every cell within `distance - 1` of one
+ * is empty, so a ray can jump across that whole box in one step instead of
+ * walking the octree through it.
+ *
+ * Distances are a byte each, x fastest, which the chunk shader reads four to
+ * a word.
+ */
+class DistanceGrid {
+  public:
+    DistanceGrid();
+    ~DistanceGrid();
+
+    /**
+     * Rebuilds the grid over an octree. Cells are marked occupied by any leaf
+     * overlapping them, or conservatively by any subtree at cell size.
+     *
+     * @param resolution  Cells along each axis, a power of 2
+     */
+    auto build(const FlatView &view, int resolution) -> void;
+    /**
+     * Brings the grid up to date after the octree changed only within cells
+     * `[dirty_min, dirty_max]`. Redoes a window around them, grown until
+     * everything outside it is closer to something unchanged than to the
+     * edit, so it ends up the same as a full `build`.
+     */
+    auto update(const FlatView &view, glm::ivec3 dirty_min,
+                glm::ivec3 dirty_max) -> void;
+
+    auto get_resolution() const -> int;
+    /** @param cell  In `[0, resolution)` */
+    auto get_distance(glm::ivec3 cell) const -> uint32_t;
+    /** Every cell's distance, padded out to a whole number of words */
+    auto get_distances() const -> const std::vector<uint8_t> &;
+    auto get_memory_usage() const -> size_t;
+
+    /**
+     * Jumps a ray over empty cells, the same way the chunk shader's
+     * `skipEmptySpace` does, starting from `t_min`. Stops next to anything
+     * occupied, so no leaf the ray would have hit is ever skipped.
+     *
+     * @param bounds  The chunk's world space cube
+     * @param steps   Incremented once per jump
+     * @return        The t to start traversing the octree from, or `t_max`
+     *                if the ray leaves the chunk through empty space
+     */
+    auto skip_empty_space(const geometry::AABB &bounds,
+                          const geometry::Ray &ray, float t_min, float t_max,
+                          uint32_t &steps) const -> float;
+
+  private:
+    int resolution;
+    std::vector<uint8_t> distances;
+
+    auto get_cell_index(glm::ivec3 cell) const -> size_t;
+    /**
+     * Marks every cell the node overlaps that it has anything in, within
+     * `[clip_min, clip_max]`
+     */
+    auto mark_occupied(const FlatView &view, FlatView::Node node,
+                       glm::ivec3 cell_min, int cell_span, glm::ivec3 clip_min,
+                       glm::ivec3 clip_max) -> void;
+    /** Whether every cell just outside `[min, max]` is within `distance` */
+    auto is_border_within(glm::ivec3 min, glm::ivec3 max, int distance) const
+        -> bool;
+    /**
+     * Turns occupied (0) / empty (max) cells in `[min, max]` into distances,
+     * taking the cells around them as they are
+     */
+    auto transform_distances(glm::ivec3 min, glm::ivec3 max) -> void;
+};
+
+} // namespace vxng::scene
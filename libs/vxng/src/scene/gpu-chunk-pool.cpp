@@ -0,0 +1,412 @@
+#include "gpu-chunk-pool.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+// 128MB of each, WebGPU's default storage binding limit
+#define MAX_NODE_SLOTS ((1u << 27) / sizeof(GPUCompactNode))
+#define MAX_GRID_WORDS ((1u << 27) / sizeof(uint32_t))
+// smallest buffers we bother creating
+#define MIN_NODE_SLOTS (1u << 16)
+#define MIN_GRID_WORDS (1u << 10)
+#define MIN_METADATA_ENTRIES 64
+// WebGPU's default minUniformBufferOffsetAlignment
+#define METADATA_STRIDE 256
+
+namespace vxng::scene {
+
+wgpu::BindGroupLayout GPUChunkPool::bindgroup_layout = nullptr;
+
+RangeAllocator::RangeAllocator() : free_ranges(), capacity(0), free_count(0) {}
+
+auto RangeAllocator::reset(uint32_t capacity, uint32_t used) -> void {
+    this->free_ranges.clear();
+    this->capacity = capacity;
+    this->free_count = capacity - used;
+    if (used < capacity)
+        this->free_ranges[used] = capacity - used;
+}
+
+auto RangeAllocator::allocate(uint32_t size) -> uint32_t {
+    for (auto it = this->free_ranges.begin(); it != this->free_ranges.end();
+         ++it) {
+        if (it->second < size)
+            continue;
+
+        uint32_t offset = it->first;
+        uint32_t remaining = it->second - size;
+        this->free_ranges.erase(it);
+        if (remaining != 0)
+            this->free_ranges[offset + size] = remaining;
+        this->free_count -= size;
+        return offset;
+    }
+    return NONE;
+}
+
+auto RangeAllocator::free(uint32_t offset, uint32_t size) -> void {
+    this->free_count += size;
+
+    // swallow the range after us, then let the one before swallow us
+    auto next = this->free_ranges.lower_bound(offset);
+    if (next != this->free_ranges.end() && offset + size == next->first) {
+        size += next->second;
+        next = this->free_ranges.erase(next);
+    }
+    if (next != this->free_ranges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += size;
+            return;
+        }
+    }
+    this->free_ranges.emplace_hint(next, offset, size);
+}
+
+auto RangeAllocator::get_capacity() const -> uint32_t { return this->capacity; }
+
+auto RangeAllocator::get_free_count() const -> uint32_t {
+    return this->free_count;
+}
+
+GPUChunkPool::GPUChunkPool()
+    : entries(), free_entries(),
+      node_arena{"Chunk pool nodes storage buffer", sizeof(GPUCompactNode),
+                 MIN_NODE_SLOTS, MAX_NODE_SLOTS, &EntryState::nodes,
+                 RangeAllocator(), nullptr},
+      grid_arena{"Chunk pool distance grids storage buffer", sizeof(uint32_t),
+                 MIN_GRID_WORDS, MAX_GRID_WORDS, &EntryState::grid,
+                 RangeAllocator(), nullptr},
+      metadata_capacity(0), wgpu() {}
+
+GPUChunkPool::~GPUChunkPool() {
+    if (!this->wgpu.initialized)
+        return;
+
+    this->node_arena.buffer.Destroy();
+    this->grid_arena.buffer.Destroy();
+    this->wgpu.metadata_buffer.Destroy();
+}
+
+auto GPUChunkPool::init_webgpu(wgpu::Device device) -> void {
+    this->wgpu.initialized = true;
+    this->wgpu.device = device;
+
+    // start out small, with everything free
+    wgpu::BufferDescriptor desc;
+    for (Arena *arena : {&this->node_arena, &this->grid_arena}) {
+        desc.label = arena->label;
+        desc.size = arena->unit_size * arena->min_capacity;
+        desc.usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst |
+                     wgpu::BufferUsage::CopySrc;
+        arena->buffer = device.CreateBuffer(&desc);
+        arena->ranges.reset(arena->min_capacity, 0);
+    }
+
+    this->metadata_capacity = 0;
+    reserve_metadata(MIN_METADATA_ENTRIES);
+}
+
+auto GPUChunkPool::create_entry() -> Entry {
+    Entry entry;
+    if (!this->free_entries.empty()) {
+        entry = this->free_entries.back();
+        this->free_entries.pop_back();
+    } else {
+        entry = static_cast<Entry>(this->entries.size());
+        this->entries.emplace_back();
+        reserve_metadata(static_cast<uint32_t>(this->entries.size()));
+    }
+
+    this->entries[entry] = {};
+    this->entries[entry].live = true;
+    return entry;
+}
+
+auto GPUChunkPool::release_entry(Entry entry) -> void {
+    EntryState &state = this->entries[entry];
+    for (Arena *arena : {&this->node_arena, &this->grid_arena}) {
+        Region &region = state.*arena->region;
+        if (region.size != 0)
+            arena->ranges.free(region.base, region.size);
+    }
+    state = {};
+    this->free_entries.push_back(entry);
+}
+
+auto GPUChunkPool::compact() -> void {
+    if (!this->wgpu.initialized)
+        return;
+
+    // a paged out scene shouldn't keep holding on to its peak
+    shrink_if_sparse(this->node_arena);
+    shrink_if_sparse(this->grid_arena);
+}
+
+auto GPUChunkPool::reserve_nodes(Entry entry, uint32_t slot_capacity) -> bool {
+    return reserve(this->node_arena, entry, slot_capacity);
+}
+
+auto GPUChunkPool::reserve_grid(Entry entry, size_t size) -> bool {
+    // a byte per cell, padded out to whole words
+    size_t word_count = (size + 3) / sizeof(uint32_t);
+    if (word_count > this->grid_arena.max_capacity) {
+        std::cerr << "Distance grid too big for the chunk pool (" << size
+                  << " bytes)" << std::endl;
+        reserve(this->grid_arena, entry, 0);
+        return false;
+    }
+    return reserve(this->grid_arena, entry, static_cast<uint32_t>(word_count));
+}
+
+auto GPUChunkPool::write_nodes(Entry entry, uint32_t first_slot,
+                               const GPUCompactNode *nodes, uint32_t count)
+    -> void {
+    const Region &region = this->entries[entry].nodes;
+    if (first_slot + count > region.size) {
+        throw std::invalid_argument("Nodes written past the entry's range");
+    }
+
+    wgpu::Queue queue = this->wgpu.device.GetQueue();
+    queue.WriteBuffer(this->node_arena.buffer,
+                      sizeof(GPUCompactNode) * (region.base + first_slot),
+                      nodes, sizeof(GPUCompactNode) * count);
+}
+
+auto GPUChunkPool::write_grid(Entry entry, const void *data, size_t size)
+    -> void {
+    const Region &region = this->entries[entry].grid;
+    if (size > sizeof(uint32_t) * region.size) {
+        throw std::invalid_argument("Grid written past the entry's range");
+    }
+
+    wgpu::Queue queue = this->wgpu.device.GetQueue();
+    queue.WriteBuffer(this->grid_arena.buffer, sizeof(uint32_t) * region.base,
+                      data, size);
+}
+
+auto GPUChunkPool::write_metadata(Entry entry,
+                                  const GPUChunkMetadata &metadata) -> void {
+    EntryState &state = this->entries[entry];
+    state.metadata = metadata;
+    state.metadata.node_base = state.nodes.base;
+    state.metadata.grid_base = state.grid.base;
+
+    wgpu::Queue queue = this->wgpu.device.GetQueue();
+    queue.WriteBuffer(this->wgpu.metadata_buffer, get_metadata_offset(entry),
+                      &state.metadata, sizeof(GPUChunkMetadata));
+}
+
+auto GPUChunkPool::get_metadata(Entry entry) const -> GPUChunkMetadata {
+    return this->entries[entry].metadata;
+}
+
+auto GPUChunkPool::get_metadata_offset(Entry entry) const -> uint32_t {
+    return entry * METADATA_STRIDE;
+}
+
+auto GPUChunkPool::get_node_buffer() const -> wgpu::Buffer {
+    return this->node_arena.buffer;
+}
+
+auto GPUChunkPool::get_grid_buffer() const -> wgpu::Buffer {
+    return this->grid_arena.buffer;
+}
+
+auto GPUChunkPool::get_memory_usage() const -> size_t {
+    if (!this->wgpu.initialized)
+        return 0;
+
+    return this->node_arena.buffer.GetSize() +
+           this->grid_arena.buffer.GetSize() +
+           this->wgpu.metadata_buffer.GetSize();
+}
+
+auto GPUChunkPool::get_bindgroup() const -> wgpu::BindGroup {
+    return this->wgpu.bindgroup;
+}
+
+auto GPUChunkPool::create_bindgroup_layout(wgpu::Device device) -> void {
+    wgpu::BindGroupLayoutEntry bgl_entries[3];
+
+    auto &octree_entry = bgl_entries[0];
+    octree_entry.binding = 0;
+    octree_entry.visibility = wgpu::ShaderStage::Fragment;
+    octree_entry.buffer.type = wgpu::BufferBindingType::ReadOnlyStorage;
+    octree_entry.buffer.minBindingSize = sizeof(GPUCompactNode);
+
+    // one chunk's worth, wherever its offset puts it
+    auto &metadata_entry = bgl_entries[1];
+    metadata_entry.binding = 1;
+    metadata_entry.visibility =
+        wgpu::ShaderStage::Vertex | wgpu::ShaderStage::Fragment;
+    metadata_entry.buffer.type = wgpu::BufferBindingType::Uniform;
+    metadata_entry.buffer.hasDynamicOffset = true;
+    metadata_entry.buffer.minBindingSize = sizeof(GPUChunkMetadata);
+
+    auto &grid_entry = bgl_entries[2];
+    grid_entry.binding = 2;
+    grid_entry.visibility = wgpu::ShaderStage::Fragment;
+    grid_entry.buffer.type = wgpu::BufferBindingType::ReadOnlyStorage;
+    grid_entry.buffer.minBindingSize = sizeof(uint32_t);
+
+    wgpu::BindGroupLayoutDescriptor bgl_descriptor = {};
+    bgl_descriptor.label = "Chunk pool bind group layout";
+    bgl_descriptor.entryCount = 3;
+    bgl_descriptor.entries = &bgl_entries[0];
+
+    bindgroup_layout = device.CreateBindGroupLayout(&bgl_descriptor);
+}
+
+auto GPUChunkPool::get_bindgroup_layout(wgpu::Device device)
+    -> wgpu::BindGroupLayout {
+    if (!bindgroup_layout)
+        create_bindgroup_layout(device);
+
+    return bindgroup_layout;
+}
+
+auto GPUChunkPool::reserve(Arena &arena, Entry entry, uint32_t size) -> bool {
+    Region &region = this->entries[entry].*arena.region;
+    if (region.size == size)
+        return true;
+
+    if (region.size != 0)
+        arena.ranges.free(region.base, region.size);
+    region = {0, 0};
+
+    if (size == 0)
+        return true;
+
+    uint32_t base = arena.ranges.allocate(size);
+    if (base == RangeAllocator::NONE) {
+        uint32_t capacity = arena.ranges.get_capacity();
+        size_t needed =
+            static_cast<size_t>(capacity - arena.ranges.get_free_count()) +
+            size;
+        if (needed > arena.max_capacity) {
+            std::cerr << "Out of room in " << arena.label << " (" << needed
+                      << " units, at most " << arena.max_capacity << ")"
+                      << std::endl;
+            return false;
+        }
+
+        // packing alone is enough if it leaves some room to spare, otherwise
+        // grow so the next few don't land here again
+        if (needed * 4 > static_cast<size_t>(capacity) * 3)
+            capacity = static_cast<uint32_t>(std::clamp<size_t>(
+                needed * 2, arena.min_capacity, arena.max_capacity));
+        relocate(arena, capacity);
+        base = arena.ranges.allocate(size);
+    }
+    region = {base, size};
+    return true;
+}
+
+auto GPUChunkPool::relocate(Arena &arena, uint32_t capacity) -> void {
+    wgpu::Device device = this->wgpu.device;
+
+    wgpu::BufferDescriptor desc;
+    desc.label = arena.label;
+    desc.size = arena.unit_size * capacity;
+    desc.usage = wgpu::BufferUsage::Storage | wgpu::BufferUsage::CopyDst |
+                 wgpu::BufferUsage::CopySrc;
+    wgpu::Buffer buffer = device.CreateBuffer(&desc);
+
+    // everything live moves down to the start, in entry order. queued
+    // writes to the old buffer land before these copies do
+    wgpu::CommandEncoder encoder = device.CreateCommandEncoder();
+    uint32_t used = 0;
+    for (EntryState &state : this->entries) {
+        Region &region = state.*arena.region;
+        if (!state.live || region.size == 0)
+            continue;
+
+        encoder.CopyBufferToBuffer(arena.buffer, arena.unit_size * region.base,
+                                   buffer, arena.unit_size * used,
+                                   arena.unit_size * region.size);
+        region.base = used;
+        used += region.size;
+    }
+    wgpu::CommandBuffer commands = encoder.Finish();
+    device.GetQueue().Submit(1, &commands);
+
+    arena.buffer.Destroy();
+    arena.buffer = buffer;
+    arena.ranges.reset(capacity, used);
+
+    write_all_metadata();
+    create_bindgroup();
+}
+
+auto GPUChunkPool::shrink_if_sparse(Arena &arena) -> void {
+    // only once it's mostly empty, and to twice what's live, so growing and
+    // shrinking don't take turns
+    uint32_t capacity = arena.ranges.get_capacity();
+    uint32_t live = capacity - arena.ranges.get_free_count();
+    if (capacity <= arena.min_capacity ||
+        static_cast<size_t>(live) * 4 >= capacity)
+        return;
+
+    relocate(arena, std::max(live * 2, arena.min_capacity));
+}
+
+auto GPUChunkPool::reserve_metadata(uint32_t entry_count) -> void {
+    if (entry_count <= this->metadata_capacity)
+        return;
+
+    if (this->wgpu.metadata_buffer)
+        this->wgpu.metadata_buffer.Destroy();
+
+    uint32_t capacity =
+        std::max({entry_count, this->metadata_capacity * 2,
+                  static_cast<uint32_t>(MIN_METADATA_ENTRIES)});
+
+    wgpu::BufferDescriptor desc;
+    desc.label = "Chunk pool metadata uniform buffer";
+    desc.size = static_cast<size_t>(METADATA_STRIDE) * capacity;
+    desc.usage = wgpu::BufferUsage::Uniform | wgpu::BufferUsage::CopyDst;
+    this->wgpu.metadata_buffer = this->wgpu.device.CreateBuffer(&desc);
+    this->metadata_capacity = capacity;
+
+    write_all_metadata();
+    create_bindgroup();
+}
+
+auto GPUChunkPool::write_all_metadata() -> void {
+    for (Entry entry = 0; entry < this->entries.size(); ++entry) {
+        if (this->entries[entry].live)
+            write_metadata(entry, this->entries[entry].metadata);
+    }
+}
+
+auto GPUChunkPool::create_bindgroup() -> void {
+    // not everything exists yet while we're being initialized
+    if (!this->node_arena.buffer || !this->grid_arena.buffer ||
+        !this->wgpu.metadata_buffer)
+        return;
+
+    std::array<wgpu::BindGroupEntry, 3> entries;
+    std::array<wgpu::Buffer, 3> buffers = {this->node_arena.buffer,
+                                           this->wgpu.metadata_buffer,
+                                           this->grid_arena.buffer};
+    for (uint32_t i = 0; i < entries.size(); ++i) {
+        entries[i].binding = i;
+        entries[i].buffer = buffers[i];
+        entries[i].offset = 0;
+        entries[i].size = buffers[i].GetSize();
+    }
+    entries[1].size = sizeof(GPUChunkMetadata);
+
+    wgpu::BindGroupDescriptor desc;
+    desc.label = "Chunk pool bind group";
+    desc.layout = get_bindgroup_layout(this->wgpu.device);
+    desc.entryCount = entries.size();
+    desc.entries = entries.data();
+    this->wgpu.bindgroup = this->wgpu.device.CreateBindGroup(&desc);
+}
+
+} // namespace vxng::scene
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "gpu-types.h"
+
+#include <webgpu/webgpu_cpp.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace vxng::scene {
+
+/**
+ * First-fit free list over a range of units, merging neighbors as they're
+ * freed so holes don't splinter any more than they have to.
+ */
+class RangeAllocator {
+  public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    RangeAllocator();
+
+    /** Forgets every allocation, leaving `[used, capacity)` free */
+    auto reset(uint32_t capacity, uint32_t used) -> void;
+    /** @return the start of `size` free units, or `NONE` if there isn't one */
+    auto allocate(uint32_t size) -> uint32_t;
+    auto free(uint32_t offset, uint32_t size) -> void;
+
+    auto get_capacity() const -> uint32_t;
+    auto get_free_count() const -> uint32_t;
+
+  private:
+    std::map<uint32_t, uint32_t> free_ranges; // offset -> size
+    uint32_t capacity;
+    uint32_t free_count;
+};
+
+/**
+ * Scene-wide GPU memory for chunks. Every chunk's nodes are sub-allocated out
+ * of one shared storage buffer and its distance grid out of another, while
+ * its metadata gets a slot in one uniform buffer bound at a dynamic offset.
+ * All chunks share a single bind group, so nothing is created or destroyed
+ * per chunk, or per upload.
+ *
+ * When a range doesn't fit anywhere, every live range is copied, packed
+ * tightly, into a new buffer on the GPU (growing it if need be), which also
+ * clears out whatever holes had built up. The same happens to shrink a
+ * buffer that's mostly empty, but only on `compact`, so releasing a whole
+ * scene's worth of entries moves things once rather than once per entry.
+ * Metadata holds each chunk's node and grid offsets, so it's rewritten
+ * whenever they move.
+ */
+class GPUChunkPool {
+  public:
+    typedef uint32_t Entry; // a chunk's allocations, also its metadata slot
+
+    GPUChunkPool();
+    ~GPUChunkPool();
+
+    auto init_webgpu(wgpu::Device device) -> void;
+
+    /** A new entry with a metadata slot, but no nodes or grid yet */
+    auto create_entry() -> Entry;
+    /** Frees everything the entry holds, after which it may be reused */
+    auto release_entry(Entry entry) -> void;
+    /** Shrinks buffers left mostly empty by releases, meant once a frame */
+    auto compact() -> void;
+
+    /**
+     * Gives the entry room for exactly `slot_capacity` nodes, moving it if it
+     * has to, in which case its old contents are lost.
+     *
+     * @return false (after logging) if the pool can't grow that far, leaving
+     *         the entry without any nodes
+     */
+    auto reserve_nodes(Entry entry, uint32_t slot_capacity) -> bool;
+    /** Same as `reserve_nodes`, for a distance grid of `size` bytes (or 0) */
+    auto reserve_grid(Entry entry, size_t size) -> bool;
+
+    /** @param first_slot  Relative to the start of the entry's nodes */
+    auto write_nodes(Entry entry, uint32_t first_slot,
+                     const GPUCompactNode *nodes, uint32_t count) -> void;
+    auto write_grid(Entry entry, const void *data, size_t size) -> void;
+    /** Node and grid offsets are filled in for us */
+    auto write_metadata(Entry entry, const GPUChunkMetadata &metadata)
+        -> void;
+
+    /** Metadata as uploaded, offsets and all */
+    auto get_metadata(Entry entry) const -> GPUChunkMetadata;
+    /** Where the entry's metadata is in the uniform buffer, in bytes */
+    auto get_metadata_offset(Entry entry) const -> uint32_t;
+
+    auto get_node_buffer() const -> wgpu::Buffer;
+    auto get_grid_buffer() const -> wgpu::Buffer;
+    /** Bytes of every buffer we hold, in use or not */
+    auto get_memory_usage() const -> size_t;
+
+    /**
+     * For rendering: nodes, metadata and grids as group 2, to be set with a
+     * chunk's `get_metadata_offset`
+     */
+    auto get_bindgroup() const -> wgpu::BindGroup;
+
+    /** runs create_bindgroup_layout the first time */
+    static auto get_bindgroup_layout(wgpu::Device device)
+        -> wgpu::BindGroupLayout;
+
+  private:
+    static wgpu::BindGroupLayout bindgroup_layout;
+    static auto create_bindgroup_layout(wgpu::Device device) -> void;
+
+    typedef struct Region {
+        uint32_t base; // in units of the buffer it's in
+        uint32_t size;
+    } Region;
+
+    typedef struct EntryState {
+        bool live;
+        Region nodes;
+        Region grid;
+        GPUChunkMetadata metadata;
+    } EntryState;
+
+    // nodes and grids are handled the same way, just in different units
+    typedef struct Arena {
+        const char *label;
+        size_t unit_size; // bytes
+        uint32_t min_capacity;
+        uint32_t max_capacity;
+        Region EntryState::*region;
+        RangeAllocator ranges;
+        wgpu::Buffer buffer;
+    } Arena;
+
+    /** `reserve_nodes`/`reserve_grid` in `arena`'s units */
+    auto reserve(Arena &arena, Entry entry, uint32_t size) -> bool;
+    /**
+     * Copies every live region of `arena` into a new buffer of `capacity`
+     * units, packed from the start
+     */
+    auto relocate(Arena &arena, uint32_t capacity) -> void;
+    /** Relocates into a smaller buffer if most of this one is free */
+    auto shrink_if_sparse(Arena &arena) -> void;
+    /** Makes room for `entry_count` metadata slots */
+    auto reserve_metadata(uint32_t entry_count) -> void;
+    /** Puts every live entry's metadata back up, offsets and all */
+    auto write_all_metadata() -> void;
+    auto create_bindgroup() -> void;
+
+    std::vector<EntryState> entries;
+    std::vector<Entry> free_entries;
+    Arena node_arena;
+    Arena grid_arena;
+    uint32_t metadata_capacity; // entries the metadata buffer has room for
+
+    struct {
+        bool initialized;
+        wgpu::Device device;
+        wgpu::Buffer metadata_buffer;
+        wgpu::BindGroup bindgroup;
+    } wgpu;
+};
+
+} // namespace vxng::scene
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vxng::scene {
+
+typedef struct GPUOctreeNode {
+    uint32_t child_mask;      // leaf node if this is empty
+    uint32_t first_child_idx; // we can find subsequent child indices
+                              // (contiguous) using bitCount(child_mask)
+    uint32_t voxel_data_idx;
+} GPUOctreeNode;
+
+typedef struct GPUVoxelData {
+    uint32_t color_packed;
+} GPUVoxelData;
+
+/**
+ * A `GPUOctreeNode` as it's actually uploaded, packed into 8 bytes. The
+ * 12-byte layout above is still what chunks serialize and save.
+ */
+typedef struct GPUCompactNode {
+    uint32_t header;  // child mask in the low 8 bits, first child index above
+    uint32_t payload; // leaves: packed color. internal nodes: mask of
+                      // children that are filled leaves, in the top 8 bits,
+                      // and the average rgb of everything below in the rest
+} GPUCompactNode;
+
+typedef struct GPUChunkMetadata {
+    float position[3];
+    float size;
+    uint32_t grid_resolution; // of the distance grid, 0 if there isn't one
+    uint32_t node_base;       // where our nodes start in the shared pool
+    uint32_t grid_base;       // where our grid starts, in words
+    uint32_t padding;
+} GPUChunkMetadata;
+
+typedef struct GPUChunkGridInfo {
+    float origin[3]; // min corner of the grid
+    float cell_size; // which is also the chunk size
+    uint32_t dims[3];
+    uint32_t padding;
+} GPUChunkGridInfo;
+
+} // namespace vxng::scene
@@ -0,0 +1,87 @@
+#include "grid-pyramid.h"
+
+namespace vxng::scene {
+
+// floor(value / 2^shift), rounding towards negative infinity
+static auto floor_shift(int value, int shift) -> int {
+    return value >= 0 ? value >> shift : -((-value + (1 << shift) - 1) >> shift);
+}
+
+GridPyramid::GridPyramid(const uint8_t *data, glm::ivec3 size,
+                         glm::ivec3 offset, int levels)
+    : data(data), data_size(size), data_offset(offset),
+      window_min(glm::max(offset, glm::ivec3(0))),
+      window_max(glm::min(offset + size, glm::ivec3(1 << levels)) -
+                 glm::ivec3(1)),
+      levels(levels + 1) {
+    for (int level = 1; level <= levels; ++level) {
+        build_level(level);
+    }
+}
+
+GridPyramid::~GridPyramid() {}
+
+auto GridPyramid::get_level_count() const -> int {
+    return static_cast<int>(this->levels.size());
+}
+
+auto GridPyramid::sample(int level, glm::ivec3 cell) const -> uint16_t {
+    if (level == 0) {
+        if (glm::any(glm::lessThan(cell, this->window_min)) ||
+            glm::any(glm::greaterThan(cell, this->window_max)))
+            return 0;
+
+        glm::ivec3 local = cell - this->data_offset;
+        return this->data[local.x + (local.y * this->data_size.x) +
+                          (local.z * this->data_size.x * this->data_size.y)];
+    }
+
+    const Level &lvl = this->levels[level];
+    glm::ivec3 local = cell - lvl.min;
+    if (local.x < 0 || local.y < 0 || local.z < 0 || local.x >= lvl.size.x ||
+        local.y >= lvl.size.y || local.z >= lvl.size.z)
+        return 0;
+
+    return lvl.values[local.x + (local.y * lvl.size.x) +
+                      (local.z * lvl.size.x * lvl.size.y)];
+}
+
+auto GridPyramid::build_level(int level) -> void {
+    Level &lvl = this->levels[level];
+
+    // cells at this level that overlap the window at all, none if it's
+    // empty (i.e. the grid misses the chunk)
+    glm::ivec3 first = this->window_min;
+    glm::ivec3 last = this->window_max;
+    lvl.min = glm::ivec3(floor_shift(first.x, level),
+                         floor_shift(first.y, level),
+                         floor_shift(first.z, level));
+    glm::ivec3 max = glm::ivec3(floor_shift(last.x, level),
+                                floor_shift(last.y, level),
+                                floor_shift(last.z, level));
+    lvl.size = glm::any(glm::greaterThan(first, last))
+                   ? glm::ivec3(0)
+                   : max - lvl.min + glm::ivec3(1);
+    lvl.values.resize(lvl.size.x * lvl.size.y * lvl.size.z);
+
+    // merge each 2x2x2 block below into a single value where uniform
+    size_t out_index = 0;
+    for (int z = 0; z < lvl.size.z; ++z) {
+        for (int y = 0; y < lvl.size.y; ++y) {
+            for (int x = 0; x < lvl.size.x; ++x) {
+                glm::ivec3 child_base = (lvl.min + glm::ivec3(x, y, z)) * 2;
+
+                uint16_t value = sample(level - 1, child_base);
+                for (int i = 1; i < 8 && value != MIXED; ++i) {
+                    glm::ivec3 child_offset(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+                    if (sample(level - 1, child_base + child_offset) != value)
+                        value = MIXED;
+                }
+
+                lvl.values[out_index++] = value;
+            }
+        }
+    }
+}
+
+} // namespace vxng::scene
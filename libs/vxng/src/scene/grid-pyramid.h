@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace vxng::scene {
+
+/**
+ * Mip pyramid over a dense palette-index grid, used to build octrees in one
+ * pass. Level 0 is the source grid itself; each level above stores, per
+ * 2x2x2 block of the level below, either the single palette index shared by
+ * all eight cells or `MIXED`.
+ *
+ * Cells are addressed in chunk voxel coordinates scaled down by `2^level`.
+ * Only the part of the source grid inside the chunk, `[0, 2^levels)`, is
+ * looked at, so a grid spanning many chunks costs each of them just their
+ * share. Anything outside that reads as 0 (empty).
+ */
+class GridPyramid {
+  public:
+    static constexpr uint16_t MIXED = 0xFFFF;
+
+    /**
+     * @param data    Palette indices, laid out as
+     *                `x + (y * size.x) + (z * size.x * size.y)`. Must outlive
+     *                the pyramid.
+     * @param offset  Position of the grid's first voxel, in chunk voxel coords
+     * @param levels  Number of levels to build above the source grid
+     */
+    GridPyramid(const uint8_t *data, glm::ivec3 size, glm::ivec3 offset,
+                int levels);
+    ~GridPyramid();
+
+    auto sample(int level, glm::ivec3 cell) const -> uint16_t;
+    auto get_level_count() const -> int;
+
+  private:
+    typedef struct Level {
+        glm::ivec3 min; // first cell covered, inclusive
+        glm::ivec3 size;
+        std::vector<uint16_t> values;
+    } Level;
+
+    const uint8_t *data;
+    glm::ivec3 data_size;
+    glm::ivec3 data_offset;
+    // source voxels inside the chunk, inclusive. empty if min > max
+    glm::ivec3 window_min;
+    glm::ivec3 window_max;
+    std::vector<Level> levels; // levels[0] is unused, we read `data` directly
+
+    auto build_level(int level) -> void;
+};
+
+} // namespace vxng::scene
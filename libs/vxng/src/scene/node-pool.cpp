@@ -0,0 +1,69 @@
+#include "node-pool.h"
+
+namespace vxng::scene {
+
+auto VoxelData::operator==(const VoxelData &rhs) const -> bool {
+    return this->color == rhs.color;
+}
+auto VoxelData::operator!=(const VoxelData &rhs) const -> bool {
+    return !(*this == rhs);
+}
+
+auto OctreeNode::has_children() const -> bool {
+    for (NodeIndex child : this->children) {
+        if (child != NULL_NODE)
+            return true;
+    }
+    return false;
+}
+
+NodePool::NodePool() : slabs(), next_unused(0), free_list() {}
+
+NodePool::~NodePool() {}
+
+auto NodePool::allocate() -> NodeIndex {
+    NodeIndex index;
+    if (!this->free_list.empty()) {
+        index = this->free_list.back();
+        this->free_list.pop_back();
+    } else {
+        // grab a new slab if the bump pointer ran off the end of the last one
+        if (this->next_unused == this->slabs.size() * SLAB_SIZE) {
+            this->slabs.push_back(std::make_unique<OctreeNode[]>(SLAB_SIZE));
+        }
+        index = this->next_unused++;
+    }
+
+    OctreeNode &node = (*this)[index];
+    node.parent = NULL_NODE;
+    node.is_leaf = false;
+    node.leaf_data = {};
+    node.children.fill(NULL_NODE);
+    return index;
+}
+
+auto NodePool::release(NodeIndex index) -> void {
+    this->free_list.push_back(index);
+}
+
+auto NodePool::clear() -> void {
+    this->slabs.clear();
+    this->next_unused = 0;
+    this->free_list.clear();
+    this->free_list.shrink_to_fit();
+}
+
+auto NodePool::get_live_count() const -> size_t {
+    return this->next_unused - this->free_list.size();
+}
+
+auto NodePool::get_capacity() const -> size_t {
+    return this->slabs.size() * SLAB_SIZE;
+}
+
+auto NodePool::get_memory_usage() const -> size_t {
+    return get_capacity() * sizeof(OctreeNode) +
+           this->free_list.capacity() * sizeof(NodeIndex);
+}
+
+} // namespace vxng::scene
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vxng::scene {
+
+/** Index of a node within its owning `NodePool` */
+typedef uint32_t NodeIndex;
+constexpr NodeIndex NULL_NODE = UINT32_MAX;
+
+typedef struct VoxelData {
+    glm::u8vec4 color; // so much memory eek
+
+    auto operator==(const VoxelData &rhs) const -> bool;
+    auto operator!=(const VoxelData &rhs) const -> bool;
+} VoxelData;
+
+typedef struct OctreeNode {
+    NodeIndex parent;
+    bool is_leaf;
+    VoxelData leaf_data;
+    std::array<NodeIndex, 8> children;
+
+    auto has_children() const -> bool;
+} OctreeNode;
+
+/**
+ * Slab allocator for octree nodes. Nodes live in fixed-size contiguous slabs
+ * and are addressed by index, so a whole tree stays in a handful of large
+ * allocations instead of one heap allocation per node. Released nodes go onto
+ * a free list and get reused by subsequent allocations.
+ *
+ * Slabs are never moved once allocated, so references returned by
+ * `operator[]` stay valid across further allocations.
+ */
+class NodePool {
+  public:
+    NodePool();
+    ~NodePool();
+
+    /** Returns a fresh, empty (non-leaf, childless, parentless) node */
+    auto allocate() -> NodeIndex;
+    auto release(NodeIndex index) -> void;
+    /** Releases every node and frees all slabs */
+    auto clear() -> void;
+
+    auto operator[](NodeIndex index) -> OctreeNode & {
+        return slabs[index >> SLAB_SHIFT][index & SLAB_MASK];
+    }
+    auto operator[](NodeIndex index) const -> const OctreeNode & {
+        return slabs[index >> SLAB_SHIFT][index & SLAB_MASK];
+    }
+
+    /** Number of nodes currently in use */
+    auto get_live_count() const -> size_t;
+    /** Number of node slots allocated, in use or not */
+    auto get_capacity() const -> size_t;
+    /** Heap bytes held, including the free list */
+    auto get_memory_usage() const -> size_t;
+
+    static constexpr uint32_t SLAB_SHIFT = 12;
+    static constexpr uint32_t SLAB_SIZE = 1u << SLAB_SHIFT;
+    static constexpr uint32_t SLAB_MASK = SLAB_SIZE - 1;
+
+  private:
+    std::vector<std::unique_ptr<OctreeNode[]>> slabs;
+    NodeIndex next_unused; // bump pointer into the last slab
+    std::vector<NodeIndex> free_list;
+};
+
+} // namespace vxng::scene
@@ -0,0 +1,385 @@
+#include "octree-cast.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// one scale per f32 mantissa bit, see the shader
+#define CAST_STACK_SIZE 23
+#define MAX_CAST_STEPS 4096
+// keep in sync with the shader's beam prepass
+#define BEAM_STACK_SIZE 16
+#define MAX_BEAM_STEPS 512
+
+namespace vxng::scene {
+
+static auto float_bits(float f) -> uint32_t {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static auto bits_float(uint32_t bits) -> float {
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static auto popcount(uint32_t mask) -> uint32_t {
+    uint32_t count = 0;
+    for (; mask != 0; mask &= mask - 1)
+        count++;
+    return count;
+}
+
+static auto get_child_mask(const GPUCompactNode &node) -> uint32_t {
+    return node.header & 0xFF;
+}
+
+static auto highest_bit(uint32_t bits) -> uint32_t {
+    uint32_t index = 0;
+    while (bits >>= 1)
+        index++;
+    return index;
+}
+
+// a hit on a leaf, given the t at which the ray crosses each of its entry and
+// exit planes
+static auto make_hit(const geometry::Ray &ray, glm::vec3 entry, glm::vec3 exit,
+                     uint32_t color_packed, uint32_t steps)
+    -> FlatRaycastResult {
+    FlatRaycastResult result{true, 0.f, false, glm::vec3(0.f), color_packed,
+                             steps};
+
+    // we came in through whichever plane we crossed last
+    float t_entry = std::max(std::max(entry.x, entry.y), entry.z);
+    if (t_entry >= 0.f) {
+        result.t = t_entry;
+        int axis = entry.x == t_entry ? 0 : entry.y == t_entry ? 1 : 2;
+        result.normal[axis] = -glm::sign(ray.direction[axis]);
+        return result;
+    }
+
+    // started inside, so report where we get out
+    float t_exit = std::min(std::min(exit.x, exit.y), exit.z);
+    result.t = t_exit;
+    result.inside = true;
+    int axis = exit.x == t_exit ? 0 : exit.y == t_exit ? 1 : 2;
+    result.normal[axis] = glm::sign(ray.direction[axis]);
+    return result;
+}
+
+auto raycast_flat(const GPUCompactNode *nodes, const geometry::AABB &bounds,
+                  const geometry::Ray &ray, const DistanceGrid *grid,
+                  float lod_scale) -> FlatRaycastResult {
+    FlatRaycastResult miss{false, -1.f, false, glm::vec3(0.f), 0, 0};
+
+    // chunk space, spanning [1, 2], with the same t as world space
+    float size = bounds.max.x - bounds.min.x;
+    glm::vec3 p = (ray.origin - bounds.min) / size + glm::vec3(1.f);
+    glm::vec3 d = ray.direction / size;
+
+    // keep axis-aligned rays from dividing by zero
+    float epsilon = std::exp2(-static_cast<float>(CAST_STACK_SIZE));
+    for (int i = 0; i < 3; ++i) {
+        if (std::fabs(d[i]) < epsilon)
+            d[i] = d[i] < 0.f ? -epsilon : epsilon;
+    }
+
+    // t along each axis is `pos * coef - bias`, mirrored to a negative
+    // direction
+    glm::vec3 coef = 1.f / -glm::abs(d);
+    glm::vec3 bias = coef * p;
+    uint32_t octant_mask = 0;
+    for (int i = 0; i < 3; ++i) {
+        if (d[i] > 0.f) {
+            octant_mask ^= 1u << i;
+            bias[i] = 3.f * coef[i] - bias[i];
+        }
+    }
+
+    glm::vec3 root_entry = 2.f * coef - bias;
+    glm::vec3 root_exit = coef - bias;
+    float t_min = std::max(
+        std::max(std::max(root_entry.x, root_entry.y), root_entry.z), 0.f);
+    float t_max = std::min(std::min(root_exit.x, root_exit.y), root_exit.z);
+    if (t_min >= t_max)
+        return miss;
+
+    // the whole chunk may be a single leaf
+    GPUCompactNode parent_node = nodes[0];
+    if (get_child_mask(parent_node) == 0) {
+        if ((parent_node.payload >> 24) == 0)
+            return miss;
+        return make_hit(ray, root_entry, root_exit, parent_node.payload, 0);
+    }
+
+    // start wherever the ray first gets near anything
+    uint32_t skip_steps = 0;
+    if (grid) {
+        t_min = grid->skip_empty_space(bounds, ray, t_min, t_max, skip_steps);
+        if (t_min >= t_max) {
+            miss.steps = skip_steps;
+            return miss;
+        }
+    }
+
+    // parents to come back to, indexed by scale
+    uint32_t stack_node[CAST_STACK_SIZE];
+    float stack_t_max[CAST_STACK_SIZE];
+
+    uint32_t parent = 0;
+    uint32_t idx = 0;           // child we're in, in mirrored space
+    glm::vec3 pos(1.f);         // its (mirrored) min corner
+    uint32_t scale = CAST_STACK_SIZE - 1;
+    float scale_exp2 = 0.5f;    // its size
+    float h = t_max;            // skip pushing parents we'd never come back to
+    float lod_size = lod_scale / size; // in chunk space
+
+    glm::vec3 root_center = 1.5f * coef - bias;
+    for (int i = 0; i < 3; ++i) {
+        if (root_center[i] > t_min) {
+            idx ^= 1u << i;
+            pos[i] = 1.5f;
+        }
+    }
+
+    // skipping has its own budget, steps just count both
+    uint32_t max_steps = skip_steps + MAX_CAST_STEPS;
+    for (uint32_t steps = skip_steps + 1; steps <= max_steps; ++steps) {
+        // where we'd leave the current child
+        glm::vec3 corner = pos * coef - bias;
+        float tc_max = std::min(std::min(corner.x, corner.y), corner.z);
+        uint32_t octant = idx ^ octant_mask;
+
+        uint32_t parent_mask = get_child_mask(parent_node);
+        if ((parent_mask & (1u << octant)) != 0 && t_min <= t_max) {
+            float tv_max = std::min(t_max, tc_max);
+            if (t_min <= tv_max) {
+                uint32_t child_idx =
+                    (parent_node.header >> 8) +
+                    popcount(parent_mask & ((1u << octant) - 1));
+                const GPUCompactNode &child = nodes[child_idx];
+                glm::vec3 entry = (pos + scale_exp2) * coef - bias;
+
+                // the parent already knows if this is an opaque leaf
+                if ((parent_node.payload >> 24) & (1u << octant))
+                    return make_hit(ray, entry, corner, child.payload, steps);
+
+                // any other leaf is empty
+                if (get_child_mask(child) != 0) {
+                    // too small to make out from here, so it's hit whole
+                    if (scale_exp2 < lod_size * t_min) {
+                        uint32_t lod_color =
+                            (child.payload & 0xFFFFFF) | 0xFF000000;
+                        return make_hit(ray, entry, corner, lod_color, steps);
+                    }
+
+                    // descend, remembering the parent if we'll need it again
+                    if (tc_max < h) {
+                        stack_node[scale] = parent;
+                        stack_t_max[scale] = t_max;
+                    }
+                    h = tc_max;
+
+                    float half_scale = scale_exp2 * 0.5f;
+                    glm::vec3 center = half_scale * coef + corner;
+                    parent = child_idx;
+                    parent_node = child;
+                    idx = 0;
+                    scale--;
+                    scale_exp2 = half_scale;
+                    for (int i = 0; i < 3; ++i) {
+                        if (center[i] > t_min) {
+                            idx ^= 1u << i;
+                            pos[i] += scale_exp2;
+                        }
+                    }
+                    t_max = tv_max;
+                    continue;
+                }
+            }
+        }
+
+        // advance into the next sibling along the ray
+        uint32_t step_mask = 0;
+        for (int i = 0; i < 3; ++i) {
+            if (corner[i] <= tc_max) {
+                step_mask ^= 1u << i;
+                pos[i] -= scale_exp2;
+            }
+        }
+        t_min = tc_max;
+        idx ^= step_mask;
+
+        // stepped out of the parent: pop up to the highest level whose
+        // position bits changed
+        if ((idx & step_mask) != 0) {
+            uint32_t differing_bits = 0;
+            for (int i = 0; i < 3; ++i) {
+                if (step_mask & (1u << i))
+                    differing_bits |=
+                        float_bits(pos[i]) ^ float_bits(pos[i] + scale_exp2);
+            }
+
+            // no bit at all or past the root means we left the chunk
+            scale = differing_bits != 0 ? highest_bit(differing_bits)
+                                        : CAST_STACK_SIZE;
+            if (scale >= CAST_STACK_SIZE) {
+                miss.steps = steps;
+                return miss;
+            }
+            scale_exp2 = bits_float((scale + 127 - CAST_STACK_SIZE) << 23);
+
+            parent = stack_node[scale];
+            parent_node = nodes[parent];
+            t_max = stack_t_max[scale];
+
+            idx = 0;
+            for (int i = 0; i < 3; ++i) {
+                uint32_t shifted = float_bits(pos[i]) >> scale;
+                pos[i] = bits_float(shifted << scale);
+                idx |= (shifted & 1u) << i;
+            }
+            h = 0.f;
+        }
+    }
+
+    miss.steps = max_steps;
+    return miss;
+}
+
+// whether the ray meets the box anywhere ahead of its origin, like the
+// shader's `raycastAABB` not returning -1
+static auto reaches(const geometry::Ray &ray, const geometry::AABB &aabb)
+    -> bool {
+    auto result = geometry::ray_aabb_intersect(ray, aabb);
+    return result.hit && result.t >= 0.f;
+}
+
+static auto distance_to(glm::vec3 point, const geometry::AABB &aabb)
+    -> float {
+    glm::vec3 outside =
+        glm::max(glm::max(aabb.min - point, point - aabb.max), glm::vec3(0.f));
+    return glm::length(outside);
+}
+
+// a ray within `spread` of the beam's center ray strays at most `spread * t`
+// from it, and nothing in the box is further than this t
+static auto beam_margin(const geometry::AABB &aabb, glm::vec3 origin,
+                        float spread) -> float {
+    glm::vec3 center = (aabb.min + aabb.max) * 0.5f;
+    float half_diagonal = glm::length(aabb.max - center);
+    return spread * (glm::length(center - origin) + half_diagonal);
+}
+
+static auto grow(const geometry::AABB &aabb, float margin) -> geometry::AABB {
+    return geometry::AABB{aabb.min - glm::vec3(margin),
+                          aabb.max + glm::vec3(margin)};
+}
+
+static auto child_bounds(const geometry::AABB &parent, uint32_t octant)
+    -> geometry::AABB {
+    glm::vec3 mid = (parent.min + parent.max) * 0.5f;
+    geometry::AABB child;
+    for (int i = 0; i < 3; ++i) {
+        bool high = (octant >> i) & 1u;
+        child.min[i] = high ? mid[i] : parent.min[i];
+        child.max[i] = high ? parent.max[i] : mid[i];
+    }
+    return child;
+}
+
+auto trace_beam_flat(const GPUCompactNode *nodes,
+                     const geometry::AABB &bounds, const geometry::Ray &ray,
+                     float spread, float lod_scale) -> float {
+    if (!reaches(ray, grow(bounds, beam_margin(bounds, ray.origin, spread))))
+        return -1.f;
+    float root_distance = distance_to(ray.origin, bounds);
+
+    typedef struct BeamEntry {
+        uint32_t node;
+        geometry::AABB bounds;
+        uint32_t next_octant;
+    } BeamEntry;
+    BeamEntry stack[BEAM_STACK_SIZE];
+    int stack_ptr = 0;
+    stack[0] = {0, bounds, 0};
+
+    // front to back finds something close early, which prunes the rest
+    uint32_t first_octant = 0;
+    for (int i = 0; i < 3; ++i) {
+        if (!(ray.direction[i] > 0.f))
+            first_octant |= 1u << i;
+    }
+
+    float closest = 1e30f;
+    for (uint32_t steps = 0; stack_ptr >= 0; ++steps) {
+        if (steps >= MAX_BEAM_STEPS)
+            return std::min(closest, root_distance);
+
+        BeamEntry &entry = stack[stack_ptr];
+        GPUCompactNode node = nodes[entry.node];
+
+        // children never get pushed as leaves, so this is a single leaf root
+        uint32_t mask = get_child_mask(node);
+        if (mask == 0) {
+            if ((node.payload >> 24) != 0)
+                closest = std::min(closest, root_distance);
+            stack_ptr--;
+            continue;
+        }
+
+        uint32_t leaf_mask = node.payload >> 24;
+        bool pushed = false;
+        for (uint32_t i = entry.next_octant; i < 8; ++i) {
+            uint32_t octant = first_octant ^ i;
+            if (!(mask & (1u << octant)))
+                continue;
+
+            // nothing in here can beat what we've got
+            geometry::AABB child = child_bounds(entry.bounds, octant);
+            float node_distance = distance_to(ray.origin, child);
+            if (node_distance >= closest)
+                continue;
+
+            // or no ray in the beam gets anywhere near it
+            float margin = beam_margin(child, ray.origin, spread);
+            if (!reaches(ray, grow(child, margin)))
+                continue;
+
+            if (leaf_mask & (1u << octant)) {
+                closest = node_distance;
+                continue;
+            }
+
+            uint32_t child_idx =
+                (node.header >> 8) + popcount(mask & ((1u << octant) - 1));
+            if (get_child_mask(nodes[child_idx]) == 0)
+                continue; // empty leaf
+
+            // the beam's wider than the node, no point resolving it. the same
+            // goes for nodes small enough that some ray could draw them at
+            // LOD, which happens at their entry at the nearest
+            float size = child.max.x - child.min.x;
+            float reach =
+                beam_margin(child, ray.origin, std::max(spread, lod_scale));
+            if (reach >= size || stack_ptr + 1 >= BEAM_STACK_SIZE) {
+                closest = node_distance;
+                continue;
+            }
+
+            entry.next_octant = i + 1;
+            stack[++stack_ptr] = {child_idx, child, 0};
+            pushed = true;
+            break;
+        }
+
+        if (!pushed)
+            stack_ptr--;
+    }
+
+    return closest < 1e30f ? closest : -1.f;
+}
+
+} // namespace vxng::scene
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "distance-grid.h"
+#include "gpu-types.h"
+#include "vxng/geometry.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace vxng::scene {
+
+typedef struct FlatRaycastResult {
+    bool hit;
+    float t;     // where we leave the leaf instead, if we started inside it
+    bool inside; // like `ray_aabb_intersect`, the normal is on the exit face
+    glm::vec3 normal;
+    uint32_t color_packed;
+    uint32_t steps; // traversal loop iterations, a measure of cost
+} FlatRaycastResult;
+
+/**
+ * Casts a ray through packed octree nodes (root at slot 0), exactly the way
+ * the chunk shader's `traverseOctreeParametric` does: opaque leaves come
+ * straight from their parent's leaf mask, and nodes too small to make out are
+ * hit as a single voxel of their average color. Works on DAGs too, since it
+ * only ever follows first child indices.
+ *
+ * @param bounds     The chunk's world space cube
+ * @param grid       Optional, jumps over empty space before traversing, like
+ *                   the shader does when the chunk has one
+ * @param lod_scale  Nodes smaller than this times their distance are hit
+ *                   whole, like the shader's `lodScale()`. 0 for no LOD
+ */
+auto raycast_flat(const GPUCompactNode *nodes, const geometry::AABB &bounds,
+                  const geometry::Ray &ray, const DistanceGrid *grid = nullptr,
+                  float lod_scale = 0.f) -> FlatRaycastResult;
+
+/**
+ * The nearest t any ray in a beam could hit something in the chunk at, or -1
+ * if none can, exactly the way the chunk shader's `traceBeam` does. Every
+ * per-pixel `raycast_flat` inside the beam hits at this t or further.
+ *
+ * @param ray        The beam's center ray, with a unit direction
+ * @param spread     How far (as a chord between unit directions) the beam's
+ *                   rays stray from `ray`
+ * @param lod_scale  Same as for `raycast_flat`
+ */
+auto trace_beam_flat(const GPUCompactNode *nodes,
+                     const geometry::AABB &bounds, const geometry::Ray &ray,
+                     float spread, float lod_scale = 0.f) -> float;
+
+} // namespace vxng::scene
@@ -0,0 +1,133 @@
+#include "octree-dag.h"
+
+#include "octree-view.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+
+namespace vxng::scene {
+
+// a node's children as they'd sit in the node array, in octant order
+typedef struct DagBlock {
+    uint32_t count;
+    std::array<GPUOctreeNode, 8> entries;
+
+    auto operator==(const DagBlock &rhs) const -> bool {
+        if (this->count != rhs.count)
+            return false;
+        for (uint32_t i = 0; i < this->count; ++i) {
+            const GPUOctreeNode &a = this->entries[i];
+            const GPUOctreeNode &b = rhs.entries[i];
+            if (a.child_mask != b.child_mask ||
+                a.first_child_idx != b.first_child_idx ||
+                a.voxel_data_idx != b.voxel_data_idx)
+                return false;
+        }
+        return true;
+    }
+} DagBlock;
+
+typedef struct DagBlockHash {
+    auto operator()(const DagBlock &block) const -> size_t {
+        // fnv-1a over the words that matter
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](uint32_t word) {
+            hash ^= word;
+            hash *= 1099511628211ull;
+        };
+        mix(block.count);
+        for (uint32_t i = 0; i < block.count; ++i) {
+            mix(block.entries[i].child_mask);
+            mix(block.entries[i].first_child_idx);
+            mix(block.entries[i].voxel_data_idx);
+        }
+        return static_cast<size_t>(hash);
+    }
+} DagBlockHash;
+
+template <typename View> class DagBuilder {
+  public:
+    DagBuilder(const View &view) : view(view), dag(), color_slots(), blocks() {
+        // slot 0 is kept for the root, voxel data 0 for "no color"
+        this->dag.octree_nodes.resize(1);
+        this->dag.voxel_datas.push_back(GPUVoxelData{0});
+        this->color_slots[0] = 0;
+    }
+
+    auto build() -> DagArrays {
+        this->dag.octree_nodes[0] = build_node(this->view.get_root());
+
+        // both arrays share one slot count everywhere else (uploads, files),
+        // so pad the shorter one, usually the colors
+        size_t slot_count = std::max(this->dag.octree_nodes.size(),
+                                     this->dag.voxel_datas.size());
+        this->dag.octree_nodes.resize(slot_count);
+        this->dag.voxel_datas.resize(slot_count);
+        return std::move(this->dag);
+    }
+
+  private:
+    const View &view;
+    DagArrays dag;
+    std::unordered_map<uint32_t, uint32_t> color_slots;
+    std::unordered_map<DagBlock, uint32_t, DagBlockHash> blocks;
+
+    // returns this node's entry, with its children already interned
+    auto build_node(typename View::Node node) -> GPUOctreeNode {
+        GPUOctreeNode entry{};
+
+        if (this->view.is_leaf(node)) {
+            entry.voxel_data_idx = intern_color(this->view.get_color(node));
+            return entry;
+        }
+
+        DagBlock block{};
+        for (int i = 0; i < 8; ++i) {
+            typename View::Node child = this->view.get_child(node, i);
+            if (child == View::NONE)
+                continue;
+
+            entry.child_mask |= 1u << i;
+            block.entries[block.count++] = build_node(child);
+        }
+
+        if (block.count > 0)
+            entry.first_child_idx = intern_block(block);
+        return entry;
+    }
+
+    auto intern_color(glm::u8vec4 c) -> uint32_t {
+        uint32_t packed = (static_cast<uint32_t>(c.r) << 0) |
+                          (static_cast<uint32_t>(c.g) << 8) |
+                          (static_cast<uint32_t>(c.b) << 16) |
+                          (static_cast<uint32_t>(c.a) << 24);
+
+        auto [it, inserted] = this->color_slots.emplace(
+            packed, static_cast<uint32_t>(this->dag.voxel_datas.size()));
+        if (inserted)
+            this->dag.voxel_datas.push_back(GPUVoxelData{packed});
+        return it->second;
+    }
+
+    auto intern_block(const DagBlock &block) -> uint32_t {
+        auto [it, inserted] = this->blocks.emplace(
+            block, static_cast<uint32_t>(this->dag.octree_nodes.size()));
+        if (inserted) {
+            this->dag.octree_nodes.insert(this->dag.octree_nodes.end(),
+                                          block.entries.begin(),
+                                          block.entries.begin() + block.count);
+        }
+        return it->second;
+    }
+};
+
+template <typename View> auto build_dag(const View &view) -> DagArrays {
+    return DagBuilder<View>(view).build();
+}
+
+template auto build_dag<TreeView>(const TreeView &view) -> DagArrays;
+template auto build_dag<FlatView>(const FlatView &view) -> DagArrays;
+
+} // namespace vxng::scene
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "gpu-types.h"
+
+#include <vector>
+
+namespace vxng::scene {
+
+typedef struct DagArrays {
+    std::vector<GPUOctreeNode> octree_nodes;
+    std::vector<GPUVoxelData> voxel_datas;
+} DagArrays;
+
+/**
+ * Builds a sparse voxel DAG from an octree view (see octree-view.h), in the
+ * same GPU layout the shader already walks: children are still a contiguous
+ * block at `first_child_idx`, but identical blocks are stored once and shared
+ * by every parent pointing at them. Since blocks are interned bottom-up,
+ * identical subtrees end up with identical entries, so sharing cascades all
+ * the way up. Colors are shared the same way through `voxel_data_idx`.
+ *
+ * Root is at slot 0, and voxel data 0 is the empty color. Both arrays come
+ * out the same length, so they can be treated like any serialized octree.
+ */
+template <typename View> auto build_dag(const View &view) -> DagArrays;
+
+} // namespace vxng::scene
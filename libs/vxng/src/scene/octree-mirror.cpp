@@ -0,0 +1,266 @@
+#include "octree-mirror.h"
+
+#include <algorithm>
+#include <queue>
+
+// merge dirty slots into one upload range if they're at most this far apart
+#define DIRTY_RANGE_MERGE_GAP 16
+// don't bother compacting tiny arrays
+#define MIN_COMPACTION_FREE_SLOTS 1024
+
+namespace vxng::scene {
+
+OctreeMirror::OctreeMirror()
+    : node_slots(), child_blocks(), node_dirty(), dirty_nodes(),
+      free_blocks(), free_slot_count(0), octree_nodes(), voxel_datas(),
+      dirty_slots() {}
+
+OctreeMirror::~OctreeMirror() {}
+
+auto OctreeMirror::rebuild(const NodePool &nodes, NodeIndex root) -> void {
+    // forget all previous layout info
+    this->node_slots.assign(nodes.get_capacity(), NO_SLOT);
+    this->child_blocks.assign(nodes.get_capacity(), ChildBlock{0, 0});
+    this->node_dirty.assign(nodes.get_capacity(), false);
+    this->dirty_nodes.clear();
+    for (auto &bucket : this->free_blocks)
+        bucket.clear();
+    this->free_slot_count = 0;
+    this->octree_nodes.clear();
+    this->voxel_datas.clear();
+    this->dirty_slots.clear();
+
+    // root always lives at slot 0
+    this->octree_nodes.resize(1);
+    this->voxel_datas.resize(1);
+    this->node_slots[root] = 0;
+
+    // bfs, giving each node's children a tightly packed block
+    std::queue<NodeIndex> bfs;
+    bfs.push(root);
+
+    while (!bfs.empty()) {
+        NodeIndex node_index = bfs.front();
+        bfs.pop();
+        const OctreeNode &node = nodes[node_index];
+
+        if (!node.is_leaf) {
+            uint32_t child_count = 0;
+            for (NodeIndex child : node.children) {
+                if (child != NULL_NODE)
+                    child_count++;
+            }
+
+            if (child_count > 0) {
+                uint32_t base = allocate_block(child_count);
+                this->child_blocks[node_index] = {base, child_count};
+
+                uint32_t rank = 0;
+                for (NodeIndex child : node.children) {
+                    if (child == NULL_NODE)
+                        continue;
+                    this->node_slots[child] = base + rank++;
+                    bfs.push(child);
+                }
+            }
+        }
+
+        write_slot(nodes, node_index);
+    }
+}
+
+auto OctreeMirror::mark_dirty(NodeIndex node) -> void {
+    ensure_node_capacity(node);
+    if (this->node_dirty[node])
+        return;
+
+    this->node_dirty[node] = true;
+    this->dirty_nodes.push_back(node);
+}
+
+auto OctreeMirror::forget(NodeIndex node) -> void {
+    if (node >= this->node_slots.size())
+        return;
+
+    free_block(node);
+    this->node_slots[node] = NO_SLOT;
+    this->node_dirty[node] = false; // stale entries get skipped on flush
+}
+
+auto OctreeMirror::flush(const NodePool &nodes, NodeIndex root) -> void {
+    // lay everything out fresh if we've never done so, or if holes have taken
+    // over the array
+    if (this->octree_nodes.empty() ||
+        (this->free_slot_count > MIN_COMPACTION_FREE_SLOTS &&
+         this->free_slot_count * 2 > this->octree_nodes.size())) {
+        rebuild(nodes, root);
+        return;
+    }
+
+    for (NodeIndex node : this->dirty_nodes) {
+        if (!this->node_dirty[node])
+            continue;
+
+        this->node_dirty[node] = false;
+        relayout(nodes, node);
+    }
+    this->dirty_nodes.clear();
+}
+
+auto OctreeMirror::take_dirty_ranges() -> std::vector<SlotRange> {
+    std::vector<SlotRange> ranges;
+    if (this->dirty_slots.empty())
+        return ranges;
+
+    std::sort(this->dirty_slots.begin(), this->dirty_slots.end());
+
+    SlotRange current = {this->dirty_slots[0], this->dirty_slots[0] + 1};
+    for (uint32_t slot : this->dirty_slots) {
+        if (slot <= current.end + DIRTY_RANGE_MERGE_GAP) {
+            current.end = std::max(current.end, slot + 1);
+        } else {
+            ranges.push_back(current);
+            current = {slot, slot + 1};
+        }
+    }
+    ranges.push_back(current);
+
+    this->dirty_slots.clear();
+    return ranges;
+}
+
+auto OctreeMirror::get_memory_usage() const -> size_t {
+    size_t bytes = this->node_slots.capacity() * sizeof(uint32_t) +
+                   this->child_blocks.capacity() * sizeof(ChildBlock) +
+                   this->node_dirty.capacity() / 8 +
+                   this->dirty_nodes.capacity() * sizeof(NodeIndex) +
+                   this->octree_nodes.capacity() * sizeof(GPUOctreeNode) +
+                   this->voxel_datas.capacity() * sizeof(GPUVoxelData) +
+                   this->dirty_slots.capacity() * sizeof(uint32_t);
+    for (const auto &bucket : this->free_blocks)
+        bytes += bucket.capacity() * sizeof(uint32_t);
+    return bytes;
+}
+
+auto OctreeMirror::ensure_node_capacity(NodeIndex node) -> void {
+    if (node < this->node_slots.size())
+        return;
+
+    // grow a whole pool slab at a time
+    size_t new_size = (node / NodePool::SLAB_SIZE + 1) * NodePool::SLAB_SIZE;
+    this->node_slots.resize(new_size, NO_SLOT);
+    this->child_blocks.resize(new_size, ChildBlock{0, 0});
+    this->node_dirty.resize(new_size, false);
+}
+
+auto OctreeMirror::allocate_block(uint32_t capacity) -> uint32_t {
+    auto &bucket = this->free_blocks[capacity];
+    if (!bucket.empty()) {
+        uint32_t base = bucket.back();
+        bucket.pop_back();
+        this->free_slot_count -= capacity;
+        return base;
+    }
+
+    // nothing to reuse, append to the end
+    uint32_t base = static_cast<uint32_t>(this->octree_nodes.size());
+    this->octree_nodes.resize(base + capacity);
+    this->voxel_datas.resize(base + capacity);
+    return base;
+}
+
+auto OctreeMirror::free_block(NodeIndex node) -> void {
+    ChildBlock &block = this->child_blocks[node];
+    if (block.capacity == 0)
+        return;
+
+    this->free_blocks[block.capacity].push_back(block.base);
+    this->free_slot_count += block.capacity;
+    block = {0, 0};
+}
+
+auto OctreeMirror::relayout(const NodePool &nodes, NodeIndex node_index)
+    -> void {
+    const OctreeNode &node = nodes[node_index];
+
+    uint32_t child_count = 0;
+    if (!node.is_leaf) {
+        for (NodeIndex child : node.children) {
+            if (child != NULL_NODE)
+                child_count++;
+        }
+    }
+
+    if (child_count == 0) {
+        free_block(node_index);
+    } else {
+        // keep our block if children still fit, otherwise move
+        if (this->child_blocks[node_index].capacity < child_count) {
+            free_block(node_index);
+            this->child_blocks[node_index] = {allocate_block(child_count),
+                                              child_count};
+        }
+
+        // children may have shifted rank within the block, rewrite them all
+        uint32_t base = this->child_blocks[node_index].base;
+        uint32_t rank = 0;
+        for (NodeIndex child : node.children) {
+            if (child == NULL_NODE)
+                continue;
+            ensure_node_capacity(child);
+            this->node_slots[child] = base + rank++;
+            write_slot(nodes, child);
+        }
+    }
+
+    // nodes without a slot yet get written when their parent is laid out
+    write_slot(nodes, node_index);
+
+    // the parent is uploaded with a mask of which children are filled leaves,
+    // and every ancestor with the average color of everything below it, both
+    // of which may have just changed, so their slots have to go up again too
+    for (NodeIndex ancestor = node.parent;
+         ancestor != NULL_NODE && ancestor < this->node_slots.size() &&
+         this->node_slots[ancestor] != NO_SLOT;
+         ancestor = nodes[ancestor].parent)
+        this->dirty_slots.push_back(this->node_slots[ancestor]);
+}
+
+auto OctreeMirror::write_slot(const NodePool &nodes, NodeIndex node_index)
+    -> void {
+    uint32_t slot = this->node_slots[node_index];
+    if (slot == NO_SLOT)
+        return;
+
+    const OctreeNode &node = nodes[node_index];
+
+    GPUOctreeNode gpu_node{};
+    gpu_node.child_mask = 0;
+    gpu_node.first_child_idx = 0;
+    gpu_node.voxel_data_idx = slot;
+
+    GPUVoxelData vdata{};
+    vdata.color_packed = 0; // zero opacity for anything that isn't a leaf
+
+    if (node.is_leaf) {
+        // leaf -> child_mask stays 0
+        auto c = node.leaf_data.color;
+        vdata.color_packed = (static_cast<uint32_t>(c.r) << 0) |
+                             (static_cast<uint32_t>(c.g) << 8) |
+                             (static_cast<uint32_t>(c.b) << 16) |
+                             (static_cast<uint32_t>(c.a) << 24);
+    } else {
+        for (int i = 0; i < 8; i++) {
+            if (node.children[i] != NULL_NODE) {
+                gpu_node.child_mask |= (1u << i);
+            }
+        }
+        gpu_node.first_child_idx = this->child_blocks[node_index].base;
+    }
+
+    this->octree_nodes[slot] = gpu_node;
+    this->voxel_datas[slot] = vdata;
+    this->dirty_slots.push_back(slot);
+}
+
+} // namespace vxng::scene
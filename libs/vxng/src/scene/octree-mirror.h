@@ -0,0 +1,111 @@
+#pragma once
+
+#include "gpu-types.h"
+#include "node-pool.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace vxng::scene {
+
+/**
+ * CPU-side copy of a chunk's GPU octree buffers, laid out so that edits only
+ * rewrite the slots they touch.
+ *
+ * Every octree node owns one slot in the GPU node array. The children of an
+ * internal node live in a contiguous "child block" (so the shader can still
+ * find them with `first_child_idx + bitCount(mask below)`), and blocks are
+ * allocated with per-size free lists. Changing a node's children only moves
+ * that node's own block; subtrees below keep their blocks, so nothing beneath
+ * an edit has to be re-serialized.
+ *
+ * Voxel data is stored parallel to the node array (`voxel_data_idx` is the
+ * node's own slot).
+ */
+class OctreeMirror {
+  public:
+    OctreeMirror();
+    ~OctreeMirror();
+
+    typedef struct SlotRange {
+        uint32_t begin;
+        uint32_t end; // exclusive
+    } SlotRange;
+
+    /**
+     * Throws away the current layout and lays out the whole tree again
+     * compactly (breadth-first). Every slot ends up dirty.
+     */
+    auto rebuild(const NodePool &nodes, NodeIndex root) -> void;
+
+    /** Marks a node whose leaf state, color, or set of children changed */
+    auto mark_dirty(NodeIndex node) -> void;
+
+    /**
+     * Must be called whenever a node goes back to the pool, so its child block
+     * can be reused (the index may be handed out again before the next flush).
+     */
+    auto forget(NodeIndex node) -> void;
+
+    /**
+     * Re-serializes dirty nodes into their slots. Falls back to `rebuild` if
+     * freed blocks make up most of the array.
+     */
+    auto flush(const NodePool &nodes, NodeIndex root) -> void;
+
+    /**
+     * Slot ranges written since the last call, sorted and merged. A node
+     * being rewritten dirties every ancestor's slot too, as their uploads
+     * depend on whether their children are leaves and what's below them.
+     */
+    auto take_dirty_ranges() -> std::vector<SlotRange>;
+
+    auto get_octree_nodes() const -> const std::vector<GPUOctreeNode> & {
+        return this->octree_nodes;
+    }
+    auto get_voxel_datas() const -> const std::vector<GPUVoxelData> & {
+        return this->voxel_datas;
+    }
+
+    /** Heap bytes held, layout bookkeeping included */
+    auto get_memory_usage() const -> size_t;
+
+    /** Number of slots in use, including freed ones awaiting reuse */
+    auto get_slot_count() const -> uint32_t {
+        return static_cast<uint32_t>(this->octree_nodes.size());
+    }
+
+  private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    typedef struct ChildBlock {
+        uint32_t base;
+        uint32_t capacity; // 0 if no block
+    } ChildBlock;
+
+    // per-node layout info, indexed by NodeIndex
+    std::vector<uint32_t> node_slots;
+    std::vector<ChildBlock> child_blocks;
+    std::vector<bool> node_dirty;
+    std::vector<NodeIndex> dirty_nodes;
+
+    // free child blocks, bucketed by capacity (1-8)
+    std::array<std::vector<uint32_t>, 9> free_blocks;
+    uint32_t free_slot_count;
+
+    std::vector<GPUOctreeNode> octree_nodes;
+    std::vector<GPUVoxelData> voxel_datas;
+    std::vector<uint32_t> dirty_slots;
+
+    auto ensure_node_capacity(NodeIndex node) -> void;
+    auto allocate_block(uint32_t capacity) -> uint32_t;
+    auto free_block(NodeIndex node) -> void;
+
+    /** Makes sure the node's child block fits its children, then writes the
+     * children and the node itself into their slots */
+    auto relayout(const NodePool &nodes, NodeIndex node) -> void;
+    auto write_slot(const NodePool &nodes, NodeIndex node) -> void;
+};
+
+} // namespace vxng::scene
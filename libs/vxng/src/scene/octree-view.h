@@ -0,0 +1,78 @@
+#pragma once
+
+#include "gpu-types.h"
+#include "node-pool.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace vxng::scene {
+
+/**
+ * Read-only views over a chunk octree, so queries can be written once (as
+ * templates) and run on either the editable node tree or on serialized GPU
+ * arrays. Both expose the same interface:
+ *
+ * - `Node`, a cheap handle, with `NONE` meaning no node
+ * - `get_root()`, `is_leaf(n)`, `get_color(n)`, `get_child(n, octant)`
+ *
+ * Leaves are always non-empty; empty space is an internal node (or missing
+ * child) with nothing below it.
+ */
+typedef struct TreeView {
+    typedef NodeIndex Node;
+    static constexpr Node NONE = NULL_NODE;
+
+    const NodePool &nodes;
+    NodeIndex root;
+
+    auto get_root() const -> Node { return this->root; }
+    auto is_leaf(Node node) const -> bool { return this->nodes[node].is_leaf; }
+    auto get_color(Node node) const -> glm::u8vec4 {
+        return this->nodes[node].leaf_data.color;
+    }
+    auto get_child(Node node, int octant) const -> Node {
+        return this->nodes[node].children[octant];
+    }
+} TreeView;
+
+/** View over `GPUOctreeNode`/`GPUVoxelData` arrays, root at slot 0 */
+typedef struct FlatView {
+    typedef uint32_t Node;
+    static constexpr Node NONE = UINT32_MAX;
+
+    const GPUOctreeNode *octree_nodes;
+    const GPUVoxelData *voxel_datas;
+
+    auto get_root() const -> Node { return 0; }
+    auto is_leaf(Node node) const -> bool {
+        // matches the shader: no children and something visible
+        return this->octree_nodes[node].child_mask == 0 &&
+               (this->get_packed_color(node) >> 24) != 0;
+    }
+    auto get_color(Node node) const -> glm::u8vec4 {
+        uint32_t packed = this->get_packed_color(node);
+        return glm::u8vec4(packed & 0xFF, (packed >> 8) & 0xFF,
+                           (packed >> 16) & 0xFF, (packed >> 24) & 0xFF);
+    }
+    auto get_child(Node node, int octant) const -> Node {
+        uint32_t mask = this->octree_nodes[node].child_mask;
+        if ((mask & (1u << octant)) == 0)
+            return NONE;
+
+        // children are packed in octant order, skip the ones before us
+        uint32_t rank = 0;
+        for (int i = 0; i < octant; ++i)
+            rank += (mask >> i) & 1u;
+        return this->octree_nodes[node].first_child_idx + rank;
+    }
+
+  private:
+    auto get_packed_color(Node node) const -> uint32_t {
+        return this->voxel_datas[this->octree_nodes[node].voxel_data_idx]
+            .color_packed;
+    }
+} FlatView;
+
+} // namespace vxng::scene
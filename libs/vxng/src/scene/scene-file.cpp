@@ -0,0 +1,240 @@
+#include "scene-file.h"
+
+#include "vxng/scene.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace vxng::scene {
+
+static auto align_offset(uint64_t offset) -> uint64_t {
+    return (offset + SCENE_FILE_ALIGNMENT - 1) & ~(SCENE_FILE_ALIGNMENT - 1);
+}
+
+/**
+ * Whether every node reachable from `slot` only points inside the arrays, and
+ * is at most `max_depth` levels below it. Cycles show up as paths that are too
+ * deep. `heights` remembers subtrees already checked (-1 if not yet), so
+ * shared DAG subtrees are only walked once.
+ */
+static auto check_subtree(const GPUOctreeNode *nodes, uint32_t slot_count,
+                          uint32_t slot, int max_depth,
+                          std::vector<int> &heights) -> bool {
+    if (heights[slot] >= 0)
+        return heights[slot] <= max_depth;
+
+    const GPUOctreeNode &node = nodes[slot];
+    if (node.child_mask == 0) {
+        if (node.voxel_data_idx >= slot_count)
+            return false;
+        heights[slot] = 0;
+        return true;
+    }
+
+    uint64_t child_end = uint64_t(node.first_child_idx) +
+                         std::bitset<8>(node.child_mask).count();
+    if (node.child_mask > 0xFF || child_end > slot_count || max_depth == 0)
+        return false;
+
+    int height = 0;
+    for (uint32_t child = node.first_child_idx; child < child_end; ++child) {
+        if (!check_subtree(nodes, slot_count, child, max_depth - 1, heights))
+            return false;
+        height = std::max(height, heights[child] + 1);
+    }
+    heights[slot] = height;
+    return true;
+}
+
+auto write_scene_file(const std::string &path, int chunk_resolution,
+                      float chunk_scale, std::vector<SceneFileChunk> chunks)
+    -> bool {
+    // keep output stable regardless of hash map order
+    std::sort(chunks.begin(), chunks.end(),
+              [](const SceneFileChunk &a, const SceneFileChunk &b) {
+                  if (a.coord.x != b.coord.x)
+                      return a.coord.x < b.coord.x;
+                  if (a.coord.y != b.coord.y)
+                      return a.coord.y < b.coord.y;
+                  return a.coord.z < b.coord.z;
+              });
+
+    SceneFileHeader header = {};
+    header.magic = SCENE_FILE_MAGIC;
+    header.version = SCENE_FILE_VERSION;
+    header.chunk_resolution = chunk_resolution;
+    header.chunk_scale = chunk_scale;
+    header.chunk_count = static_cast<uint32_t>(chunks.size());
+
+    // lay out arrays after the index
+    std::vector<SceneFileChunkEntry> entries(chunks.size());
+    uint64_t offset =
+        sizeof(SceneFileHeader) + sizeof(SceneFileChunkEntry) * chunks.size();
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const SceneFileChunk &chunk = chunks[i];
+        SceneFileChunkEntry &entry = entries[i];
+        entry.coord[0] = chunk.coord.x;
+        entry.coord[1] = chunk.coord.y;
+        entry.coord[2] = chunk.coord.z;
+        entry.slot_count = chunk.data.slot_count;
+
+        entry.octree_offset = align_offset(offset);
+        offset = entry.octree_offset +
+                 sizeof(GPUOctreeNode) * uint64_t(chunk.data.slot_count);
+        entry.vxdata_offset = align_offset(offset);
+        offset = entry.vxdata_offset +
+                 sizeof(GPUVoxelData) * uint64_t(chunk.data.slot_count);
+    }
+
+    std::string temp_path = path + ".tmp";
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file for writing: '" << temp_path << "'"
+                  << std::endl;
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(entries.data()),
+               sizeof(SceneFileChunkEntry) * entries.size());
+
+    const char padding[SCENE_FILE_ALIGNMENT] = {};
+    uint64_t written =
+        sizeof(SceneFileHeader) + sizeof(SceneFileChunkEntry) * entries.size();
+    auto write_at = [&](uint64_t at, const void *data, uint64_t size) {
+        file.write(padding, at - written);
+        file.write(static_cast<const char *>(data), size);
+        written = at + size;
+    };
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        const Chunk::SerializedOctree &data = chunks[i].data;
+        write_at(entries[i].octree_offset, data.octree_nodes,
+                 sizeof(GPUOctreeNode) * uint64_t(data.slot_count));
+        write_at(entries[i].vxdata_offset, data.voxel_datas,
+                 sizeof(GPUVoxelData) * uint64_t(data.slot_count));
+    }
+
+    file.close();
+    if (!file) {
+        std::cerr << "Failed to write scene file: '" << temp_path << "'"
+                  << std::endl;
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        std::cerr << "Failed to replace '" << path << "': " << error.message()
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+auto read_scene_file(const std::string &path)
+    -> std::optional<SceneFileContents> {
+    std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    if (!file)
+        return {};
+
+    const uint8_t *data = file->get_data();
+    uint64_t size = file->get_size();
+
+    SceneFileHeader header;
+    if (size < sizeof(header)) {
+        std::cerr << "Not a scene file: '" << path << "'" << std::endl;
+        return {};
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (header.magic != SCENE_FILE_MAGIC) {
+        std::cerr << "Not a scene file: '" << path << "'" << std::endl;
+        return {};
+    }
+    if (header.version != SCENE_FILE_VERSION) {
+        std::cerr << "Unsupported scene file version " << header.version
+                  << std::endl;
+        return {};
+    }
+    if (!(header.chunk_scale > 0.f)) {
+        std::cerr << "Scene file has an invalid chunk scale" << std::endl;
+        return {};
+    }
+    if (header.chunk_resolution <= 0 ||
+        (header.chunk_resolution & (header.chunk_resolution - 1)) != 0) {
+        std::cerr << "Scene file has an invalid chunk resolution" << std::endl;
+        return {};
+    }
+    // octrees can't be any deeper than their voxels are small
+    int max_depth = 0;
+    while ((1 << max_depth) < header.chunk_resolution)
+        max_depth++;
+
+    // check the whole index before handing out any chunks
+    uint64_t index_end = sizeof(SceneFileHeader) +
+                         sizeof(SceneFileChunkEntry) *
+                             static_cast<uint64_t>(header.chunk_count);
+    if (index_end > size) {
+        std::cerr << "Scene file is truncated: '" << path << "'" << std::endl;
+        return {};
+    }
+
+    std::vector<SceneFileChunkEntry> entries(header.chunk_count);
+    std::memcpy(entries.data(), data + sizeof(SceneFileHeader),
+                sizeof(SceneFileChunkEntry) * entries.size());
+
+    auto fits = [size](uint64_t offset, uint64_t length, size_t alignment) {
+        return offset % alignment == 0 && offset <= size &&
+               length <= size - offset;
+    };
+
+    SceneFileContents contents;
+    contents.backing = file;
+    contents.chunk_resolution = header.chunk_resolution;
+    contents.chunk_scale = header.chunk_scale;
+    contents.chunks.reserve(entries.size());
+
+    for (const auto &entry : entries) {
+        if (entry.slot_count == 0 ||
+            !fits(entry.octree_offset,
+                  sizeof(GPUOctreeNode) * uint64_t(entry.slot_count),
+                  alignof(GPUOctreeNode)) ||
+            !fits(entry.vxdata_offset,
+                  sizeof(GPUVoxelData) * uint64_t(entry.slot_count),
+                  alignof(GPUVoxelData))) {
+            std::cerr << "Scene file has a bad chunk entry: '" << path << "'"
+                      << std::endl;
+            return {};
+        }
+
+        SceneFileChunk chunk;
+        chunk.coord = glm::ivec3(entry.coord[0], entry.coord[1], entry.coord[2]);
+        chunk.data.octree_nodes =
+            reinterpret_cast<const GPUOctreeNode *>(data + entry.octree_offset);
+
+        // everything walking the octree later trusts its indices, so check
+        // every one it could follow, starting from the root at slot 0. slots
+        // nothing points at may hold anything
+        std::vector<int> heights(entry.slot_count, -1);
+        if (!check_subtree(chunk.data.octree_nodes, entry.slot_count, 0,
+                           max_depth, heights)) {
+            std::cerr << "Scene file has a corrupt chunk octree: '" << path
+                      << "'" << std::endl;
+            return {};
+        }
+
+        chunk.data.voxel_datas =
+            reinterpret_cast<const GPUVoxelData *>(data + entry.vxdata_offset);
+        chunk.data.slot_count = entry.slot_count;
+        contents.chunks.push_back(chunk);
+    }
+
+    return contents;
+}
+
+} // namespace vxng::scene
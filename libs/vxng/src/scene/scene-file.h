@@ -0,0 +1,79 @@
+#pragma once
+
+#include "chunk.h"
+#include "mapped-file.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace vxng::scene {
+
+/*
+ * Native scene file layout (all little-endian, as written by the host):
+ *
+ *   SceneFileHeader
+ *   SceneFileChunkEntry[chunk_count]
+ *   per chunk, each padded to SCENE_FILE_ALIGNMENT:
+ *     GPUOctreeNode[slot_count]
+ *     GPUVoxelData[slot_count]
+ *
+ * The arrays are exactly what goes into a chunk's storage buffers, so loading
+ * is a matter of mapping the file and pointing at them. The header and index
+ * are validated on load, as is every node and color index reachable from
+ * each chunk's root.
+ */
+
+constexpr uint32_t SCENE_FILE_MAGIC = 0x474E5856; // "VXNG"
+constexpr uint32_t SCENE_FILE_VERSION = 1;
+constexpr uint64_t SCENE_FILE_ALIGNMENT = 16;
+
+typedef struct SceneFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t chunk_resolution;
+    float chunk_scale;
+    uint32_t chunk_count;
+    uint32_t reserved;
+} SceneFileHeader;
+
+typedef struct SceneFileChunkEntry {
+    int32_t coord[3];
+    uint32_t slot_count;
+    uint64_t octree_offset; // from the start of the file
+    uint64_t vxdata_offset;
+} SceneFileChunkEntry;
+
+static_assert(sizeof(SceneFileHeader) == 24, "scene file header is packed");
+static_assert(sizeof(SceneFileChunkEntry) == 32, "chunk entry is packed");
+
+typedef struct SceneFileChunk {
+    glm::ivec3 coord;
+    Chunk::SerializedOctree data;
+} SceneFileChunk;
+
+typedef struct SceneFileContents {
+    std::shared_ptr<const MappedFile> backing; // owns every chunk's arrays
+    int chunk_resolution;
+    float chunk_scale;
+    std::vector<SceneFileChunk> chunks;
+} SceneFileContents;
+
+/**
+ * Writes chunks out in the layout above. Goes through a temporary file that
+ * replaces `path` at the end, so a file that's currently mapped (e.g. the one
+ * we loaded from) stays intact until we're done reading from it.
+ */
+auto write_scene_file(const std::string &path, int chunk_resolution,
+                      float chunk_scale, std::vector<SceneFileChunk> chunks)
+    -> bool;
+
+/** Maps a scene file and checks its header and index, logging on failure */
+auto read_scene_file(const std::string &path)
+    -> std::optional<SceneFileContents>;
+
+} // namespace vxng::scene
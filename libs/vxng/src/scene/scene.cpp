@@ -1,21 +1,44 @@
 #include "vxng/scene.h"
 
+#include "chunk-pager.h"
 #include "chunk.h"
+#include "gpu-chunk-pool.h"
+#include "scene-file.h"
+#include "thread-pool.h"
 
 #include <ogt/ogt_vox.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <random>
 #include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 #define DEFAULT_CHUNK_SCALE 4.0f
 #define DEFAULT_CHUNK_RESOLUTION 512
 
+// spread residency work over frames so no single one hitches
+#define MAX_UPLOADS_PER_UPDATE 4
+#define MAX_SPILLS_PER_UPDATE 8
+
+// rays cast together in `raycast_many`, sharing chunk culling and ordering
+// and octree walks
+#define RAYCAST_PACKET_SIZE 64
+static_assert(RAYCAST_PACKET_SIZE <= 64, "packets take one mask bit per ray");
+
 namespace vxng::scene {
 
 Scene::Scene(int chunk_resolution, float chunk_scale)
-    : chunk_resolution(chunk_resolution), chunk_scale(chunk_scale) {
+    : chunk_resolution(chunk_resolution), chunk_scale(chunk_scale), pager(),
+      residency_budget(), residency_stats(), chunk_pool(),
+      distance_grid_resolution(0) {
     if (chunk_resolution <= 0 ||
         !((chunk_resolution & (chunk_resolution - 1)) == 0)) {
         throw std::invalid_argument("Chunk resolution must be a power of 2");
@@ -28,12 +51,25 @@ Scene::Scene(int chunk_resolution, float chunk_scale)
 
 Scene::Scene()
     : chunk_resolution(DEFAULT_CHUNK_RESOLUTION),
-      chunk_scale(DEFAULT_CHUNK_SCALE) {}
+      chunk_scale(DEFAULT_CHUNK_SCALE), pager(), residency_budget(),
+      residency_stats(), chunk_pool(), distance_grid_resolution(0) {}
 
 Scene::~Scene() {}
 
 auto Scene::init_webgpu(wgpu::Device device) -> void {
     this->wgpu.device = device;
+
+    // the pool every chunk goes into
+    if (!this->chunk_pool) {
+        this->chunk_pool = std::make_unique<GPUChunkPool>();
+        this->chunk_pool->init_webgpu(device);
+    }
+
+    // catch up on any chunks built before we had a device
+    for (auto &chunk_pair : this->chunks) {
+        chunk_pair.second->init_webgpu(this->chunk_pool.get());
+    }
+
     touch_chunk(glm::ivec3(0.f));
 }
 
@@ -42,6 +78,10 @@ auto Scene::get_chunks() const
     return this->chunks;
 }
 
+auto Scene::get_chunk_pool() const -> const GPUChunkPool * {
+    return this->chunk_pool.get();
+}
+
 auto Scene::fill_basic_plane(glm::u8vec4 color) -> void {
     // set 4 base plates filled
     float delta = this->chunk_scale / (float)this->chunk_resolution * 0.5f;
@@ -66,54 +106,270 @@ auto Scene::fill_center_cubes(int depth, glm::u8vec4 color) -> void {
     }
 }
 
-auto Scene::load_vox_file(const std::vector<uint8_t> &buffer) -> void {
-    const ogt_vox_scene *scene = ogt_vox_read_scene(&buffer[0], buffer.size());
+// A model instance, rotated into our axes and rasterized into a dense grid of
+// palette indices, positioned in global (scene-wide) voxel coordinates
+typedef struct VoxInstanceGrid {
+    const ogt_vox_model *model;
+    glm::ivec3 axes[3]; // where one step along model x/y/z lands
+    glm::ivec3 origin;  // where model voxel (0, 0, 0) lands
+    glm::ivec3 min;     // grid bounds
+    glm::ivec3 size;
+    std::vector<uint8_t> voxels;
+} VoxInstanceGrid;
+
+// convert coordinate systems (swap Y and Z)
+// MagicaVoxel: X, Y, Z (up)
+// Our scene:   X, Z, Y (up)
+static auto vox_to_scene_axes(glm::ivec3 v) -> glm::ivec3 {
+    return glm::ivec3(v.x, v.z, v.y);
+}
+
+static auto is_vox_instance_visible(const ogt_vox_scene *scene,
+                                    const ogt_vox_instance &instance) -> bool {
+    if (instance.hidden)
+        return false;
+    if (instance.layer_index < scene->num_layers &&
+        scene->layers[instance.layer_index].hidden)
+        return false;
+
+    uint32_t group_index = instance.group_index;
+    while (group_index != k_invalid_group_index &&
+           group_index < scene->num_groups) {
+        const ogt_vox_group &group = scene->groups[group_index];
+        if (group.hidden)
+            return false;
+        group_index = group.parent_group_index;
+    }
+    return true;
+}
+
+auto LoadProgress::get_fraction() const -> float {
+    // building octrees is the bulk of the work; phases a load doesn't have
+    // (nothing to voxelize in a native file) are left out entirely
+    float weighted = 0.f;
+    float weight_sum = 0.f;
+    auto add_phase = [&](float weight, size_t done, size_t total) {
+        if (total == 0)
+            return;
+        weighted += weight * static_cast<float>(done) / total;
+        weight_sum += weight;
+    };
+    add_phase(0.1f, this->bytes_parsed, this->bytes_total);
+    add_phase(0.3f, this->voxels_inserted, this->voxels_total);
+    add_phase(0.6f, this->chunks_built, this->chunks_total);
+
+    return weight_sum == 0.f ? 0.f : weighted / weight_sum;
+}
+
+auto Scene::load_vox_file(const std::vector<uint8_t> &buffer,
+                          LoadProgress *progress) -> void {
+    if (buffer.empty()) {
+        std::cerr << "Vox file is empty" << std::endl;
+        return;
+    }
+
+    const ogt_vox_scene *scene =
+        ogt_vox_read_scene(buffer.data(), buffer.size());
+    if (!scene) {
+        std::cerr << "Failed to parse vox file" << std::endl;
+        return;
+    }
+    // freed however we leave, including by a worker throwing
+    std::unique_ptr<const ogt_vox_scene, void (*)(const ogt_vox_scene *)>
+        scene_owner(scene, ogt_vox_destroy_scene);
+    if (progress)
+        progress->bytes_parsed += buffer.size();
+
+    std::array<glm::u8vec4, 256> palette = {};
+    for (int i = 0; i < 256; ++i) {
+        const ogt_vox_rgba &color = scene->palette.color[i];
+        palette[i] = glm::u8vec4(color.r, color.g, color.b, 255);
+    }
+
+    // the scene origin sits in the middle of chunk (0, 0, 0)
+    glm::ivec3 origin_voxel = glm::ivec3(this->chunk_resolution / 2);
 
-    // do stuff with scene...
-    for (int i = 0; i < scene->num_models; ++i) {
-        const ogt_vox_model *model = scene->models[i];
+    // --------- Place instances ---------
 
-        std::cout << "model found: " << model->size_x << "x" << model->size_y
-                  << "x" << model->size_z << std::endl;
+    std::vector<VoxInstanceGrid> grids;
+    for (uint32_t i = 0; i < scene->num_instances; ++i) {
+        const ogt_vox_instance &instance = scene->instances[i];
+        if (!is_vox_instance_visible(scene, instance))
+            continue;
+
+        const ogt_vox_model *model = scene->models[instance.model_index];
+        ogt_vox_transform t =
+            ogt_vox_sample_instance_transform_global(&instance, 0, scene);
+
+        // MagicaVoxel transforms are signed axis permutations about the
+        // model's center voxel, applied to voxel centers:
+        //   world = R * (voxel - floor(size / 2) + 0.5) + translation
+        glm::ivec3 columns[3] = {
+            glm::ivec3(std::round(t.m00), std::round(t.m01),
+                       std::round(t.m02)),
+            glm::ivec3(std::round(t.m10), std::round(t.m11),
+                       std::round(t.m12)),
+            glm::ivec3(std::round(t.m20), std::round(t.m21),
+                       std::round(t.m22)),
+        };
+        glm::vec3 pivot =
+            glm::vec3(0.5f) - glm::vec3(model->size_x / 2, model->size_y / 2,
+                                        model->size_z / 2);
+        glm::vec3 world_origin = glm::vec3(columns[0]) * pivot.x +
+                                 glm::vec3(columns[1]) * pivot.y +
+                                 glm::vec3(columns[2]) * pivot.z +
+                                 glm::vec3(t.m30, t.m31, t.m32);
+
+        VoxInstanceGrid grid;
+        grid.model = model;
+        for (int axis = 0; axis < 3; ++axis)
+            grid.axes[axis] = vox_to_scene_axes(columns[axis]);
+        grid.origin =
+            vox_to_scene_axes(glm::ivec3(glm::floor(world_origin))) +
+            origin_voxel;
+
+        // bounds from the transformed corner voxels
+        glm::ivec3 last(model->size_x - 1, model->size_y - 1,
+                        model->size_z - 1);
+        glm::ivec3 min = grid.origin, max = grid.origin;
+        for (int corner = 1; corner < 8; ++corner) {
+            glm::ivec3 p = grid.origin +
+                           grid.axes[0] * ((corner & 1) ? last.x : 0) +
+                           grid.axes[1] * ((corner & 2) ? last.y : 0) +
+                           grid.axes[2] * ((corner & 4) ? last.z : 0);
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+        grid.min = min;
+        grid.size = max - min + glm::ivec3(1);
+        grid.voxels.assign(grid.size.x * grid.size.y * grid.size.z, 0);
 
-        int voxel_count = model->size_x * model->size_y * model->size_z;
+        grids.push_back(std::move(grid));
+    }
+
+    ThreadPool &pool = ThreadPool::get_shared();
+
+    // --------- Rasterize instances (one task per model z-slice) ---------
+
+    std::vector<std::pair<size_t, int>> slices;
+    for (size_t g = 0; g < grids.size(); ++g) {
+        for (uint32_t z = 0; z < grids[g].model->size_z; ++z)
+            slices.push_back({g, z});
+    }
 
-        std::array<glm::u8vec4, 256> palette = {};
-        for (int i = 0; i < 256; ++i) {
-            const ogt_vox_rgba &color = scene->palette.color[i];
-            palette[i] = glm::u8vec4(color.r, color.g, color.b, 255);
+    if (progress) {
+        for (const auto &grid : grids) {
+            progress->voxels_total += grid.model->size_x *
+                                      grid.model->size_y *
+                                      grid.model->size_z;
         }
+    }
+
+    pool.parallel_for(slices.size(), [&grids, &slices, progress](size_t task) {
+        VoxInstanceGrid &grid = grids[slices[task].first];
+        int z = slices[task].second;
+        const ogt_vox_model *model = grid.model;
 
-        // convert coordinate systems (swap Y and Z)
-        // MagicaVoxel: X, Y (up), Z
-        // Our scene:   X, Z (up), Y
-        std::vector<uint8_t> transformed_voxel_data(voxel_count, 0);
+        for (uint32_t y = 0; y < model->size_y; ++y) {
+            const uint8_t *src_row =
+                &model->voxel_data[(y * model->size_x) +
+                                   (z * model->size_x * model->size_y)];
+            glm::ivec3 dst = grid.origin + grid.axes[1] * (int)y +
+                             grid.axes[2] * z - grid.min;
 
-        for (int x = 0; x < model->size_x; ++x) {
-            for (int y = 0; y < model->size_y; ++y) {
-                for (int z = 0; z < model->size_z; ++z) {
-                    // Original index (MagicaVoxel coordinates)
-                    int src_idx = x + (y * model->size_x) +
-                                  (z * model->size_x * model->size_y);
+            for (uint32_t x = 0; x < model->size_x; ++x, dst += grid.axes[0]) {
+                if (src_row[x] == 0)
+                    continue;
 
-                    // New index (swapped Y and Z)
-                    int dst_idx = x + (z * model->size_x) +
-                                  (y * model->size_x * model->size_z);
+                grid.voxels[dst.x + (dst.y * grid.size.x) +
+                            (dst.z * grid.size.x * grid.size.y)] = src_row[x];
+            }
+        }
 
-                    transformed_voxel_data[dst_idx] =
-                        model->voxel_data[src_idx];
+        if (progress)
+            progress->voxels_inserted += model->size_x * model->size_y;
+    });
+
+    // --------- Bucket instances by chunk ---------
+
+    typedef struct ChunkWork {
+        glm::ivec3 coord;
+        Chunk *chunk;
+        std::vector<size_t> grid_indices;
+    } ChunkWork;
+
+    std::vector<ChunkWork> work;
+    std::unordered_map<glm::ivec3, size_t> work_index;
+
+    // later writes win, so go from least to most important instance. Since
+    // format version 200, lower instance numbers take precedence.
+    bool lower_wins = scene->file_version >= 200;
+    for (size_t n = 0; n < grids.size(); ++n) {
+        size_t g = lower_wins ? grids.size() - 1 - n : n;
+        const VoxInstanceGrid &grid = grids[g];
+
+        float res = static_cast<float>(this->chunk_resolution);
+        glm::ivec3 first_chunk = glm::floor(glm::vec3(grid.min) / res);
+        glm::ivec3 last_chunk =
+            glm::floor(glm::vec3(grid.min + grid.size - glm::ivec3(1)) / res);
+
+        for (int cx = first_chunk.x; cx <= last_chunk.x; ++cx) {
+            for (int cy = first_chunk.y; cy <= last_chunk.y; ++cy) {
+                for (int cz = first_chunk.z; cz <= last_chunk.z; ++cz) {
+                    glm::ivec3 coord(cx, cy, cz);
+                    auto found = work_index.find(coord);
+                    if (found == work_index.end()) {
+                        // chunks are created here, but only set up for
+                        // webgpu once building is done
+                        Chunk *chunk = page_in_chunk(coord);
+                        if (!chunk)
+                            chunk = create_chunk(coord);
+
+                        found = work_index.emplace(coord, work.size()).first;
+                        work.push_back(ChunkWork{coord, chunk, {}});
+                    }
+                    work[found->second].grid_indices.push_back(g);
                 }
             }
         }
+    }
+
+    // --------- Build chunk octrees (one task per chunk) ---------
+
+    if (progress)
+        progress->chunks_total += work.size();
+
+    int chunk_resolution = this->chunk_resolution;
+    pool.parallel_for(work.size(), [&work, &grids, &palette, chunk_resolution,
+                                    progress](size_t task) {
+        ChunkWork &chunk_work = work[task];
+        glm::ivec3 chunk_min_voxel = chunk_work.coord * chunk_resolution;
+
+        for (size_t g : chunk_work.grid_indices) {
+            const VoxInstanceGrid &grid = grids[g];
+            chunk_work.chunk->set_voxel_grid_data(
+                grid.voxels.data(), grid.size, palette,
+                grid.min - chunk_min_voxel, true);
+        }
+
+        if (progress)
+            progress->chunks_built++;
+    });
 
-        auto ouraxes_size =
-            glm::ivec3(model->size_x, model->size_z, model->size_y);
-        this->chunks[{0, 0, 0}]->set_voxel_grid_data(
-            transformed_voxel_data.data(), ouraxes_size, palette,
-            glm::ivec3(256) - ouraxes_size / 2);
+    // --------- Upload (calling thread only) ---------
+
+    if (this->wgpu.device) {
+        for (auto &chunk_work : work) {
+            if (chunk_work.chunk->is_webgpu_initialized())
+                chunk_work.chunk->force_update_buffers();
+            else
+                chunk_work.chunk->init_webgpu(this->chunk_pool.get());
+        }
     }
 
-    ogt_vox_destroy_scene(scene);
+    std::cout << "loaded " << grids.size() << " instances of "
+              << scene->num_models << " models into " << work.size()
+              << " chunks" << std::endl;
 }
 
 auto Scene::sample_position(glm::vec3 position) const
@@ -150,22 +406,256 @@ auto Scene::raycast(const geometry::Ray &ray) const -> geometry::RaycastResult {
     return closest_hit;
 }
 
-auto Scene::set_voxel_filled(int depth, glm::vec3 position, glm::u8vec4 color,
-                             bool skip_update_buffers) -> void {
+auto Scene::raycast_many(const std::vector<geometry::Ray> &rays) const
+    -> std::vector<geometry::RaycastResult> {
+    const float no_hit = std::numeric_limits<float>::max();
+    std::vector<geometry::RaycastResult> results(
+        rays.size(), {false, no_hit, false, glm::vec3(0.f)});
+
+    // chunks are only read from here on, so they can be cast from any thread
+    typedef struct CastChunk {
+        geometry::AABB bounds;
+        const Chunk *chunk;
+    } CastChunk;
+    std::vector<CastChunk> chunks;
+    for (const auto &chunk_pair : this->chunks) {
+        chunks.push_back(
+            {chunk_pair.second->get_bounds(), chunk_pair.second.get()});
+    }
+    if (rays.empty() || chunks.empty())
+        return results;
+
+    size_t packet_count =
+        (rays.size() + RAYCAST_PACKET_SIZE - 1) / RAYCAST_PACKET_SIZE;
+    ThreadPool::get_shared().parallel_for(packet_count, [&](size_t packet) {
+        size_t first = packet * RAYCAST_PACKET_SIZE;
+        size_t count = std::min<size_t>(RAYCAST_PACKET_SIZE, rays.size() - first);
+
+        // one array per component, so the slab tests below vectorize
+        float origin[3][RAYCAST_PACKET_SIZE];
+        float inv_dir[3][RAYCAST_PACKET_SIZE];
+        for (size_t i = 0; i < count; ++i) {
+            for (int axis = 0; axis < 3; ++axis) {
+                origin[axis][i] = rays[first + i].origin[axis];
+                inv_dir[axis][i] = 1.f / rays[first + i].direction[axis];
+            }
+        }
+
+        // where each ray enters each chunk, if it does
+        std::vector<float> entries(chunks.size() * RAYCAST_PACKET_SIZE);
+        std::vector<std::pair<float, size_t>> order;
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            const geometry::AABB &bounds = chunks[c].bounds;
+            float *entry = &entries[c * RAYCAST_PACKET_SIZE];
+            float nearest = no_hit;
+            for (size_t i = 0; i < count; ++i) {
+                float t_near = 0.f, t_far = no_hit;
+                for (int axis = 0; axis < 3; ++axis) {
+                    float t0 = (bounds.min[axis] - origin[axis][i]) *
+                               inv_dir[axis][i];
+                    float t1 = (bounds.max[axis] - origin[axis][i]) *
+                               inv_dir[axis][i];
+                    t_near = std::max(t_near, std::min(t0, t1));
+                    t_far = std::min(t_far, std::max(t0, t1));
+                }
+                entry[i] = t_near <= t_far ? t_near : no_hit;
+                nearest = std::min(nearest, entry[i]);
+            }
+            if (nearest < no_hit)
+                order.push_back({nearest, c});
+        }
+
+        // front to back over the packet, so most rays stop at the first chunks
+        std::sort(order.begin(), order.end());
+        geometry::RaycastResult hits[RAYCAST_PACKET_SIZE];
+        for (auto [nearest, c] : order) {
+            const float *entry = &entries[c * RAYCAST_PACKET_SIZE];
+            uint64_t mask = 0;
+            for (size_t i = 0; i < count; ++i) {
+                if (entry[i] < results[first + i].t)
+                    mask |= 1ull << i;
+            }
+            if (mask == 0)
+                continue;
+
+            // each ray reaches the same leaf as it would in `raycast`, so
+            // ties on voxel edges break the same way
+            chunks[c].chunk->raycast_packet(&rays[first], mask, hits);
+            for (size_t i = 0; i < count; ++i) {
+                geometry::RaycastResult &result = results[first + i];
+                if ((mask >> i & 1) && hits[i].hit && hits[i].t < result.t)
+                    result = hits[i];
+            }
+        }
+    });
+
+    return results;
+}
+
+auto Scene::set_voxel_filled(int depth, glm::vec3 position, glm::u8vec4 color)
+    -> void {
     auto chunked_location = get_chunked_location_info(position);
     Chunk *target_chunk = touch_chunk(chunked_location.chunk_coord);
 
     target_chunk->set_voxel_filled(depth, chunked_location.local_position,
-                                   color, skip_update_buffers);
+                                   color, true);
+    this->stale_chunks.insert(chunked_location.chunk_coord);
 }
 
-auto Scene::set_voxel_empty(int depth, glm::vec3 position,
-                            bool skip_update_buffers) -> void {
+auto Scene::set_voxel_empty(int depth, glm::vec3 position) -> void {
     auto chunked_location = get_chunked_location_info(position);
     Chunk *target_chunk = touch_chunk(chunked_location.chunk_coord);
 
     target_chunk->set_voxel_empty(depth, chunked_location.local_position,
-                                  skip_update_buffers);
+                                  true);
+    this->stale_chunks.insert(chunked_location.chunk_coord);
+}
+
+auto EditRecord::is_empty() const -> bool { return this->chunks.empty(); }
+
+auto EditRecord::get_memory_usage() const -> size_t {
+    size_t bytes = sizeof(EditRecord);
+    for (const ChunkCells &cells : this->chunks) {
+        bytes += sizeof(ChunkCells) +
+                 cells.cells.capacity() * sizeof(cells.cells[0]) +
+                 cells.tokens.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+auto Scene::apply_region_edit(const RegionEdit &edit, EditRecord *record)
+    -> void {
+    if (edit.depth < 0 || edit.depth > std::log2(this->chunk_resolution)) {
+        throw std::invalid_argument(
+            "Depth must be >= 0 and <= log2(resolution)");
+    }
+
+    // region offsets, in voxels
+    std::vector<glm::ivec3> offsets;
+    switch (edit.shape) {
+    case RegionEdit::SHAPE_SPHERE: {
+        int reach = static_cast<int>(std::ceil(edit.radius));
+        for (int x = -reach; x <= reach; ++x) {
+            for (int y = -reach; y <= reach; ++y) {
+                for (int z = -reach; z <= reach; ++z) {
+                    if (glm::length(glm::vec3(x, y, z)) < edit.radius)
+                        offsets.push_back(glm::ivec3(x, y, z));
+                }
+            }
+        }
+        break;
+    }
+    case RegionEdit::SHAPE_BOX: {
+        glm::ivec3 half = glm::abs(edit.half_size);
+        for (int x = -half.x; x <= half.x; ++x) {
+            for (int y = -half.y; y <= half.y; ++y) {
+                for (int z = -half.z; z <= half.z; ++z)
+                    offsets.push_back(glm::ivec3(x, y, z));
+            }
+        }
+        break;
+    }
+    case RegionEdit::SHAPE_MASK:
+        offsets = edit.mask;
+        break;
+    case RegionEdit::SHAPE_SPANS:
+        // split up by chunk below, a run at a time
+        break;
+    }
+
+    // voxel coords counted from the low corner of chunk (0, 0, 0), so the
+    // chunk holding each is just a floored division away
+    int side = 1 << edit.depth;
+    float voxel_size = this->chunk_scale / side;
+    glm::ivec3 center_voxel = glm::floor(
+        (edit.center + glm::vec3(this->chunk_scale * 0.5f)) / voxel_size);
+
+    std::unordered_map<glm::ivec3, std::vector<glm::ivec3>> chunk_voxels;
+    for (glm::ivec3 offset : offsets) {
+        glm::ivec3 voxel = center_voxel + offset;
+        glm::ivec3 chunk_coord =
+            glm::floor(glm::vec3(voxel) / static_cast<float>(side));
+        chunk_voxels[chunk_coord].push_back(voxel - chunk_coord * side);
+    }
+    if (edit.shape == RegionEdit::SHAPE_SPANS) {
+        // a row only needs its chunk looked up where it crosses into one
+        for (const RegionEdit::Span &span : edit.spans) {
+            glm::ivec3 voxel = center_voxel + span.start;
+            int end_x = voxel.x + span.length;
+            while (voxel.x < end_x) {
+                glm::ivec3 chunk_coord =
+                    glm::floor(glm::vec3(voxel) / static_cast<float>(side));
+                int run_end = std::min(end_x, (chunk_coord.x + 1) * side);
+
+                auto &voxels = chunk_voxels[chunk_coord];
+                glm::ivec3 local = voxel - chunk_coord * side;
+                for (; voxel.x < run_end; ++voxel.x, ++local.x)
+                    voxels.push_back(local);
+            }
+        }
+    }
+
+    for (auto &[chunk_coord, voxels] : chunk_voxels) {
+        // nothing to erase or paint in a chunk that doesn't exist
+        if (edit.operation != RegionEdit::OPERATION_FILL &&
+            !page_in_chunk(chunk_coord))
+            continue;
+
+        Chunk *chunk = touch_chunk(chunk_coord);
+        if (record) {
+            // add on to this chunk's latest captures if they're at the same
+            // depth, as cells at one depth never partly overlap
+            auto latest = std::find_if(
+                record->chunks.rbegin(), record->chunks.rend(),
+                [&](const EditRecord::ChunkCells &cells) {
+                    return cells.chunk_coord == chunk_coord;
+                });
+            if (latest == record->chunks.rend() ||
+                latest->depth != edit.depth) {
+                record->chunks.push_back({chunk_coord, edit.depth, {}, {}});
+                latest = record->chunks.rbegin();
+            }
+            chunk->capture_cells(voxels, *latest);
+        }
+
+        chunk->apply_region(edit.depth, voxels, edit.operation, edit.color,
+                            true);
+        this->stale_chunks.insert(chunk_coord);
+    }
+}
+
+auto Scene::swap_edit_record(EditRecord &record) -> void {
+    // later captures can overlap earlier ones at other depths, so put them
+    // back newest first; reversing afterwards keeps that true for a redo
+    for (auto cells = record.chunks.rbegin(); cells != record.chunks.rend();
+         ++cells) {
+        touch_chunk(cells->chunk_coord)->swap_cells(*cells, true);
+        this->stale_chunks.insert(cells->chunk_coord);
+    }
+    std::reverse(record.chunks.begin(), record.chunks.end());
+}
+
+auto Scene::flush_chunk_buffers() -> void {
+    std::vector<Chunk *> targets;
+    for (glm::ivec3 chunk_coord : this->stale_chunks) {
+        // chunks paged out since have nothing to upload to
+        auto found = this->chunks.find(chunk_coord);
+        if (found != this->chunks.end() &&
+            found->second->is_webgpu_initialized())
+            targets.push_back(found->second.get());
+    }
+    this->stale_chunks.clear();
+
+    // serializing is chunk-local, so it spreads across the pool; the uploads
+    // stay on this thread
+    ThreadPool::get_shared().parallel_for(
+        targets.size(), [&targets](size_t i) { targets[i]->prepare_buffers(); });
+    for (Chunk *chunk : targets)
+        chunk->force_update_buffers();
+
+    // anything released since (paged out, or shrunk) is given back in one go
+    if (this->chunk_pool)
+        this->chunk_pool->compact();
 }
 
 auto Scene::force_update_chunk_buffers(glm::vec3 position) -> void {
@@ -195,6 +685,26 @@ auto Scene::set_chunk_scale(float new_scale) -> void {
     }
 }
 
+auto Scene::set_distance_grid_resolution(int resolution) -> void {
+    if (resolution != 0 &&
+        (resolution < 2 || resolution > 64 ||
+         (resolution & (resolution - 1)) != 0 ||
+         resolution > this->chunk_resolution)) {
+        throw std::invalid_argument(
+            "Distance grid resolution must be 0, or a power of 2 from 2 to 64 "
+            "no finer than the chunks");
+    }
+
+    this->distance_grid_resolution = resolution;
+    for (auto &chunk_pair : this->chunks) {
+        chunk_pair.second->set_distance_grid_resolution(resolution);
+    }
+}
+
+auto Scene::get_distance_grid_resolution() const -> int {
+    return this->distance_grid_resolution;
+}
+
 auto Scene::get_chunked_location_info(glm::vec3 position) const
     -> ChunkedLocationInfo {
     glm::ivec3 chunk_coord = glm::floor(
@@ -209,21 +719,283 @@ auto Scene::get_chunked_location_info(glm::vec3 position) const
 }
 
 auto Scene::touch_chunk(glm::ivec3 chunk_coord) -> Chunk * {
-    // if chunk already exists just grab it
-    if (this->chunks.find(chunk_coord) != this->chunks.end()) {
-        return this->chunks[chunk_coord].get();
-    }
+    // if chunk already exists (maybe on disk) just grab it, otherwise we gotta
+    // create the chunk
+    Chunk *chunk = page_in_chunk(chunk_coord);
+    if (!chunk)
+        chunk = create_chunk(chunk_coord);
+
+    // and init webgpu
+    if (this->wgpu.device && !chunk->is_webgpu_initialized())
+        chunk->init_webgpu(this->chunk_pool.get());
 
-    // otherwise, we gotta create the chunk
+    return chunk;
+}
+
+auto Scene::create_chunk(glm::ivec3 chunk_coord) -> Chunk * {
     glm::vec3 chunk_origin = glm::vec3(chunk_coord) * this->chunk_scale;
-    this->chunks[chunk_coord] = std::make_unique<Chunk>(
-        chunk_origin, this->chunk_scale, this->chunk_resolution);
-    auto &new_chunk = this->chunks[chunk_coord];
+    auto &chunk = this->chunks[chunk_coord];
+    chunk = std::make_unique<Chunk>(chunk_origin, this->chunk_scale,
+                                    this->chunk_resolution);
+    chunk->set_distance_grid_resolution(this->distance_grid_resolution);
 
-    // and init webgpu
-    new_chunk->init_webgpu(this->wgpu.device);
+    return chunk.get();
+}
+
+auto Scene::page_in_chunk(glm::ivec3 chunk_coord) -> Chunk * {
+    auto found = this->chunks.find(chunk_coord);
+    if (found != this->chunks.end())
+        return found->second.get();
+
+    if (!this->pager)
+        return nullptr;
+
+    auto stored = this->pager->take(chunk_coord);
+    if (!stored)
+        return nullptr;
+
+    Chunk *chunk = create_chunk(chunk_coord);
+    chunk->load_serialized(stored->backing, stored->data);
+    return chunk;
+}
+
+auto Scene::save_file(const std::string &path) -> bool {
+    std::vector<SceneFileChunk> file_chunks;
+    for (auto &chunk_pair : this->chunks) {
+        file_chunks.push_back(
+            SceneFileChunk{chunk_pair.first, chunk_pair.second->serialize()});
+    }
+
+    // paged out chunks go straight from their mappings
+    if (this->pager) {
+        for (const auto &[coord, stored] : this->pager->get_stored()) {
+            file_chunks.push_back(SceneFileChunk{coord, stored.data});
+        }
+    }
+
+    size_t chunk_count = file_chunks.size();
+    if (!write_scene_file(path, this->chunk_resolution, this->chunk_scale,
+                          std::move(file_chunks)))
+        return false;
+
+    std::cout << "Saved " << chunk_count << " chunk(s) to '" << path << "'"
+              << std::endl;
+    return true;
+}
+
+auto Scene::load_file(const std::string &path, LoadProgress *progress)
+    -> bool {
+    auto contents = read_scene_file(path);
+    if (!contents)
+        return false;
+
+    if (contents->chunk_resolution != this->chunk_resolution) {
+        std::cerr << "Scene file chunk resolution "
+                  << contents->chunk_resolution << " doesn't match ours ("
+                  << this->chunk_resolution << ")" << std::endl;
+        return false;
+    }
+
+    // only the index has really been read, the rest comes in as it's touched
+    if (progress) {
+        progress->bytes_total += contents->backing->get_size();
+        progress->bytes_parsed += contents->backing->get_size();
+        progress->chunks_total += contents->chunks.size();
+    }
+
+    if (contents->chunk_scale != this->chunk_scale)
+        set_chunk_scale(contents->chunk_scale);
+
+    for (const auto &file_chunk : contents->chunks) {
+        if (this->pager) {
+            // leave it on disk until it comes into range
+            this->chunks.erase(file_chunk.coord);
+            this->pager->store(file_chunk.coord,
+                               StoredChunk{contents->backing, file_chunk.data});
+        } else {
+            Chunk *chunk = create_chunk(file_chunk.coord);
+            chunk->load_serialized(contents->backing, file_chunk.data);
+            if (this->wgpu.device)
+                chunk->init_webgpu(this->chunk_pool.get());
+        }
+
+        if (progress)
+            progress->chunks_built++;
+    }
+
+    std::cout << "Loaded " << contents->chunks.size() << " chunk(s) from '"
+              << path << "'" << std::endl;
+    return true;
+}
+
+auto Scene::compress_chunks() -> void {
+    std::vector<Chunk *> targets;
+    size_t slots_before = 0;
+    for (auto &chunk_pair : this->chunks) {
+        targets.push_back(chunk_pair.second.get());
+        slots_before += chunk_pair.second->serialize().slot_count;
+    }
+
+    // building the dags is chunk-local, uploads stay on this thread
+    ThreadPool::get_shared().parallel_for(
+        targets.size(), [&targets](size_t i) { targets[i]->compress(true); });
+
+    size_t slots_after = 0;
+    for (Chunk *chunk : targets) {
+        chunk->force_update_buffers();
+        slots_after += chunk->serialize().slot_count;
+    }
+
+    size_t slot_size = sizeof(GPUOctreeNode) + sizeof(GPUVoxelData);
+    std::cout << "Compressed " << targets.size() << " chunk(s) from "
+              << slots_before * slot_size / 1024 << " KB to "
+              << slots_after * slot_size / 1024 << " KB" << std::endl;
+}
+
+auto Scene::enable_streaming(const ResidencyBudget &budget) -> void {
+    this->residency_budget = budget;
+    if (this->pager)
+        return;
+
+    // every scene spills into its own directory
+    std::error_code error;
+    std::filesystem::path temp_dir =
+        std::filesystem::temp_directory_path(error);
+    if (error)
+        temp_dir = std::filesystem::current_path();
+
+    std::random_device random;
+    std::string dir_name = "vxng-spill-" + std::to_string(random()) + "-" +
+                           std::to_string(random());
+    this->pager = std::make_unique<ChunkPager>(temp_dir / dir_name);
+}
+
+auto Scene::disable_streaming() -> void {
+    if (!this->pager)
+        return;
+
+    std::vector<glm::ivec3> stored_coords;
+    for (const auto &stored_pair : this->pager->get_stored())
+        stored_coords.push_back(stored_pair.first);
+
+    for (glm::ivec3 coord : stored_coords)
+        page_in_chunk(coord);
+
+    if (this->wgpu.device) {
+        for (auto &chunk_pair : this->chunks) {
+            if (!chunk_pair.second->is_webgpu_initialized())
+                chunk_pair.second->init_webgpu(this->chunk_pool.get());
+        }
+    }
+
+    this->pager.reset();
+    this->residency_stats = {};
+}
+
+auto Scene::is_streaming() const -> bool { return this->pager != nullptr; }
+
+auto Scene::update_residency(glm::vec3 focus) -> void {
+    if (!this->pager)
+        return;
+
+    float radius = this->residency_budget.radius;
+    auto distance_to_chunk = [this, focus](glm::ivec3 coord) {
+        glm::vec3 offset =
+            glm::abs(focus - glm::vec3(coord) * this->chunk_scale);
+        return glm::length(glm::max(
+            offset - glm::vec3(this->chunk_scale * 0.5f), glm::vec3(0.f)));
+    };
+
+    // reads that finished come in frozen, buffers are handed out below
+    for (glm::ivec3 coord : this->pager->take_prefetched()) {
+        if (distance_to_chunk(coord) <= radius)
+            page_in_chunk(coord);
+    }
+
+    // and start reading whatever's come into range since
+    for (const auto &stored_pair : this->pager->get_stored()) {
+        if (distance_to_chunk(stored_pair.first) <= radius)
+            this->pager->prefetch(stored_pair.first);
+    }
+
+    // nearest chunks get first pick of both budgets
+    std::vector<std::pair<float, glm::ivec3>> by_distance;
+    by_distance.reserve(this->chunks.size());
+    for (const auto &chunk_pair : this->chunks) {
+        by_distance.push_back(
+            {distance_to_chunk(chunk_pair.first), chunk_pair.first});
+    }
+    std::sort(by_distance.begin(), by_distance.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    ResidencyStats stats = {};
+    int uploads = 0;
+    int spills = 0;
+    std::vector<glm::ivec3> evicted;
+
+    for (const auto &[distance, coord] : by_distance) {
+        Chunk *chunk = this->chunks[coord].get();
+        bool in_range = distance <= radius;
+
+        // gpu: buffers for whatever's in range, until they don't fit
+        size_t gpu_bytes = chunk->get_gpu_memory_usage();
+        bool fits_gpu = stats.gpu_bytes + gpu_bytes <=
+                        this->residency_budget.max_gpu_bytes;
+        if (in_range && fits_gpu && this->wgpu.device &&
+            !chunk->is_webgpu_initialized() &&
+            uploads < MAX_UPLOADS_PER_UPDATE) {
+            chunk->init_webgpu(this->chunk_pool.get());
+            gpu_bytes = chunk->get_gpu_memory_usage();
+            uploads++;
+        }
+        if (chunk->is_webgpu_initialized()) {
+            if (in_range && fits_gpu) {
+                stats.gpu_bytes += gpu_bytes;
+                stats.gpu_chunks++;
+            } else {
+                chunk->release_webgpu();
+            }
+        }
+
+        // cpu: spill edited trees once over budget, mapping them back in
+        size_t cpu_bytes = chunk->get_cpu_memory_usage();
+        if (cpu_bytes > 0 &&
+            stats.cpu_bytes + cpu_bytes > this->residency_budget.max_cpu_bytes &&
+            spills < MAX_SPILLS_PER_UPDATE) {
+            // spill as a dag, which is usually a fraction of the size
+            chunk->compress();
+            auto stored =
+                this->pager->spill(coord, chunk->serialize(),
+                                   this->chunk_resolution, this->chunk_scale);
+            if (stored) {
+                chunk->freeze(stored->backing, stored->data);
+                cpu_bytes = chunk->get_cpu_memory_usage();
+            }
+            spills++;
+        }
+        stats.cpu_bytes += cpu_bytes;
+
+        // nothing left but a mapping and we're out of range, let it go
+        if (!in_range && chunk->is_frozen() && cpu_bytes == 0 &&
+            !chunk->is_webgpu_initialized())
+            evicted.push_back(coord);
+        else
+            stats.resident_chunks++;
+    }
+
+    for (glm::ivec3 coord : evicted) {
+        Chunk *chunk = this->chunks[coord].get();
+        this->pager->store(coord,
+                           StoredChunk{chunk->get_backing(), chunk->serialize()});
+        this->chunks.erase(coord);
+    }
+
+    stats.stored_chunks = this->pager->get_stored().size();
+    this->residency_stats = stats;
+}
 
-    return new_chunk.get();
+auto Scene::get_residency_stats() const -> ResidencyStats {
+    return this->residency_stats;
 }
 
 } // namespace vxng::scene
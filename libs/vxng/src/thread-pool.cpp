@@ -0,0 +1,125 @@
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace vxng {
+
+ThreadPool::ThreadPool(size_t worker_count) : stopping(false) {
+    if (worker_count == 0) {
+        size_t cores = std::thread::hardware_concurrency();
+        worker_count = std::max<size_t>(cores, 2) - 1;
+    }
+
+    for (size_t i = 0; i < worker_count; ++i) {
+        this->workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->tasks_mutex);
+        this->stopping = true;
+    }
+    this->tasks_cv.notify_all();
+
+    for (auto &worker : this->workers) {
+        worker.join();
+    }
+}
+
+auto ThreadPool::submit(std::function<void()> task) -> void {
+    {
+        std::lock_guard<std::mutex> lock(this->tasks_mutex);
+        this->tasks.push(std::move(task));
+    }
+    this->tasks_cv.notify_one();
+}
+
+auto ThreadPool::parallel_for(size_t count,
+                              const std::function<void(size_t)> &fn) -> void {
+    if (count == 0)
+        return;
+
+    // shared between helpers, which may outlive this call if they start late
+    struct Job {
+        std::atomic<size_t> next_index{0};
+        std::atomic<size_t> done_count{0};
+        std::atomic<bool> failed{false};
+        size_t count;
+        std::function<void(size_t)> fn;
+        std::exception_ptr error; // the first one thrown, under done_mutex
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+    };
+    auto job = std::make_shared<Job>();
+    job->count = count;
+    job->fn = fn;
+
+    auto run = [job]() {
+        size_t index;
+        while ((index = job->next_index.fetch_add(1)) < job->count) {
+            // once anything throws the rest are skipped, but still counted,
+            // so the caller only returns once no one is inside `fn`
+            if (!job->failed) {
+                try {
+                    job->fn(index);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(job->done_mutex);
+                    if (!job->error)
+                        job->error = std::current_exception();
+                    job->failed = true;
+                }
+            }
+            if (job->done_count.fetch_add(1) + 1 == job->count) {
+                std::lock_guard<std::mutex> lock(job->done_mutex);
+                job->done_cv.notify_all();
+            }
+        }
+    };
+
+    size_t helper_count = std::min(this->workers.size(), count - 1);
+    for (size_t i = 0; i < helper_count; ++i) {
+        submit(run);
+    }
+
+    // work on our own thread as well, then wait for stragglers
+    run();
+
+    std::unique_lock<std::mutex> lock(job->done_mutex);
+    job->done_cv.wait(lock, [&job]() { return job->done_count == job->count; });
+    if (job->error)
+        std::rethrow_exception(job->error);
+}
+
+auto ThreadPool::get_worker_count() const -> size_t {
+    return this->workers.size();
+}
+
+auto ThreadPool::get_shared() -> ThreadPool & {
+    static ThreadPool shared_pool;
+    return shared_pool;
+}
+
+auto ThreadPool::worker_loop() -> void {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(this->tasks_mutex);
+            this->tasks_cv.wait(lock, [this]() {
+                return this->stopping || !this->tasks.empty();
+            });
+
+            if (this->stopping && this->tasks.empty())
+                return;
+
+            task = std::move(this->tasks.front());
+            this->tasks.pop();
+        }
+        task();
+    }
+}
+
+} // namespace vxng
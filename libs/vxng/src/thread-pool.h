@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace vxng {
+
+/**
+ * Fixed set of worker threads pulling tasks off a shared queue. Used for
+ * CPU-heavy work (imports, octree building, CPU rendering) that we want
+ * spread across cores.
+ */
+class ThreadPool {
+  public:
+    /** @param worker_count  Defaults to one less than the core count */
+    ThreadPool(size_t worker_count = 0);
+    ~ThreadPool();
+
+    /**
+     * Runs a task on some worker, whenever one is free. Tasks mustn't throw,
+     * `parallel_for` is the way to get exceptions back.
+     */
+    auto submit(std::function<void()> task) -> void;
+
+    /**
+     * Runs `fn(i)` for every `i` in `[0, count)` across the pool, returning
+     * once all are done. The calling thread pitches in too, so this is safe to
+     * call from inside a pool task. If any `fn` throws, the rest are skipped
+     * and the first exception is rethrown here, once every `fn` that did
+     * start has returned.
+     */
+    auto parallel_for(size_t count, const std::function<void(size_t)> &fn)
+        -> void;
+
+    auto get_worker_count() const -> size_t;
+
+    /** Lazily created pool shared by the engine */
+    static auto get_shared() -> ThreadPool &;
+
+  private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex tasks_mutex;
+    std::condition_variable tasks_cv;
+    bool stopping;
+
+    auto worker_loop() -> void;
+};
+
+} // namespace vxng
@@ -9,6 +9,8 @@ struct Globals {
     lightDir: vec3<f32>,
     directionalLight: vec3<f32>,
     ambientLight: vec3<f32>,
+    viewportSize: vec2<f32>, // in pixels
+    lodThreshold: f32, // nodes smaller than this many pixels aren't entered
 }
 
 // Uniform buffer for camera settings
@@ -18,19 +20,55 @@ struct Camera {
     fovYRad: f32,
 }
 
+// packed down to 8 bytes, see GPUCompactNode
 struct OctreeNode {
-    childMask: u32,
-    firstChildIdx: u32,
-    voxelDataIdx: u32,
-}
-
-struct VoxelData {
-    colorPacked: u32,
+    header: u32,  // child mask in the low 8 bits, first child index above
+    payload: u32, // leaves: packed color. internal nodes: mask of children
+                  // that are filled leaves, in the top 8 bits, and the average
+                  // rgb of everything below in the rest
 }
 
 struct ChunkMetadata {
     position: vec3<f32>,
     size: f32,
+    gridResolution: u32, // cells per side of the distance grid, 0 if none
+    nodeBase: u32, // where its nodes start in octreeNodes
+    gridBase: u32, // where its grid starts in distanceGrid
+}
+
+// nodes are indexed from the start of the active chunk's
+fn loadNode(idx: u32) -> OctreeNode {
+    return octreeNodes[activeChunk.nodeBase + idx];
+}
+
+fn childMask(node: OctreeNode) -> u32 {
+    return node.header & 0xFFu;
+}
+
+fn firstChildIdx(node: OctreeNode) -> u32 {
+    return node.header >> 8u;
+}
+
+// children we know are opaque leaves without having to load them
+fn filledLeafMask(node: OctreeNode) -> u32 {
+    return node.payload >> 24u;
+}
+
+// what an internal node is drawn as when it's too small to enter
+fn lodColor(node: OctreeNode) -> u32 {
+    return (node.payload & 0xFFFFFFu) | 0xFF000000u;
+}
+
+// nodes smaller than this times their distance are drawn at their average
+// color rather than entered, 0 with LOD off
+fn lodScale() -> f32 {
+    let pixelAngle = 2.0 * tan(camera.fovYRad * 0.5) / globals.viewportSize.y;
+    return globals.lodThreshold * pixelAngle;
+}
+
+// a leaf's packed color
+fn leafColor(node: OctreeNode) -> u32 {
+    return node.payload;
 }
 
 struct Ray {
@@ -201,23 +239,29 @@ fn traverseOctree(ray: Ray, rootAABB: AABB) -> TraversalResult {
     let yStart = select(1u, 0u, ray.direction.y > 0.0);
     let zStart = select(1u, 0u, ray.direction.z > 0.0);
 
+    let lodSize = lodScale();
+
     // DFS traversal
     while (stackPtr >= 0) {
         let depth = stackPtr;
-        let node = octreeNodes[stack[depth].nodeIdx];
+        let node = loadNode(stack[depth].nodeIdx);
         var parentBounds: AABB;
         parentBounds.bounds_min = stack[depth].boundsMin;
         parentBounds.bounds_max = stack[depth].boundsMax;
 
         // we know leaf node if childMask == 0
-        if (node.childMask == 0u) {
+        let mask = childMask(node);
+        if (mask == 0u) {
+            let color = unpackColor(leafColor(node));
             let hit = raycastAABBWithNormal(ray, parentBounds);
-            if (hit.t >= 0.0 && hit.t < closestT) {
+            if (color.a != 0.0 && hit.t >= 0.0 && hit.t < closestT) {
                 closestT = hit.t;
                 closestNormal = hit.normal;
-                closestColor = unpackColor(
-                    voxelData[node.voxelDataIdx].colorPacked
-                );
+                closestColor = color;
+
+                // children are visited front to back, so nothing left on the
+                // stack can be any closer
+                break;
             }
             // Pop
             stackPtr -= 1;
@@ -225,7 +269,9 @@ fn traverseOctree(ray: Ray, rootAABB: AABB) -> TraversalResult {
         }
 
         // internal node: find next child octant to visit
+        let leafMask = filledLeafMask(node);
         var pushed = false;
+        var found = false;
         for (var i = stack[depth].nextOctant; i < 8u; i += 1u) {
             // Map iteration index to octant in front-to-back order
             var o = xStart | (yStart << 1u) | (zStart << 2u);
@@ -233,11 +279,32 @@ fn traverseOctree(ray: Ray, rootAABB: AABB) -> TraversalResult {
             if ((i & 2u) != 0u) { o ^= 2u; }
             if ((i & 4u) != 0u) { o ^= 4u; }
 
-            if ((node.childMask & (1u << o)) == 0u) {
+            if ((mask & (1u << o)) == 0u) {
                 continue;
             }
 
             let cBounds = childAABB(parentBounds, o);
+
+            // compute child's index in the contiguous array:
+            // firstChildIdx + number of set bits below bit o
+            let maskBelow = mask & ((1u << o) - 1u);
+            let childOffset = countOneBits(maskBelow);
+            let childIdx = firstChildIdx(node) + childOffset;
+
+            // opaque leaves are resolved right here, so the deepest level
+            // never gets pushed (or intersected twice)
+            if ((leafMask & (1u << o)) != 0u) {
+                let hit = raycastAABBWithNormal(ray, cBounds);
+                if (hit.t < 0.0 || hit.t >= closestT) {
+                    continue;
+                }
+                closestT = hit.t;
+                closestNormal = hit.normal;
+                closestColor = unpackColor(leafColor(loadNode(childIdx)));
+                found = true;
+                break;
+            }
+
             let t = raycastAABB(ray, cBounds);
 
             // skip any children that are behind the closest known hit
@@ -246,15 +313,23 @@ fn traverseOctree(ray: Ray, rootAABB: AABB) -> TraversalResult {
                 continue;
             }
 
+            // too small to make out from here, so it's drawn as one voxel
+            if (lodSize > 0.0) {
+                let child = loadNode(childIdx);
+                let childSize = cBounds.bounds_max.x - cBounds.bounds_min.x;
+                if (childMask(child) != 0u && childSize < lodSize * t) {
+                    let hit = raycastAABBWithNormal(ray, cBounds);
+                    closestT = hit.t;
+                    closestNormal = hit.normal;
+                    closestColor = unpackColor(lodColor(child));
+                    found = true;
+                    break;
+                }
+            }
+
             // record where parent should resume when we come back
             stack[depth].nextOctant = i + 1u;
 
-            // compute child's index in the contiguous array:
-            // firstChildIdx + number of set bits below bit o
-            let maskBelow = node.childMask & ((1u << o) - 1u);
-            let childOffset = countOneBits(maskBelow);
-            let childIdx = node.firstChildIdx + childOffset;
-
             // push child
             stackPtr += 1;
             stack[stackPtr].nodeIdx = childIdx;
@@ -265,6 +340,12 @@ fn traverseOctree(ray: Ray, rootAABB: AABB) -> TraversalResult {
             break;
         }
 
+        // children are visited front to back, so nothing left on the stack
+        // can be any closer
+        if (found) {
+            break;
+        }
+
         // no more children to visit, pop this node
         if (!pushed) {
             stackPtr -= 1;
@@ -278,11 +359,265 @@ fn traverseOctree(ray: Ray, rootAABB: AABB) -> TraversalResult {
     return result;
 }
 
+// max scale of the parametric caster, one per f32 mantissa bit
+const CAST_STACK_SIZE: u32 = 23u;
+const MAX_CAST_STEPS: u32 = 4096u;
+
+// result for a leaf hit by the parametric caster, `entry` being the t at which
+// the ray crosses each of the leaf's entry planes
+fn parametricHit(ray: Ray, entry: vec3<f32>, t: f32, colorPacked: u32) -> TraversalResult {
+    var result: TraversalResult;
+    result.color = unpackColor(colorPacked);
+    result.t = t;
+
+    // we came in through whichever plane we crossed last
+    let tEntry = max(max(entry.x, entry.y), entry.z);
+    if (entry.x == tEntry) {
+        result.normal = vec3<f32>(-sign(ray.direction.x), 0.0, 0.0);
+    } else if (entry.y == tEntry) {
+        result.normal = vec3<f32>(0.0, -sign(ray.direction.y), 0.0);
+    } else {
+        result.normal = vec3<f32>(0.0, 0.0, -sign(ray.direction.z));
+    }
+    return result;
+}
+
+// keep these in sync with DistanceGrid
+const MIN_SKIP_DISTANCE: u32 = 2u;
+const MAX_SKIP_STEPS: u32 = 64u;
+const SKIP_NUDGE: f32 = 1e-3;
+
+// a distance grid cell's chebyshev distance to the nearest occupied one, four
+// cells to a word
+fn gridDistance(cell: vec3<u32>) -> u32 {
+    let res = activeChunk.gridResolution;
+    let cellIdx = (cell.z * res + cell.y) * res + cell.x;
+    let word = distanceGrid[activeChunk.gridBase + (cellIdx >> 2u)];
+    return (word >> ((cellIdx & 3u) * 8u)) & 0xFFu;
+}
+
+// jumps the ray over boxes the distance grid knows are empty, returning the t
+// to start walking the octree from (tMax if there's nothing left to hit)
+fn skipEmptySpace(ray: Ray, rootAABB: AABB, tMin: f32, tMax: f32) -> f32 {
+    let res = activeChunk.gridResolution;
+    let cellSize = (rootAABB.bounds_max.x - rootAABB.bounds_min.x) / f32(res);
+
+    let minDirection = 1e-12;
+    let signedMin = select(vec3<f32>(minDirection), vec3<f32>(-minDirection), ray.direction < vec3<f32>(0.0));
+    let direction = select(ray.direction, signedMin, abs(ray.direction) < vec3<f32>(minDirection));
+    let invDir = 1.0 / direction;
+    let absDir = abs(direction);
+    let nudge = SKIP_NUDGE * cellSize / max(max(absDir.x, absDir.y), absDir.z);
+
+    var t = tMin;
+    for (var i = 0u; i < MAX_SKIP_STEPS && t < tMax; i += 1u) {
+        let p = (ray.origin + ray.direction * (t + nudge) - rootAABB.bounds_min) / cellSize;
+        let cell = clamp(vec3<i32>(floor(p)), vec3<i32>(0), vec3<i32>(i32(res) - 1));
+
+        // next to something, so the octree takes it from here
+        let cellDistance = gridDistance(vec3<u32>(cell));
+        if (cellDistance < MIN_SKIP_DISTANCE) {
+            return t;
+        }
+
+        // leave the box of cells within distance - 1 of this one
+        let reach = i32(cellDistance);
+        let boxMin = vec3<f32>(cell - vec3<i32>(reach - 1)) * cellSize + rootAABB.bounds_min;
+        let boxMax = vec3<f32>(cell + vec3<i32>(reach)) * cellSize + rootAABB.bounds_min;
+        let planes = select(boxMin, boxMax, direction > vec3<f32>(0.0));
+        let tFar = (planes - ray.origin) * invDir;
+        t = max(t, min(min(tFar.x, tFar.y), tFar.z));
+    }
+    return min(t, tMax);
+}
+
+// stackless-style parametric traversal, after laine & karras' "efficient sparse
+// voxel octrees". the chunk is mapped onto [1, 2]^3, so every child's position
+// and size is an exact float, and the ray is mirrored to run down every axis.
+// that makes each t-span a multiply-add off precomputed coefficients (no
+// divides, no bounds kept around), and popping back up finds the right level
+// straight from the position's bits. stops at the first opaque leaf, since
+// children are always stepped through front to back
+//
+// nothing can be hit before `tStart`, which the beam prepass tells us
+fn traverseOctreeParametric(ray: Ray, rootAABB: AABB, tStart: f32) -> TraversalResult {
+    var miss: TraversalResult;
+    miss.color = SKY_COLOR;
+    miss.normal = vec3<f32>(0.0);
+    miss.t = -1.0;
+
+    // same t as world space, just in chunk space
+    let size = rootAABB.bounds_max.x - rootAABB.bounds_min.x;
+    let p = (ray.origin - rootAABB.bounds_min) / size + vec3<f32>(1.0);
+    var d = ray.direction / size;
+
+    // keep axis-aligned rays from dividing by zero
+    let epsilon = exp2(-f32(CAST_STACK_SIZE));
+    let signedEpsilon = select(vec3<f32>(epsilon), vec3<f32>(-epsilon), d < vec3<f32>(0.0));
+    d = select(d, signedEpsilon, abs(d) < vec3<f32>(epsilon));
+
+    // t along each axis is `pos * coef - bias`, mirrored to a negative direction
+    let coef = 1.0 / -abs(d);
+    var bias = coef * p;
+    var octantMask = 0u;
+    if (d.x > 0.0) { octantMask ^= 1u; bias.x = 3.0 * coef.x - bias.x; }
+    if (d.y > 0.0) { octantMask ^= 2u; bias.y = 3.0 * coef.y - bias.y; }
+    if (d.z > 0.0) { octantMask ^= 4u; bias.z = 3.0 * coef.z - bias.z; }
+
+    let rootEntry = 2.0 * coef - bias;
+    var tMin = max(max(max(rootEntry.x, rootEntry.y), rootEntry.z), 0.0);
+    var tMax = min(min(coef.x - bias.x, coef.y - bias.y), coef.z - bias.z);
+    if (tMin >= tMax) {
+        return miss;
+    }
+
+    // the whole chunk may be a single leaf
+    var parentNode = loadNode(0u);
+    if (childMask(parentNode) == 0u) {
+        let colorPacked = leafColor(parentNode);
+        if ((colorPacked >> 24u) == 0u) {
+            return miss;
+        }
+        return parametricHit(ray, rootEntry, tMin, colorPacked);
+    }
+
+    tMin = max(tMin, tStart);
+    if (tMin >= tMax) {
+        return miss;
+    }
+
+    // then past whatever empty space the distance grid lets us skip
+    if (activeChunk.gridResolution != 0u) {
+        tMin = skipEmptySpace(ray, rootAABB, tMin, tMax);
+        if (tMin >= tMax) {
+            return miss;
+        }
+    }
+
+    // parents to come back to, indexed by scale
+    var stackNode: array<u32, CAST_STACK_SIZE>;
+    var stackTMax: array<f32, CAST_STACK_SIZE>;
+
+    var parent = 0u;
+    var idx = 0u; // child we're in, in mirrored space
+    var pos = vec3<f32>(1.0); // its (mirrored) min corner
+    var scale = CAST_STACK_SIZE - 1u;
+    var scaleExp2 = 0.5; // its size
+    var h = tMax; // skip pushing parents we'd never come back to
+    let lodSize = lodScale() / size; // in chunk space
+
+    let rootCenter = 1.5 * coef - bias;
+    if (rootCenter.x > tMin) { idx ^= 1u; pos.x = 1.5; }
+    if (rootCenter.y > tMin) { idx ^= 2u; pos.y = 1.5; }
+    if (rootCenter.z > tMin) { idx ^= 4u; pos.z = 1.5; }
+
+    for (var i = 0u; i < MAX_CAST_STEPS; i += 1u) {
+        // where we'd leave the current child
+        let corner = pos * coef - bias;
+        let tcMax = min(min(corner.x, corner.y), corner.z);
+        let octant = idx ^ octantMask;
+
+        let parentMask = childMask(parentNode);
+        if ((parentMask & (1u << octant)) != 0u && tMin <= tMax) {
+            let tvMax = min(tMax, tcMax);
+            if (tMin <= tvMax) {
+                let maskBelow = parentMask & ((1u << octant) - 1u);
+                let childIdx = firstChildIdx(parentNode) + countOneBits(maskBelow);
+                let child = loadNode(childIdx);
+
+                // the parent already knows if this is an opaque leaf, so
+                // there's no alpha to check
+                if ((filledLeafMask(parentNode) & (1u << octant)) != 0u) {
+                    return parametricHit(ray, (pos + scaleExp2) * coef - bias,
+                                         tMin, leafColor(child));
+                }
+
+                // any other leaf is empty
+                if (childMask(child) != 0u) {
+                    // too small to make out from here, so it's drawn as one
+                    // voxel
+                    if (scaleExp2 < lodSize * tMin) {
+                        return parametricHit(ray, (pos + scaleExp2) * coef - bias,
+                                             tMin, lodColor(child));
+                    }
+
+                    // descend, remembering the parent if we'll need it again
+                    if (tcMax < h) {
+                        stackNode[scale] = parent;
+                        stackTMax[scale] = tMax;
+                    }
+                    h = tcMax;
+
+                    let halfScale = scaleExp2 * 0.5;
+                    let center = halfScale * coef + corner;
+                    parent = childIdx;
+                    parentNode = child;
+                    idx = 0u;
+                    scale -= 1u;
+                    scaleExp2 = halfScale;
+                    if (center.x > tMin) { idx ^= 1u; pos.x += scaleExp2; }
+                    if (center.y > tMin) { idx ^= 2u; pos.y += scaleExp2; }
+                    if (center.z > tMin) { idx ^= 4u; pos.z += scaleExp2; }
+                    tMax = tvMax;
+                    continue;
+                }
+            }
+        }
+
+        // advance into the next sibling along the ray
+        var stepMask = 0u;
+        if (corner.x <= tcMax) { stepMask ^= 1u; pos.x -= scaleExp2; }
+        if (corner.y <= tcMax) { stepMask ^= 2u; pos.y -= scaleExp2; }
+        if (corner.z <= tcMax) { stepMask ^= 4u; pos.z -= scaleExp2; }
+        tMin = tcMax;
+        idx ^= stepMask;
+
+        // stepped out of the parent: pop up to the highest level whose
+        // position bits changed
+        if ((idx & stepMask) != 0u) {
+            var differingBits = 0u;
+            if ((stepMask & 1u) != 0u) { differingBits |= bitcast<u32>(pos.x) ^ bitcast<u32>(pos.x + scaleExp2); }
+            if ((stepMask & 2u) != 0u) { differingBits |= bitcast<u32>(pos.y) ^ bitcast<u32>(pos.y + scaleExp2); }
+            if ((stepMask & 4u) != 0u) { differingBits |= bitcast<u32>(pos.z) ^ bitcast<u32>(pos.z + scaleExp2); }
+
+            // no bit at all (0xFFFFFFFF) or past the root means we left the chunk
+            scale = firstLeadingBit(differingBits);
+            if (scale >= CAST_STACK_SIZE) {
+                return miss;
+            }
+            scaleExp2 = bitcast<f32>((scale + 127u - CAST_STACK_SIZE) << 23u);
+
+            parent = stackNode[scale];
+            parentNode = loadNode(parent);
+            tMax = stackTMax[scale];
+
+            let shx = bitcast<u32>(pos.x) >> scale;
+            let shy = bitcast<u32>(pos.y) >> scale;
+            let shz = bitcast<u32>(pos.z) >> scale;
+            pos = vec3<f32>(bitcast<f32>(shx << scale),
+                            bitcast<f32>(shy << scale),
+                            bitcast<f32>(shz << scale));
+            idx = (shx & 1u) | ((shy & 1u) << 1u) | ((shz & 1u) << 2u);
+            h = 0.0;
+        }
+    }
+
+    return miss;
+}
+
 @group(0) @binding(0) var<uniform> globals: Globals;
 @group(1) @binding(0) var<uniform> camera: Camera;
+// every chunk's nodes and grids share one buffer each, see GPUChunkPool
 @group(2) @binding(0) var<storage, read> octreeNodes: array<OctreeNode>;
-@group(2) @binding(1) var<storage, read> voxelData: array<VoxelData>;
-@group(2) @binding(2) var<uniform> chunkMetadata: ChunkMetadata;
+@group(2) @binding(1) var<uniform> chunkMetadata: ChunkMetadata;
+@group(2) @binding(2) var<storage, read> distanceGrid: array<u32>;
+// the chunk being traversed. the per-chunk entry points take it from
+// chunkMetadata, the single pass from the chunk grid
+var<private> activeChunk: ChunkMetadata;
+// depth written by the nearest chunks, drawn before everything else
+@group(3) @binding(0) var occluderDepth: texture_depth_2d;
+// per tile, the nearest anything could be hit at, see fs_beam
+@group(3) @binding(1) var beamDepth: texture_depth_2d;
 
 // Vertex shader output / Fragment shader input
 struct VertexOutput {
@@ -295,6 +630,15 @@ struct FragmentOutput {
     @builtin(frag_depth) depth: f32,
 }
 
+// which traversal kernel fs_main uses, set when the pipeline is created
+const TRAVERSAL_STACK: u32 = 0u;
+const TRAVERSAL_PARAMETRIC: u32 = 1u;
+override TRAVERSAL: u32 = TRAVERSAL_PARAMETRIC;
+// whether to test against occluderDepth before traversing anything
+override OCCLUSION_TEST: bool = false;
+// whether to start traversal where beamDepth says
+override BEAM_PREPASS: bool = false;
+
 // for depth mapping
 const NEAR_PLANE: f32 = 0.1;
 const FAR_PLANE: f32 = 10000.0;
@@ -330,13 +674,7 @@ const CUBE_INDICES = array<u32, 36>(
     3u, 7u, 6u,  3u, 6u, 2u,  // top   (+Y)
 );
 
-@vertex
-fn vs_main(@builtin(vertex_index) vertexIndex: u32) -> VertexOutput {
-    let cubePos = CUBE_POSITIONS[CUBE_INDICES[vertexIndex]];
-
-    // Transform unit cube [-0.5, 0.5]^3 to chunk world space
-    let worldPos = cubePos * chunkMetadata.size + chunkMetadata.position;
-
+fn worldToClip(worldPos: vec3<f32>) -> vec4<f32> {
     // View transform
     let viewPos = camera.viewMat * vec4<f32>(worldPos, 1.0);
 
@@ -344,21 +682,31 @@ fn vs_main(@builtin(vertex_index) vertexIndex: u32) -> VertexOutput {
     // WebGPU clip space: x,y in [-1,1], z in [0,1]
     let f = 1.0 / tan(camera.fovYRad * 0.5);
     let nf = NEAR_PLANE - FAR_PLANE;
-    let clipPos = vec4<f32>(
+    return vec4<f32>(
         viewPos.x * f / globals.aspectRatio,
         viewPos.y * f,
         viewPos.z * FAR_PLANE / nf + NEAR_PLANE * FAR_PLANE / nf,
         -viewPos.z
     );
+}
+
+@vertex
+fn vs_main(@builtin(vertex_index) vertexIndex: u32) -> VertexOutput {
+    let cubePos = CUBE_POSITIONS[CUBE_INDICES[vertexIndex]];
+
+    // Transform unit cube [-0.5, 0.5]^3 to chunk world space
+    let worldPos = cubePos * chunkMetadata.size + chunkMetadata.position;
 
     var output: VertexOutput;
-    output.position = clipPos;
+    output.position = worldToClip(worldPos);
     output.worldPos = worldPos;
     return output;
 }
 
 @fragment
 fn fs_main(input: VertexOutput) -> FragmentOutput {
+    activeChunk = chunkMetadata;
+
     // Build ray from camera through this fragment's world position
     let cameraPos = camera.invViewMat[3].xyz;
     var viewRay: Ray;
@@ -371,8 +719,36 @@ fn fs_main(input: VertexOutput) -> FragmentOutput {
     rootAABB.bounds_min = chunkMetadata.position - vec3<f32>(halfSize);
     rootAABB.bounds_max = chunkMetadata.position + vec3<f32>(halfSize);
 
+    // frag_depth turns off early depth testing, so do our own: the chunk's
+    // entry point is as close as anything inside it can be, so if that's
+    // already behind the occluders, so is whatever we'd hit
+    if (OCCLUSION_TEST) {
+        let entryT = raycastAABB(viewRay, rootAABB);
+        let occluder = textureLoad(occluderDepth, vec2<i32>(input.position.xy), 0);
+        if (entryT < 0.0 || (entryT > 0.0 && computeDepth(viewRay, entryT) >= occluder)) {
+            discard;
+        }
+    }
+
+    // the beam prepass already knows how far out the tile's first hit is
+    var tStart = 0.0;
+    if (BEAM_PREPASS) {
+        let tile = vec2<i32>(input.position.xy) / i32(BEAM_TILE_SIZE);
+        let tileDepth = textureLoad(beamDepth, tile, 0);
+        if (tileDepth >= 1.0) {
+            // nothing to hit anywhere in the tile
+            discard;
+        }
+        tStart = tileDepth * FAR_PLANE;
+    }
+
     // traverse octree!
-    let result = traverseOctree(viewRay, rootAABB);
+    var result: TraversalResult;
+    if (TRAVERSAL == TRAVERSAL_STACK) {
+        result = traverseOctree(viewRay, rootAABB);
+    } else {
+        result = traverseOctreeParametric(viewRay, rootAABB, tStart);
+    }
 
     var output: FragmentOutput;
     if (result.color.a == 0.0) {
@@ -390,6 +766,352 @@ fn fs_main(input: VertexOutput) -> FragmentOutput {
     }
     return output;
 }
+// --------- Beam prepass ---------
+
+// every BEAM_TILE_SIZE^2 block of pixels gets one beam, a cone around all its
+// pixels' rays. keep in sync with the renderer
+const BEAM_TILE_SIZE: u32 = 8u;
+// beams walking further than this settle for the chunk's own distance
+const MAX_BEAM_STEPS: u32 = 512u;
+// written depths are pulled in by this much, so rounding can't push them past
+// a real hit
+const BEAM_DEPTH_SLACK: f32 = 1e-4;
+
+struct BeamOutput {
+    @builtin(frag_depth) depth: f32,
+}
+
+// direction of the camera ray through a point on the screen, in pixels
+fn screenRayDirection(pixel: vec2<f32>) -> vec3<f32> {
+    let ndc = vec2<f32>(pixel.x / globals.viewportSize.x * 2.0 - 1.0,
+                        1.0 - pixel.y / globals.viewportSize.y * 2.0);
+    let tanHalfFov = tan(camera.fovYRad * 0.5);
+    let viewDir = vec3<f32>(ndc.x * globals.aspectRatio * tanHalfFov, ndc.y * tanHalfFov, -1.0);
+    return normalize((camera.invViewMat * vec4<f32>(viewDir, 0.0)).xyz);
+}
+
+// euclidean distance from a point to an AABB, 0 inside it. no ray from that
+// point can hit the AABB before this t
+fn distanceToAABB(p: vec3<f32>, aabb: AABB) -> f32 {
+    let outside = max(max(aabb.bounds_min - p, p - aabb.bounds_max), vec3<f32>(0.0));
+    return length(outside);
+}
+
+// how far a box grows for a beam: a ray within `spread` (the chord between
+// unit directions) of the beam's center ray strays at most `spread * t` from
+// it, and nothing in the box is further than this t
+fn beamMargin(aabb: AABB, origin: vec3<f32>, spread: f32) -> f32 {
+    let center = (aabb.bounds_min + aabb.bounds_max) * 0.5;
+    let halfDiagonal = length(aabb.bounds_max - center);
+    return spread * (length(center - origin) + halfDiagonal);
+}
+
+// the nearest t any ray in the beam could hit something in the chunk at, or
+// -1 if none can. walks the tree like traverseOctree does, but tests the
+// center ray against boxes grown to the beam, and keeps the closest candidate
+// instead of stopping at the first. nodes the beam is already wider than
+// count as hit without going any deeper
+fn traceBeam(ray: Ray, rootAABB: AABB, spread: f32) -> f32 {
+    let rootMargin = beamMargin(rootAABB, ray.origin, spread);
+    var grownRoot: AABB;
+    grownRoot.bounds_min = rootAABB.bounds_min - vec3<f32>(rootMargin);
+    grownRoot.bounds_max = rootAABB.bounds_max + vec3<f32>(rootMargin);
+    if (raycastAABB(ray, grownRoot) < 0.0) {
+        return -1.0;
+    }
+    let rootDistance = distanceToAABB(ray.origin, rootAABB);
+
+    var stack: array<StackEntry, 16>;
+    var stackPtr: i32 = 0;
+    stack[0].nodeIdx = 0u;
+    stack[0].boundsMin = rootAABB.bounds_min;
+    stack[0].boundsMax = rootAABB.bounds_max;
+    stack[0].nextOctant = 0u;
+
+    var closest: f32 = 1e30;
+    let lodSize = lodScale();
+
+    // front to back finds something close early, which prunes the rest
+    let xStart = select(1u, 0u, ray.direction.x > 0.0);
+    let yStart = select(1u, 0u, ray.direction.y > 0.0);
+    let zStart = select(1u, 0u, ray.direction.z > 0.0);
+
+    for (var steps = 0u; stackPtr >= 0; steps += 1u) {
+        if (steps >= MAX_BEAM_STEPS) {
+            return min(closest, rootDistance);
+        }
+
+        let depth = stackPtr;
+        let node = loadNode(stack[depth].nodeIdx);
+        var parentBounds: AABB;
+        parentBounds.bounds_min = stack[depth].boundsMin;
+        parentBounds.bounds_max = stack[depth].boundsMax;
+
+        // children never get pushed as leaves, so this is a single leaf root
+        let mask = childMask(node);
+        if (mask == 0u) {
+            if ((leafColor(node) >> 24u) != 0u) {
+                closest = min(closest, rootDistance);
+            }
+            stackPtr -= 1;
+            continue;
+        }
+
+        let leafMask = filledLeafMask(node);
+        var pushed = false;
+        for (var i = stack[depth].nextOctant; i < 8u; i += 1u) {
+            var o = xStart | (yStart << 1u) | (zStart << 2u);
+            if ((i & 1u) != 0u) { o ^= 1u; }
+            if ((i & 2u) != 0u) { o ^= 2u; }
+            if ((i & 4u) != 0u) { o ^= 4u; }
+
+            if ((mask & (1u << o)) == 0u) {
+                continue;
+            }
+
+            // nothing in here can beat what we've got
+            let cBounds = childAABB(parentBounds, o);
+            let nodeDistance = distanceToAABB(ray.origin, cBounds);
+            if (nodeDistance >= closest) {
+                continue;
+            }
+
+            // or no ray in the beam gets anywhere near it
+            let margin = beamMargin(cBounds, ray.origin, spread);
+            var grown: AABB;
+            grown.bounds_min = cBounds.bounds_min - vec3<f32>(margin);
+            grown.bounds_max = cBounds.bounds_max + vec3<f32>(margin);
+            if (raycastAABB(ray, grown) < 0.0) {
+                continue;
+            }
+
+            if ((leafMask & (1u << o)) != 0u) {
+                closest = nodeDistance;
+                continue;
+            }
+
+            let maskBelow = mask & ((1u << o) - 1u);
+            let childIdx = firstChildIdx(node) + countOneBits(maskBelow);
+            if (childMask(loadNode(childIdx)) == 0u) {
+                // empty leaf
+                continue;
+            }
+
+            // the beam's wider than the node, no point resolving it. the same
+            // goes for nodes small enough that some ray could draw them at
+            // LOD, which happens at their entry at the nearest
+            let size = cBounds.bounds_max.x - cBounds.bounds_min.x;
+            let reach = beamMargin(cBounds, ray.origin, max(spread, lodSize));
+            if (reach >= size || stackPtr + 1 >= i32(MAX_STACK_DEPTH)) {
+                closest = nodeDistance;
+                continue;
+            }
+
+            stack[depth].nextOctant = i + 1u;
+            stackPtr += 1;
+            stack[stackPtr].nodeIdx = childIdx;
+            stack[stackPtr].boundsMin = cBounds.bounds_min;
+            stack[stackPtr].boundsMax = cBounds.bounds_max;
+            stack[stackPtr].nextOctant = 0u;
+            pushed = true;
+            break;
+        }
+
+        if (!pushed) {
+            stackPtr -= 1;
+        }
+    }
+
+    return select(-1.0, closest, closest < 1e30);
+}
+
+// draws chunk cubes into a target with a pixel per tile. cubes are grown by
+// the widest any tile's beam gets (one through the middle of the screen), so
+// every tile whose beam touches the chunk gets a fragment
+@vertex
+fn vs_beam(@builtin(vertex_index) vertexIndex: u32) -> VertexOutput {
+    let cubePos = CUBE_POSITIONS[CUBE_INDICES[vertexIndex]];
+    let cameraPos = camera.invViewMat[3].xyz;
+
+    let pixelSize = 2.0 * tan(camera.fovYRad * 0.5) / globals.viewportSize.y;
+    let maxSpread = f32(BEAM_TILE_SIZE) * sqrt(2.0) * 0.5 * pixelSize;
+    let halfSize = chunkMetadata.size * 0.5;
+    var chunkAABB: AABB;
+    chunkAABB.bounds_min = chunkMetadata.position - vec3<f32>(halfSize);
+    chunkAABB.bounds_max = chunkMetadata.position + vec3<f32>(halfSize);
+    let margin = beamMargin(chunkAABB, cameraPos, maxSpread);
+    let worldPos = cubePos * (chunkMetadata.size + 2.0 * margin) + chunkMetadata.position;
+
+    // the target covers the screen in whole tiles, so it may hang over the
+    // right and bottom edges a little
+    var clipPos = worldToClip(worldPos);
+    let tiles = ceil(globals.viewportSize / f32(BEAM_TILE_SIZE));
+    let scale = globals.viewportSize / (tiles * f32(BEAM_TILE_SIZE));
+    clipPos.x = (clipPos.x + clipPos.w) * scale.x - clipPos.w;
+    clipPos.y = clipPos.w - (clipPos.w - clipPos.y) * scale.y;
+
+    var output: VertexOutput;
+    output.position = clipPos;
+    output.worldPos = worldPos;
+    return output;
+}
+
+// the nearest t anything in this chunk could be hit at by any pixel in the
+// tile, as depth. the depth test keeps the nearest over every chunk
+@fragment
+fn fs_beam(input: VertexOutput) -> BeamOutput {
+    activeChunk = chunkMetadata;
+
+    let tileMin = floor(input.position.xy) * f32(BEAM_TILE_SIZE);
+    let tileMax = tileMin + vec2<f32>(f32(BEAM_TILE_SIZE));
+
+    var beamRay: Ray;
+    beamRay.origin = camera.invViewMat[3].xyz;
+    beamRay.direction = screenRayDirection((tileMin + tileMax) * 0.5);
+
+    // every pixel's ray is within the corners' rays
+    var spread = length(screenRayDirection(tileMin) - beamRay.direction);
+    spread = max(spread, length(screenRayDirection(tileMax) - beamRay.direction));
+    spread = max(spread, length(screenRayDirection(vec2<f32>(tileMin.x, tileMax.y)) - beamRay.direction));
+    spread = max(spread, length(screenRayDirection(vec2<f32>(tileMax.x, tileMin.y)) - beamRay.direction));
+
+    let halfSize = chunkMetadata.size * 0.5;
+    var rootAABB: AABB;
+    rootAABB.bounds_min = chunkMetadata.position - vec3<f32>(halfSize);
+    rootAABB.bounds_max = chunkMetadata.position + vec3<f32>(halfSize);
+
+    let t = traceBeam(beamRay, rootAABB, spread);
+    if (t < 0.0) {
+        discard;
+    }
+
+    var output: BeamOutput;
+    output.depth = clamp(t * (1.0 - BEAM_DEPTH_SLACK) / FAR_PLANE, 0.0, 1.0);
+    return output;
+}
+
+// --------- Single pass ---------
+
+struct ChunkGridInfo {
+    origin: vec3<f32>, // min corner of the grid
+    cellSize: f32, // which is also the chunk size
+    dims: vec3<u32>,
+}
+
+// with the single pass, group 2 is the chunk pool's buffers plus the grid
+// index + 1 into sceneChunks of the chunk in each cell, 0 if empty
+@group(2) @binding(3) var<storage, read> chunkCells: array<u32>;
+@group(2) @binding(4) var<storage, read> sceneChunks: array<ChunkMetadata>;
+@group(2) @binding(5) var<uniform> chunkGrid: ChunkGridInfo;
+
+// walks the ray through the chunk grid a cell at a time (amanatides & woo),
+// traversing each chunk it passes through. cells are visited front to back,
+// so the first hit is the nearest
+fn traverseScene(ray: Ray) -> TraversalResult {
+    var miss: TraversalResult;
+    miss.color = SKY_COLOR;
+    miss.normal = vec3<f32>(0.0);
+    miss.t = -1.0;
+
+    let dims = vec3<i32>(chunkGrid.dims);
+    var gridAABB: AABB;
+    gridAABB.bounds_min = chunkGrid.origin;
+    gridAABB.bounds_max = chunkGrid.origin + vec3<f32>(chunkGrid.dims) * chunkGrid.cellSize;
+    let tEntry = raycastAABB(ray, gridAABB);
+    if (tEntry < 0.0) {
+        return miss;
+    }
+
+    // keep axis-aligned rays from dividing by zero
+    let minDirection = 1e-12;
+    let signedMin = select(vec3<f32>(minDirection), vec3<f32>(-minDirection), ray.direction < vec3<f32>(0.0));
+    let direction = select(ray.direction, signedMin, abs(ray.direction) < vec3<f32>(minDirection));
+    let invDir = 1.0 / direction;
+
+    let entry = (ray.origin + ray.direction * tEntry - chunkGrid.origin) / chunkGrid.cellSize;
+    var cell = clamp(vec3<i32>(floor(entry)), vec3<i32>(0), dims - vec3<i32>(1));
+    let cellStep = select(vec3<i32>(-1), vec3<i32>(1), direction > vec3<f32>(0.0));
+
+    // t at the next cell boundary along each axis, and between boundaries
+    let tDelta = abs(invDir) * chunkGrid.cellSize;
+    let nextPlanes = vec3<f32>(cell + max(cellStep, vec3<i32>(0))) * chunkGrid.cellSize + chunkGrid.origin;
+    var tNext = (nextPlanes - ray.origin) * invDir;
+
+    let maxSteps = dims.x + dims.y + dims.z;
+    for (var i = 0; i < maxSteps; i += 1) {
+        let cellIdx = (u32(cell.z) * chunkGrid.dims.y + u32(cell.y)) * chunkGrid.dims.x + u32(cell.x);
+        let chunkIdx = chunkCells[cellIdx];
+        if (chunkIdx != 0u) {
+            activeChunk = sceneChunks[chunkIdx - 1u];
+
+            let halfSize = activeChunk.size * 0.5;
+            var rootAABB: AABB;
+            rootAABB.bounds_min = activeChunk.position - vec3<f32>(halfSize);
+            rootAABB.bounds_max = activeChunk.position + vec3<f32>(halfSize);
+
+            var result: TraversalResult;
+            if (TRAVERSAL == TRAVERSAL_STACK) {
+                result = traverseOctree(ray, rootAABB);
+            } else {
+                result = traverseOctreeParametric(ray, rootAABB, 0.0);
+            }
+            if (result.color.a != 0.0) {
+                return result;
+            }
+        }
+
+        // on to whichever neighbor the ray crosses into first
+        if (tNext.x < tNext.y && tNext.x < tNext.z) {
+            cell.x += cellStep.x;
+            tNext.x += tDelta.x;
+        } else if (tNext.y < tNext.z) {
+            cell.y += cellStep.y;
+            tNext.y += tDelta.y;
+        } else {
+            cell.z += cellStep.z;
+            tNext.z += tDelta.z;
+        }
+        if (any(cell < vec3<i32>(0)) || any(cell >= dims)) {
+            break;
+        }
+    }
+
+    return miss;
+}
+
+struct SceneVertexOutput {
+    @builtin(position) position: vec4<f32>,
+}
+
+// one triangle covering the whole screen
+@vertex
+fn vs_scene(@builtin(vertex_index) vertexIndex: u32) -> SceneVertexOutput {
+    let uv = vec2<f32>(f32((vertexIndex << 1u) & 2u), f32(vertexIndex & 2u));
+
+    var output: SceneVertexOutput;
+    output.position = vec4<f32>(uv * 2.0 - 1.0, 0.0, 1.0);
+    return output;
+}
+
+// the whole scene in one go, no depth needed since nothing else is drawn
+@fragment
+fn fs_scene(input: SceneVertexOutput) -> @location(0) vec4<f32> {
+    var viewRay: Ray;
+    viewRay.origin = camera.invViewMat[3].xyz;
+    viewRay.direction = screenRayDirection(input.position.xy);
+
+    let result = traverseScene(viewRay);
+    if (result.color.a == 0.0) {
+        // the clear color shows through
+        discard;
+    }
+
+    // same half lambert as fs_main
+    let lightDir = normalize(globals.lightDir);
+    let diffuse = max(dot(result.normal, lightDir) * 0.5 + 0.5, 0.0) * globals.directionalLight;
+    let lighting = globals.ambientLight + diffuse;
+    return vec4<f32>(result.color.rgb * lighting, result.color.a);
+}
 )wgsl";
 
 } // namespace vxng::shaders
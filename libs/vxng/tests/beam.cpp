@@ -0,0 +1,148 @@
+#include "scene/chunk.h"
+#include "scene/octree-cast.h"
+#include "test-scene.h"
+#include "vxng/geometry.h"
+#include "vxng/orbit-camera.h"
+#include "vxng/scene.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#define IMAGE_WIDTH 192
+#define IMAGE_HEIGHT 128
+// same as the shader's
+#define BEAM_TILE_SIZE 8
+#define BEAM_DEPTH_SLACK 1e-4f
+#define LOD_THRESHOLD 2.f
+
+using namespace vxng;
+
+// checks that the beam prepass never starts a pixel past its own hit: for
+// every 8x8 tile and chunk, the beam's t (pulled in like the shader writes it)
+// is at most the t of every hit in the tile, and chunks the beam misses get
+// no hits at all. views from outside and inside the scene, with LOD on and off
+auto main() -> int {
+    scene::Scene scene(64, 4.f);
+    tests::fill_random_scene(scene, 7);
+
+    typedef struct PackedChunk {
+        geometry::AABB bounds;
+        std::vector<scene::GPUCompactNode> nodes;
+    } PackedChunk;
+    std::vector<PackedChunk> chunks;
+    for (auto &[coord, chunk] : scene.get_chunks())
+        chunks.push_back({chunk->get_bounds(), chunk->pack_nodes()});
+
+    typedef struct View {
+        const char *name;
+        glm::vec3 origin;
+        glm::vec3 angle_euler_yxz;
+    } View;
+    const View views[] = {
+        {"outside", glm::vec3(0.3f, 0.2f, 20.f), glm::vec3(0.f)},
+        {"outside, close", glm::vec3(1.3f, 0.7f, 6.f),
+         glm::vec3(0.3f, 0.2f, 0.f)},
+        {"inside", glm::vec3(0.3f, 0.2f, 0.1f), glm::vec3(0.f)},
+        {"inside, turned", glm::vec3(-3.1f, 1.3f, -1.2f),
+         glm::vec3(-0.4f, 2.3f, 0.f)},
+    };
+
+    int failures = 0;
+    for (const View &view : views) {
+        // orbiting a point one unit ahead puts the camera at `origin`
+        camera::OrbitCamera facing(glm::vec3(0.f), view.angle_euler_yxz, 1.f,
+                                   0.9f);
+        camera::OrbitCamera camera(view.origin + facing.get_forward(),
+                                   view.angle_euler_yxz, 1.f, 0.9f);
+        camera.set_aspect_ratio(float(IMAGE_WIDTH) / IMAGE_HEIGHT);
+
+        // like the shader's `screenRayDirection`, in pixels
+        auto pixel_ray = [&camera](float x, float y) {
+            glm::vec2 ndc(x / IMAGE_WIDTH * 2.f - 1.f,
+                          1.f - y / IMAGE_HEIGHT * 2.f);
+            return camera.screen_to_ray(ndc);
+        };
+
+        for (float lod_threshold : {0.f, LOD_THRESHOLD}) {
+            float pixel_angle =
+                2.f * std::tan(camera.get_fovy() * 0.5f) / IMAGE_HEIGHT;
+            float lod_scale = lod_threshold * pixel_angle;
+
+            int hits = 0, beams = 0, violations = 0;
+            double start_sum = 0.0, hit_sum = 0.0;
+            for (int y0 = 0; y0 < IMAGE_HEIGHT; y0 += BEAM_TILE_SIZE) {
+                for (int x0 = 0; x0 < IMAGE_WIDTH; x0 += BEAM_TILE_SIZE) {
+                    // as in `fs_beam`: a ray through the middle of the tile,
+                    // spread out to reach its corners
+                    float x1 = x0 + BEAM_TILE_SIZE, y1 = y0 + BEAM_TILE_SIZE;
+                    geometry::Ray beam =
+                        pixel_ray((x0 + x1) * 0.5f, (y0 + y1) * 0.5f);
+                    float spread = 0.f;
+                    for (glm::vec2 corner : {glm::vec2(x0, y0),
+                                             glm::vec2(x1, y0),
+                                             glm::vec2(x0, y1),
+                                             glm::vec2(x1, y1)}) {
+                        glm::vec3 direction =
+                            pixel_ray(corner.x, corner.y).direction;
+                        spread = std::max(
+                            spread, glm::length(direction - beam.direction));
+                    }
+
+                    for (const PackedChunk &chunk : chunks) {
+                        float beam_t = scene::trace_beam_flat(
+                            chunk.nodes.data(), chunk.bounds, beam, spread,
+                            lod_scale);
+                        beams += beam_t >= 0.f;
+                        float start = beam_t * (1.f - BEAM_DEPTH_SLACK);
+
+                        for (int y = y0; y < y1; ++y) {
+                            for (int x = x0; x < x1; ++x) {
+                                geometry::Ray ray =
+                                    pixel_ray(x + 0.5f, y + 0.5f);
+                                auto hit = scene::raycast_flat(
+                                    chunk.nodes.data(), chunk.bounds, ray,
+                                    nullptr, lod_scale);
+                                if (!hit.hit)
+                                    continue;
+
+                                hits++;
+                                start_sum += std::max(start, 0.f);
+                                hit_sum += hit.t;
+                                if (beam_t >= 0.f && start <= hit.t)
+                                    continue;
+
+                                if (++violations <= 4) {
+                                    std::cerr
+                                        << view.name << ": pixel " << x
+                                        << ", " << y << " hits at " << hit.t
+                                        << ", but its beam starts at "
+                                        << beam_t << std::endl;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            // how much of each hit's ray the beam let it skip
+            std::cout << view.name << (lod_threshold > 0.f ? " (LOD)" : "")
+                      << ": " << hits << " hits, " << beams << " beams, "
+                      << violations << " started past their hit, "
+                      << (hit_sum > 0.0 ? start_sum / hit_sum : 0.0) * 100.0
+                      << "% skipped" << std::endl;
+            if (hits == 0) {
+                std::cerr << view.name << ": should hit something"
+                          << std::endl;
+                failures++;
+            }
+            failures += violations;
+        }
+    }
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
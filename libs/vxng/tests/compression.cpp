@@ -0,0 +1,137 @@
+#include "scene/chunk.h"
+#include "test-scene.h"
+#include "vxng/scene.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+// scene is 64 voxels per chunk side, so this is every voxel there is
+#define SAMPLE_DEPTH 6
+
+using namespace vxng;
+
+typedef std::vector<std::optional<glm::u8vec4>> Snapshot;
+
+// every finest voxel of every chunk in `coords`, in order
+auto take_snapshot(const scene::Scene &scene,
+                   const std::vector<glm::ivec3> &coords) -> Snapshot {
+    float scale = scene.get_chunk_scale();
+    int side = 1 << SAMPLE_DEPTH;
+    float voxel_size = scale / side;
+
+    Snapshot snapshot;
+    snapshot.reserve(coords.size() * side * side * side);
+    for (glm::ivec3 coord : coords) {
+        glm::vec3 low = glm::vec3(coord) * scale - scale * 0.5f;
+        for (int z = 0; z < side; ++z) {
+            for (int y = 0; y < side; ++y) {
+                for (int x = 0; x < side; ++x) {
+                    glm::vec3 position =
+                        low + (glm::vec3(x, y, z) + 0.5f) * voxel_size;
+                    snapshot.push_back(scene.sample_position(position));
+                }
+            }
+        }
+    }
+    return snapshot;
+}
+
+auto count_differences(const Snapshot &expected, const Snapshot &actual)
+    -> size_t {
+    size_t differences = 0;
+    for (size_t i = 0; i < expected.size(); ++i)
+        differences += expected[i] != actual[i];
+    return differences;
+}
+
+auto cpu_memory_usage(const scene::Scene &scene) -> size_t {
+    size_t bytes = 0;
+    for (const auto &[coord, chunk] : scene.get_chunks())
+        bytes += chunk->get_cpu_memory_usage();
+    return bytes;
+}
+
+// checks `compress_chunks` keeps every voxel as it was: right after
+// compressing, after compressing the DAGs again, after saving and loading the
+// compressed scene, and after editing it (thawing some chunks) alongside an
+// uncompressed copy given the same edits
+auto main() -> int {
+    scene::Scene scene(64, 4.f);
+    tests::fill_random_scene(scene, 6);
+    scene::Scene reference(64, 4.f);
+    tests::fill_random_scene(reference, 6);
+
+    std::vector<glm::ivec3> coords;
+    for (const auto &[coord, chunk] : scene.get_chunks())
+        coords.push_back(coord);
+    std::sort(coords.begin(), coords.end(), [](glm::ivec3 a, glm::ivec3 b) {
+        if (a.x != b.x)
+            return a.x < b.x;
+        if (a.y != b.y)
+            return a.y < b.y;
+        return a.z < b.z;
+    });
+    const Snapshot original = take_snapshot(scene, coords);
+
+    int failures = 0;
+    auto check = [&](const char *stage, const scene::Scene &actual,
+                     const Snapshot &expected) {
+        size_t differences =
+            count_differences(expected, take_snapshot(actual, coords));
+        std::cout << stage << ": " << differences << " voxels differ"
+                  << std::endl;
+        failures += differences != 0;
+    };
+
+    size_t uncompressed_bytes = cpu_memory_usage(scene);
+    scene.compress_chunks();
+    size_t frozen = 0;
+    for (const auto &[coord, chunk] : scene.get_chunks())
+        frozen += chunk->is_frozen();
+    std::cout << frozen << " of " << coords.size() << " chunks compressed, "
+              << uncompressed_bytes << " bytes down to "
+              << cpu_memory_usage(scene) << std::endl;
+    if (frozen != coords.size()) {
+        std::cerr << "Every chunk should be compressed" << std::endl;
+        failures++;
+    }
+    check("compressed", scene, original);
+
+    // frozen chunks get re-encoded from their own arrays
+    scene.compress_chunks();
+    check("compressed twice", scene, original);
+
+    // the DAG's shared subtrees have to survive the trip through the file
+    std::string path =
+        (std::filesystem::temp_directory_path() / "vxng-test-dag.vxng")
+            .string();
+    scene::Scene loaded(64, 4.f);
+    if (!scene.save_file(path) || !loaded.load_file(path)) {
+        std::cerr << "Couldn't save and load the compressed scene"
+                  << std::endl;
+        failures++;
+    } else {
+        check("saved and loaded", loaded, original);
+    }
+    std::filesystem::remove(path);
+
+    // edits to a shared subtree must only land where they're made, and chunks
+    // thawing back into trees keep what they held
+    const glm::u8vec4 color(10, 200, 30, 255);
+    for (scene::Scene *target : {&scene, &reference}) {
+        target->set_voxel_filled(3, glm::vec3(1.1f, 0.3f, -0.4f), color);
+        target->set_voxel_empty(4, glm::vec3(-2.f, 0.1f, 0.1f));
+        target->set_voxel_filled(6, glm::vec3(5.9f, -3.8f, 1.7f), color);
+        target->set_voxel_empty(6, glm::vec3(-7.3f, 4.4f, -2.9f));
+    }
+    check("edited", scene, take_snapshot(reference, coords));
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
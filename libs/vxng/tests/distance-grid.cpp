@@ -0,0 +1,133 @@
+#include "scene/chunk.h"
+#include "scene/distance-grid.h"
+#include "scene/octree-view.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#define CHUNK_RESOLUTION 64
+#define EDITS_PER_CASE 80
+
+using namespace vxng;
+
+// compares the chunk's patched grid against one built from scratch over the
+// same arrays, cell for cell
+auto matches_full_build(scene::Chunk &chunk, int resolution) -> bool {
+    const scene::DistanceGrid *grid = chunk.get_distance_grid();
+    scene::Chunk::SerializedOctree data = chunk.serialize();
+    scene::DistanceGrid full;
+    full.build(scene::FlatView{data.octree_nodes, data.voxel_datas},
+               resolution);
+    return grid->get_distances() == full.get_distances();
+}
+
+// checks `DistanceGrid::update` against `build` after every edit, for edits
+// whose effect reaches far past the cells they touch (so the window has to
+// grow, sometimes over the whole grid), edits against the chunk's faces, and
+// region edits dirtying many cells at once
+auto main() -> int {
+    typedef struct Case {
+        const char *name;
+        std::function<void(scene::Chunk &, std::mt19937 &)> edit;
+    } Case;
+
+    std::uniform_real_distribution<float> unit(-0.5f, 0.499f);
+    glm::u8vec4 color(200, 100, 20, 255);
+    const Case cases[] = {
+        // a voxel or two in an otherwise empty chunk, so every distance
+        // depends on them and each edit moves the nearest one a long way
+        {"lone voxels",
+         [&](scene::Chunk &chunk, std::mt19937 &rng) {
+             glm::vec3 position(unit(rng), unit(rng), unit(rng));
+             if (rng() % 2) {
+                 chunk.set_voxel_filled(6, position, color, true);
+             } else {
+                 // empty the whole chunk but one voxel
+                 chunk.set_voxel_empty(0, glm::vec3(0.f), true);
+                 chunk.set_voxel_filled(6, position, color, true);
+             }
+         }},
+        // clusters with wide gaps, edited in the gaps and at their edges
+        {"sparse clusters",
+         [&](scene::Chunk &chunk, std::mt19937 &rng) {
+             glm::vec3 cluster(rng() % 2 ? -0.3f : 0.3f, 0.f,
+                               rng() % 2 ? -0.3f : 0.3f);
+             glm::vec3 position =
+                 cluster + glm::vec3(unit(rng), unit(rng), unit(rng)) * 0.3f;
+             int depth = 4 + rng() % 3;
+             if (rng() % 3)
+                 chunk.set_voxel_filled(depth, position, color, true);
+             else
+                 chunk.set_voxel_empty(depth, position, true);
+         }},
+        // voxels on the chunk's faces, edges and corners
+        {"faces",
+         [&](scene::Chunk &chunk, std::mt19937 &rng) {
+             glm::vec3 position(unit(rng), unit(rng), unit(rng));
+             for (int axis = 0; axis < 3; ++axis) {
+                 if (rng() % 2)
+                     position[axis] = rng() % 2 ? -0.5f : 0.499f;
+             }
+             int depth = 3 + rng() % 4;
+             if (rng() % 2)
+                 chunk.set_voxel_filled(depth, position, color, true);
+             else
+                 chunk.set_voxel_empty(depth, position, true);
+         }},
+        // blobs of voxels at once, dirtying a box of cells
+        {"regions",
+         [&](scene::Chunk &chunk, std::mt19937 &rng) {
+             int depth = 5 + rng() % 2;
+             int side = 1 << depth;
+             glm::ivec3 center(rng() % side, rng() % side, rng() % side);
+             int reach = 1 + rng() % 4;
+             std::vector<glm::ivec3> voxels;
+             for (int x = -reach; x <= reach; ++x) {
+                 for (int y = -reach; y <= reach; ++y) {
+                     for (int z = -reach; z <= reach; ++z) {
+                         glm::ivec3 voxel = center + glm::ivec3(x, y, z);
+                         if (glm::all(glm::greaterThanEqual(
+                                 voxel, glm::ivec3(0))) &&
+                             glm::all(glm::lessThan(voxel, glm::ivec3(side))))
+                             voxels.push_back(voxel);
+                     }
+                 }
+             }
+             auto operation = rng() % 3 ? scene::RegionEdit::OPERATION_FILL
+                                        : scene::RegionEdit::OPERATION_ERASE;
+             chunk.apply_region(depth, voxels, operation, color, true);
+         }},
+    };
+
+    int failures = 0;
+    for (const Case &test_case : cases) {
+        for (int resolution : {8, 32}) {
+            std::mt19937 rng(resolution);
+            scene::Chunk chunk(glm::vec3(0.f), 1.f, CHUNK_RESOLUTION);
+            chunk.set_distance_grid_resolution(resolution);
+            chunk.get_distance_grid();
+
+            int mismatches = 0;
+            for (int i = 0; i < EDITS_PER_CASE; ++i) {
+                test_case.edit(chunk, rng);
+                if (!matches_full_build(chunk, resolution) &&
+                    ++mismatches <= 4) {
+                    std::cerr << test_case.name << " at " << resolution
+                              << ": grid differs after edit " << i
+                              << std::endl;
+                }
+            }
+
+            std::cout << test_case.name << " at " << resolution << ": "
+                      << mismatches << " mismatched" << std::endl;
+            failures += mismatches;
+        }
+    }
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,241 @@
+#include "test-scene.h"
+#include "vxng/scene.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+// scene is 64 voxels per chunk side, so this is every voxel there is
+#define SAMPLE_DEPTH 6
+
+using namespace vxng;
+
+typedef struct CoordLess {
+    auto operator()(glm::ivec3 a, glm::ivec3 b) const -> bool {
+        if (a.x != b.x)
+            return a.x < b.x;
+        if (a.y != b.y)
+            return a.y < b.y;
+        return a.z < b.z;
+    }
+} CoordLess;
+
+typedef std::map<glm::ivec3, std::vector<uint64_t>, CoordLess> Snapshot;
+
+// every finest voxel of every chunk a record touches, which is all that
+// editing or swapping it can change. empty voxels are 0, filled ones have
+// bit 32 set over their packed color
+auto take_snapshot(const scene::Scene &scene,
+                   const scene::EditRecord &record) -> Snapshot {
+    float scale = scene.get_chunk_scale();
+    int side = 1 << SAMPLE_DEPTH;
+    float voxel_size = scale / side;
+
+    Snapshot snapshot;
+    for (const auto &cells : record.chunks) {
+        auto [entry, added] = snapshot.try_emplace(cells.chunk_coord);
+        if (!added)
+            continue;
+
+        glm::vec3 low = glm::vec3(cells.chunk_coord) * scale - scale * 0.5f;
+        std::vector<uint64_t> &voxels = entry->second;
+        voxels.reserve(static_cast<size_t>(side) * side * side);
+        for (int z = 0; z < side; ++z) {
+            for (int y = 0; y < side; ++y) {
+                for (int x = 0; x < side; ++x) {
+                    glm::vec3 position =
+                        low + (glm::vec3(x, y, z) + 0.5f) * voxel_size;
+                    auto color = scene.sample_position(position);
+                    uint64_t packed = 0;
+                    if (color) {
+                        packed = 1ull << 32 | color->r | color->g << 8 |
+                                 color->b << 16 |
+                                 static_cast<uint32_t>(color->a) << 24;
+                    }
+                    voxels.push_back(packed);
+                }
+            }
+        }
+    }
+    return snapshot;
+}
+
+auto count_differences(const Snapshot &expected, const Snapshot &actual)
+    -> size_t {
+    size_t differences = 0;
+    for (const auto &[coord, voxels] : expected) {
+        auto found = actual.find(coord);
+        if (found == actual.end()) {
+            differences += voxels.size();
+            continue;
+        }
+        for (size_t i = 0; i < voxels.size(); ++i)
+            differences += voxels[i] != found->second[i];
+    }
+    return differences;
+}
+
+// swaps the record into the scene twice, expecting it back at `before` then
+// at `after` each time
+auto check_round_trips(const char *name, scene::Scene &scene,
+                       scene::EditRecord &record, const Snapshot &before,
+                       const Snapshot &after) -> bool {
+    bool ok = true;
+    if (count_differences(before, after) == 0) {
+        std::cerr << name << ": the edits didn't change anything" << std::endl;
+        ok = false;
+    }
+
+    for (int round = 0; round < 2; ++round) {
+        scene.swap_edit_record(record);
+        size_t undone = count_differences(before, take_snapshot(scene, record));
+        scene.swap_edit_record(record);
+        size_t redone = count_differences(after, take_snapshot(scene, record));
+
+        std::cout << name << ", round " << round << ": " << undone
+                  << " voxels off after undo, " << redone
+                  << " after redo" << std::endl;
+        ok = ok && undone == 0 && redone == 0;
+    }
+    return ok;
+}
+
+// applies a stroke to `scene`, recording it, and to `reference`, which is
+// kept in step without records, then checks undo and redo against both
+auto check_stroke(const char *name, scene::Scene &scene,
+                  scene::Scene &reference,
+                  const std::vector<scene::RegionEdit> &edits,
+                  scene::EditRecord &record) -> bool {
+    for (const scene::RegionEdit &edit : edits)
+        scene.apply_region_edit(edit, &record);
+    Snapshot before = take_snapshot(reference, record);
+    for (const scene::RegionEdit &edit : edits)
+        reference.apply_region_edit(edit);
+    Snapshot after = take_snapshot(reference, record);
+
+    size_t applied = count_differences(after, take_snapshot(scene, record));
+    if (applied != 0) {
+        std::cerr << name << ": " << applied
+                  << " voxels differ from applying it unrecorded" << std::endl;
+        return false;
+    }
+    return check_round_trips(name, scene, record, before, after);
+}
+
+// checks that swapping edit records restores every voxel the edits touched,
+// for a stroke crossing chunk corners and one writing the same cells more
+// than once, at one depth and at several
+auto main() -> int {
+    scene::Scene scene(64, 4.f);
+    scene::Scene reference(64, 4.f);
+    tests::fill_random_scene(scene, 11);
+    tests::fill_random_scene(reference, 11);
+    bool ok = true;
+
+    // a fill centered on the corner shared by eight chunks
+    scene::EditRecord corner_record;
+    {
+        scene::RegionEdit fill;
+        fill.shape = scene::RegionEdit::SHAPE_SPHERE;
+        fill.operation = scene::RegionEdit::OPERATION_FILL;
+        fill.depth = 5;
+        fill.center = glm::vec3(2.f, 2.f, 2.f);
+        fill.color = glm::u8vec4(250, 10, 10, 255);
+        fill.radius = 9.5f;
+
+        ok = check_stroke("corner", scene, reference, {fill}, corner_record) &&
+             ok;
+        if (corner_record.chunks.size() < 8) {
+            std::cerr << "corner: recorded " << corner_record.chunks.size()
+                      << " chunks, expected at least 8" << std::endl;
+            ok = false;
+        }
+    }
+
+    // one stroke dabbing over the same spot: an erase, then a paint and a
+    // fill at the same depth over cells it already captured, then coarser
+    // fills swallowing all of them, finer spans inside those, and the first
+    // erase again
+    scene::EditRecord stroke_record;
+    {
+        std::vector<scene::RegionEdit> edits;
+
+        scene::RegionEdit erase;
+        erase.shape = scene::RegionEdit::SHAPE_BOX;
+        erase.operation = scene::RegionEdit::OPERATION_ERASE;
+        erase.depth = 5;
+        erase.center = glm::vec3(-1.9f, 0.3f, 0.4f);
+        erase.half_size = glm::ivec3(4, 3, 2);
+        edits.push_back(erase);
+
+        scene::RegionEdit paint = erase;
+        paint.shape = scene::RegionEdit::SHAPE_SPHERE;
+        paint.operation = scene::RegionEdit::OPERATION_PAINT;
+        paint.center += glm::vec3(0.2f, 0.f, 0.f);
+        paint.color = glm::u8vec4(10, 250, 10, 255);
+        paint.radius = 6.f;
+        edits.push_back(paint);
+
+        scene::RegionEdit fill = paint;
+        fill.operation = scene::RegionEdit::OPERATION_FILL;
+        fill.color = glm::u8vec4(10, 10, 250, 255);
+        fill.radius = 3.f;
+        edits.push_back(fill);
+
+        scene::RegionEdit coarse;
+        coarse.shape = scene::RegionEdit::SHAPE_MASK;
+        coarse.operation = scene::RegionEdit::OPERATION_FILL;
+        coarse.depth = 3;
+        coarse.center = erase.center;
+        coarse.color = glm::u8vec4(200, 200, 10, 255);
+        coarse.mask = {glm::ivec3(0), glm::ivec3(-1, 0, 0),
+                       glm::ivec3(0, 1, 0)};
+        edits.push_back(coarse);
+
+        scene::RegionEdit fine;
+        fine.shape = scene::RegionEdit::SHAPE_SPANS;
+        fine.operation = scene::RegionEdit::OPERATION_ERASE;
+        fine.depth = 6;
+        fine.center = erase.center;
+        for (int y = -3; y <= 3; ++y) {
+            fine.spans.push_back({glm::ivec3(-20, y, 0), 40});
+            fine.spans.push_back({glm::ivec3(-20, y, 1), 40});
+        }
+        edits.push_back(fine);
+
+        edits.push_back(erase);
+
+        ok = check_stroke("stroke", scene, reference, edits, stroke_record) &&
+             ok;
+    }
+
+    // undoing both newest first gets back to the original scene, and redoing
+    // them oldest first back to where they left it
+    {
+        scene::EditRecord both;
+        both.chunks = corner_record.chunks;
+        both.chunks.insert(both.chunks.end(), stroke_record.chunks.begin(),
+                           stroke_record.chunks.end());
+        scene::Scene original(64, 4.f);
+        tests::fill_random_scene(original, 11);
+
+        scene.swap_edit_record(stroke_record);
+        scene.swap_edit_record(corner_record);
+        size_t undone = count_differences(take_snapshot(original, both),
+                                          take_snapshot(scene, both));
+        scene.swap_edit_record(corner_record);
+        scene.swap_edit_record(stroke_record);
+        size_t redone = count_differences(take_snapshot(reference, both),
+                                          take_snapshot(scene, both));
+
+        std::cout << "both: " << undone << " voxels off after undo, "
+                  << redone << " after redo" << std::endl;
+        ok = ok && undone == 0 && redone == 0;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,181 @@
+#include "scene/chunk.h"
+#include "scene/octree-cast.h"
+#include "test-scene.h"
+#include "vxng/geometry.h"
+#include "vxng/orbit-camera.h"
+#include "vxng/scene.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#define RAYS_PER_AXIS 160
+#define MAX_T_ERROR 1e-3f
+#define CHUNK_SCALE 4.f
+// finest voxels per world unit, 64 to a chunk
+#define VOXELS_PER_UNIT 16.f
+
+using namespace vxng;
+
+// whether a point sits on the edge of a finest voxel, i.e. on two of their
+// planes at once. a ray only grazing a voxel there might count as hitting it
+// or not, and the two casters don't agree on which
+auto on_voxel_edge(glm::vec3 point) -> bool {
+    int planes = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        float voxels = point[axis] * VOXELS_PER_UNIT;
+        planes += std::fabs(voxels - std::round(voxels)) < MAX_T_ERROR;
+    }
+    return planes >= 2;
+}
+
+// whether a point is on a face two chunks share, where both can be hit at the
+// same t. `raycast` takes whichever chunk it looks at first
+auto on_chunk_face(glm::vec3 point) -> bool {
+    for (int axis = 0; axis < 3; ++axis) {
+        float chunks = point[axis] / CHUNK_SCALE + 0.5f;
+        if (std::fabs(chunks - std::round(chunks)) < MAX_T_ERROR)
+            return true;
+    }
+    return false;
+}
+
+// checks `Scene::raycast_many` against casting each ray on its own, and
+// against the packed nodes' own caster, `raycast_flat`, run over every chunk
+// (short of ties, where either answer is right). rays from outside every
+// chunk, from inside one, down and across the seams between chunks, and
+// heading away from them all
+auto main() -> int {
+    scene::Scene scene(64, CHUNK_SCALE);
+    tests::fill_random_scene(scene, 5);
+
+    typedef struct PackedChunk {
+        geometry::AABB bounds;
+        std::vector<scene::GPUCompactNode> nodes;
+    } PackedChunk;
+    std::vector<PackedChunk> chunks;
+    for (auto &[coord, chunk] : scene.get_chunks())
+        chunks.push_back({chunk->get_bounds(), chunk->pack_nodes()});
+
+    typedef struct View {
+        const char *name;
+        glm::vec3 origin;
+        glm::vec3 angle_euler_yxz;
+    } View;
+    const View views[] = {
+        {"outside", glm::vec3(0.3f, 0.2f, 20.f), glm::vec3(0.f)},
+        {"inside", glm::vec3(0.3f, 0.2f, 0.1f), glm::vec3(0.f)},
+        {"inside, turned", glm::vec3(-3.1f, 1.3f, -1.2f),
+         glm::vec3(-0.4f, 2.3f, 0.f)},
+        // chunks meet at odd multiples of 2, so these run along their faces
+        {"down a seam", glm::vec3(2.f, 2.f, 20.f), glm::vec3(0.f)},
+        {"across seams", glm::vec3(-7.5f, -1.7f, 1.6f),
+         glm::vec3(0.f, -1.2f, 0.f)},
+        {"away", glm::vec3(0.3f, 0.2f, 20.f), glm::vec3(0.f, 3.14159f, 0.f)},
+    };
+
+    int failures = 0;
+    for (const View &view : views) {
+        // orbiting a point one unit ahead puts the camera at `origin`
+        camera::OrbitCamera facing(glm::vec3(0.f), view.angle_euler_yxz, 1.f,
+                                   0.9f);
+        camera::OrbitCamera camera(view.origin + facing.get_forward(),
+                                   view.angle_euler_yxz, 1.f, 0.9f);
+
+        std::vector<geometry::Ray> rays;
+        for (int y = 0; y < RAYS_PER_AXIS; ++y) {
+            for (int x = 0; x < RAYS_PER_AXIS; ++x) {
+                glm::vec2 ndc((x + 0.5f) / RAYS_PER_AXIS * 2.f - 1.f,
+                              (y + 0.5f) / RAYS_PER_AXIS * 2.f - 1.f);
+                rays.push_back(camera.screen_to_ray(ndc));
+            }
+        }
+
+        auto results = scene.raycast_many(rays);
+        if (results.size() != rays.size()) {
+            std::cerr << view.name << ": got " << results.size()
+                      << " results for " << rays.size() << " rays"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        int hits = 0, insides = 0, crossed = 0, ties = 0, mismatches = 0;
+        for (size_t i = 0; i < rays.size(); ++i) {
+            const geometry::RaycastResult &result = results[i];
+
+            // the nearest hit over every chunk's packed nodes, and whether
+            // the ray went through another chunk before reaching it
+            float flat_t = std::numeric_limits<float>::max();
+            float first_entry = flat_t, hit_entry = flat_t;
+            for (const PackedChunk &chunk : chunks) {
+                auto bounds_hit = geometry::ray_aabb_intersect(rays[i],
+                                                               chunk.bounds);
+                if (!bounds_hit.hit)
+                    continue;
+
+                float entry = bounds_hit.inside ? 0.f : bounds_hit.t;
+                first_entry = std::min(first_entry, entry);
+                auto flat = scene::raycast_flat(chunk.nodes.data(),
+                                                chunk.bounds, rays[i]);
+                if (flat.hit && flat.t < flat_t) {
+                    flat_t = flat.t;
+                    hit_entry = entry;
+                }
+            }
+            bool flat_hit = flat_t < std::numeric_limits<float>::max();
+
+            geometry::RaycastResult expected = scene.raycast(rays[i]);
+            hits += expected.hit;
+            insides += expected.hit && expected.inside;
+            crossed += flat_hit && hit_entry > first_entry;
+
+            // the same cast as `raycast`, voxel edge ties and all
+            glm::vec3 point = rays[i].origin + rays[i].direction * result.t;
+            bool same = expected.hit == result.hit;
+            if (same && expected.hit) {
+                same = std::fabs(expected.t - result.t) <= MAX_T_ERROR &&
+                       expected.inside == result.inside;
+                if (same && glm::length(expected.normal - result.normal) >
+                                MAX_T_ERROR) {
+                    same = on_chunk_face(point);
+                    ties += same;
+                }
+            }
+
+            // and the same voxel as the packed nodes, unless only grazed
+            bool same_flat = flat_hit == result.hit;
+            if (same_flat && flat_hit)
+                same_flat = std::fabs(flat_t - result.t) <= MAX_T_ERROR;
+            if (same && !same_flat) {
+                glm::vec3 flat_point =
+                    rays[i].origin + rays[i].direction * flat_t;
+                same_flat = (result.hit && on_voxel_edge(point)) ||
+                            (flat_hit && on_voxel_edge(flat_point));
+                ties += same_flat;
+            }
+            if (same && same_flat)
+                continue;
+
+            if (++mismatches <= 4) {
+                std::cerr << view.name << ": ray " << i << " expected hit "
+                          << expected.hit << " at " << expected.t
+                          << " (flat " << flat_hit << " at " << flat_t
+                          << "), got hit " << result.hit << " at "
+                          << result.t << std::endl;
+            }
+        }
+
+        std::cout << view.name << ": " << hits << " hits (" << insides
+                  << " inside, " << crossed << " past another chunk), "
+                  << ties << " ties, " << mismatches
+                  << " mismatched" << std::endl;
+        failures += mismatches;
+    }
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,152 @@
+#include "test-scene.h"
+#include "vxng/orbit-camera.h"
+#include "vxng/reference-renderer.h"
+#include "vxng/scene.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#define IMAGE_WIDTH 320
+#define IMAGE_HEIGHT 240
+// rays grazing a voxel's edge can go either way between the two traversals
+#define MAX_MISMATCHED_PIXELS 16
+#define MAX_T_ERROR 1e-3f
+// how far past a hit to sample its voxel's color, well under a voxel
+#define SAMPLE_NUDGE 1e-3f
+#define LOD_THRESHOLD 4.f
+
+using namespace vxng;
+
+// checks every pixel of a reference render against `Scene::raycast` for the
+// same ray: background where it misses, and where it hits the same depth and
+// the color of the voxel there, lit the way the shader lights it. then checks
+// a render with LOD on only ever draws nearer and more than that
+auto main() -> int {
+    scene::Scene scene(64, 4.f);
+    tests::fill_random_scene(scene, 5);
+    scene.set_distance_grid_resolution(16);
+
+    // looking down -z at everything from outside
+    camera::OrbitCamera camera(glm::vec3(0.3f, 0.2f, 0.f), glm::vec3(0.f), 20.f,
+                               0.9f);
+    camera.set_aspect_ratio(1.f);
+
+    const glm::vec3 light_dir = glm::normalize(glm::vec3(0.3f, 1.f, 0.5f));
+    const glm::vec3 dirlight(0.9f, 0.8f, 0.7f);
+    const glm::vec3 ambient(0.1f);
+    ReferenceRenderer renderer;
+    renderer.set_light_dir(light_dir);
+    renderer.set_dirlight_color(dirlight);
+    renderer.set_ambient_color(ambient);
+    renderer.set_background_color(glm::vec3(0.1f, 0.2f, 0.3f));
+    const glm::u8vec4 background(26, 51, 77, 255);
+
+    Image image = renderer.render(scene, camera, IMAGE_WIDTH, IMAGE_HEIGHT);
+    if (image.width != IMAGE_WIDTH || image.height != IMAGE_HEIGHT ||
+        image.pixels.size() != IMAGE_WIDTH * IMAGE_HEIGHT ||
+        image.depths.size() != image.pixels.size()) {
+        std::cerr << "Image has the wrong size" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the renderer widens the camera's view to the image's aspect ratio
+    float x_scale = float(IMAGE_WIDTH) / IMAGE_HEIGHT;
+
+    int hits = 0, misses = 0, mismatches = 0;
+    for (int y = 0; y < IMAGE_HEIGHT; ++y) {
+        for (int x = 0; x < IMAGE_WIDTH; ++x) {
+            glm::vec2 ndc((x + 0.5f) / IMAGE_WIDTH * 2.f - 1.f,
+                          1.f - (y + 0.5f) / IMAGE_HEIGHT * 2.f);
+            auto ray = camera.screen_to_ray(glm::vec2(ndc.x * x_scale, ndc.y));
+            geometry::RaycastResult hit = scene.raycast(ray);
+
+            // colors to expect, sampled just inside the hit. points on a
+            // voxel's edge could be either side of it, so try both stepping
+            // against the normal (which faces back out) and along the ray
+            glm::u8vec4 expected[2] = {background, background};
+            float expected_t = INFINITY;
+            if (hit.hit) {
+                glm::vec3 point = ray.origin + ray.direction * hit.t;
+                glm::vec3 insides[2] = {point - hit.normal * SAMPLE_NUDGE,
+                                        point + ray.direction * SAMPLE_NUDGE};
+                float diffuse =
+                    std::max(glm::dot(hit.normal, light_dir) * 0.5f + 0.5f,
+                             0.f);
+                glm::vec3 lighting = ambient + diffuse * dirlight;
+                for (int i = 0; i < 2; ++i) {
+                    glm::u8vec4 albedo =
+                        scene.sample_position(insides[i]).value_or(
+                            glm::u8vec4(0, 0, 0, 255));
+                    glm::vec3 color = glm::clamp(
+                        glm::vec3(albedo) / 255.f * lighting, 0.f, 1.f);
+                    expected[i] =
+                        glm::u8vec4(glm::round(color * 255.f), albedo.a);
+                }
+                expected_t = hit.t;
+            }
+
+            size_t index = static_cast<size_t>(y) * IMAGE_WIDTH + x;
+            glm::u8vec4 pixel = image.pixels[index];
+            float t = image.depths[index];
+            hits += hit.hit;
+            misses += !hit.hit;
+
+            // a unit either way, since lighting is redone in another order
+            bool same = false;
+            for (glm::u8vec4 color : expected) {
+                bool close = true;
+                for (int channel = 0; channel < 4; ++channel)
+                    close = close && std::abs(int(pixel[channel]) -
+                                              int(color[channel])) <= 1;
+                same = same || close;
+            }
+            same = same && (hit.hit ? std::fabs(t - expected_t) <= MAX_T_ERROR
+                                    : std::isinf(t));
+            if (same)
+                continue;
+
+            if (++mismatches <= 8) {
+                std::cerr << "Pixel " << x << ", " << y << ": expected ("
+                          << int(expected[0].r) << ", " << int(expected[0].g)
+                          << ", " << int(expected[0].b) << ") at "
+                          << expected_t
+                          << ", got (" << int(pixel.r) << ", "
+                          << int(pixel.g) << ", " << int(pixel.b) << ") at "
+                          << t << std::endl;
+            }
+        }
+    }
+
+    std::cout << hits << " hits, " << misses << " misses, " << mismatches
+              << " mismatched, " << image.traversal_steps << " steps"
+              << std::endl;
+    if (hits == 0 || misses == 0) {
+        std::cerr << "Scene should be partly in view" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (mismatches > MAX_MISMATCHED_PIXELS)
+        return EXIT_FAILURE;
+
+    // nodes hit whole are in front of anything inside them, and cover it
+    renderer.set_lod_threshold(LOD_THRESHOLD);
+    Image lod_image = renderer.render(scene, camera, IMAGE_WIDTH, IMAGE_HEIGHT);
+    int lod_pixels = 0, lod_mismatches = 0;
+    for (size_t i = 0; i < image.pixels.size(); ++i) {
+        lod_pixels += lod_image.pixels[i] != image.pixels[i];
+        if (lod_image.depths[i] > image.depths[i] + MAX_T_ERROR)
+            lod_mismatches++;
+    }
+
+    std::cout << "LOD: " << lod_pixels << " pixels changed, " << lod_mismatches
+              << " drawn further away or not at all, "
+              << lod_image.traversal_steps << " steps" << std::endl;
+    if (lod_pixels == 0 || lod_image.traversal_steps >= image.traversal_steps) {
+        std::cerr << "LOD should have kicked in somewhere" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return lod_mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,227 @@
+#include "scene/gpu-types.h"
+#include "scene/scene-file.h"
+#include "test-scene.h"
+#include "vxng/scene.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#define SAMPLES_PER_AXIS 24
+
+using namespace vxng;
+
+typedef std::vector<char> Bytes;
+
+auto read_bytes(const std::string &path) -> Bytes {
+    std::ifstream file(path, std::ios::binary);
+    return Bytes(std::istreambuf_iterator<char>(file), {});
+}
+
+auto write_bytes(const std::string &path, const Bytes &bytes) -> void {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), bytes.size());
+}
+
+template <typename T> auto read_at(const Bytes &bytes, uint64_t offset) -> T {
+    T value;
+    std::memcpy(&value, bytes.data() + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+auto write_at(Bytes &bytes, uint64_t offset, T value) -> void {
+    std::memcpy(bytes.data() + offset, &value, sizeof(T));
+}
+
+// whether both scenes hold the same voxels at a lattice of points over the
+// area `fill_random_scene` covers
+auto same_samples(const scene::Scene &a, const scene::Scene &b) -> bool {
+    for (int z = 0; z < SAMPLES_PER_AXIS; ++z) {
+        for (int y = 0; y < SAMPLES_PER_AXIS; ++y) {
+            for (int x = 0; x < SAMPLES_PER_AXIS; ++x) {
+                glm::vec3 position =
+                    (glm::vec3(x, y, z) + 0.5f) / float(SAMPLES_PER_AXIS) *
+                        glm::vec3(16.f, 12.f, 8.f) -
+                    glm::vec3(8.f, 6.f, 4.f);
+                if (a.sample_position(position) != b.sample_position(position))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+// saves a scene, then checks that `load_file` turns down copies with a
+// corrupt header, index or octree arrays, leaving the scene it's loading into
+// alone, while the untouched file still loads
+auto main() -> int {
+    namespace fs = std::filesystem;
+    std::string path = (fs::temp_directory_path() / "vxng-test.vxng").string();
+    std::string bad_path =
+        (fs::temp_directory_path() / "vxng-test-corrupt.vxng").string();
+
+    scene::Scene saved(64, 4.f);
+    tests::fill_random_scene(saved, 3);
+    if (!saved.save_file(path)) {
+        std::cerr << "Couldn't save the scene" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const Bytes bytes = read_bytes(path);
+
+    // offsets into the file, going by the first chunk's entry
+    const uint64_t entry = sizeof(scene::SceneFileHeader);
+    const uint64_t slot_count_at =
+        entry + offsetof(scene::SceneFileChunkEntry, slot_count);
+    const uint64_t octree_offset_at =
+        entry + offsetof(scene::SceneFileChunkEntry, octree_offset);
+    const uint64_t vxdata_offset_at =
+        entry + offsetof(scene::SceneFileChunkEntry, vxdata_offset);
+    const uint32_t slot_count = read_at<uint32_t>(bytes, slot_count_at);
+    const uint64_t octree = read_at<uint64_t>(bytes, octree_offset_at);
+    auto node_at = [octree](uint32_t slot) {
+        return octree + sizeof(scene::GPUOctreeNode) * slot;
+    };
+
+    const uint64_t root_children_at =
+        node_at(0) + offsetof(scene::GPUOctreeNode, first_child_idx);
+    const uint64_t root_mask_at =
+        node_at(0) + offsetof(scene::GPUOctreeNode, child_mask);
+
+    // the first leaf down the root's first children
+    uint32_t leaf = 0;
+    for (int depth = 0; depth < 32; ++depth) {
+        auto node = read_at<scene::GPUOctreeNode>(bytes, node_at(leaf));
+        if (node.child_mask == 0)
+            break;
+        leaf = node.first_child_idx;
+    }
+
+    typedef struct Corruption {
+        const char *name;
+        std::function<void(Bytes &)> apply;
+    } Corruption;
+    const Corruption corruptions[] = {
+        // header
+        {"cut off in the header", [](Bytes &b) { b.resize(10); }},
+        {"bad magic",
+         [](Bytes &b) {
+             write_at<uint32_t>(b, offsetof(scene::SceneFileHeader, magic), 0);
+         }},
+        {"future version",
+         [](Bytes &b) {
+             write_at<uint32_t>(b, offsetof(scene::SceneFileHeader, version),
+                                scene::SCENE_FILE_VERSION + 1);
+         }},
+        {"resolution not a power of 2",
+         [](Bytes &b) {
+             write_at<int32_t>(
+                 b, offsetof(scene::SceneFileHeader, chunk_resolution), 48);
+         }},
+        {"negative scale",
+         [](Bytes &b) {
+             write_at<float>(b, offsetof(scene::SceneFileHeader, chunk_scale),
+                             -4.f);
+         }},
+        {"more chunks than the index holds",
+         [](Bytes &b) {
+             write_at<uint32_t>(
+                 b, offsetof(scene::SceneFileHeader, chunk_count), 1u << 30);
+         }},
+        {"cut off in the index",
+         [entry](Bytes &b) {
+             b.resize(entry + sizeof(scene::SceneFileChunkEntry) / 2);
+         }},
+
+        // index
+        {"no slots",
+         [=](Bytes &b) { write_at<uint32_t>(b, slot_count_at, 0); }},
+        {"more slots than the file holds",
+         [=](Bytes &b) { write_at<uint32_t>(b, slot_count_at, 1u << 30); }},
+        {"octree past the end",
+         [=](Bytes &b) {
+             write_at<uint64_t>(b, octree_offset_at, b.size() + 16);
+         }},
+        {"octree misaligned",
+         [=](Bytes &b) {
+             write_at<uint64_t>(b, octree_offset_at, octree + 2);
+         }},
+        {"voxel data running off the end",
+         [=](Bytes &b) {
+             write_at<uint64_t>(b, vxdata_offset_at,
+                                (b.size() - 4 * slot_count / 2) & ~15ull);
+         }},
+        {"cut off in the arrays",
+         [](Bytes &b) { b.resize(b.size() - 64); }},
+
+        // octree arrays
+        {"children past the last slot",
+         [=](Bytes &b) {
+             write_at<uint32_t>(b, root_children_at, slot_count - 1);
+         }},
+        {"more than 8 children",
+         [=](Bytes &b) {
+             write_at<uint32_t>(b, root_mask_at, 0x1FF);
+         }},
+        {"root its own child",
+         [=](Bytes &b) {
+             write_at<uint32_t>(b, root_children_at, 0);
+         }},
+        {"color past the last slot",
+         [=](Bytes &b) {
+             uint64_t color_at =
+                 node_at(leaf) + offsetof(scene::GPUOctreeNode, voxel_data_idx);
+             write_at<uint32_t>(b, color_at, slot_count);
+         }},
+    };
+
+    int failures = 0;
+
+    // loaded over a scene of its own, which a failed load should leave be
+    scene::Scene expected(64, 4.f);
+    tests::fill_random_scene(expected, 4);
+    for (const Corruption &corruption : corruptions) {
+        Bytes corrupt = bytes;
+        corruption.apply(corrupt);
+        write_bytes(bad_path, corrupt);
+
+        scene::Scene scene(64, 4.f);
+        tests::fill_random_scene(scene, 4);
+        bool loaded = scene.load_file(bad_path);
+        bool untouched = same_samples(scene, expected);
+        std::cout << corruption.name << ": "
+                  << (loaded ? "loaded" : "turned down")
+                  << (untouched ? "" : ", scene changed") << std::endl;
+        failures += loaded || !untouched;
+    }
+
+    // a sound file, but for chunks of another size
+    const glm::u8vec4 color(200, 100, 20, 255);
+    scene::Scene coarser(32, 4.f);
+    coarser.set_voxel_filled(3, glm::vec3(0.1f), color);
+    if (coarser.load_file(path) ||
+        coarser.sample_position(glm::vec3(0.1f)) != color) {
+        std::cerr << "Chunk resolution mismatch: loaded" << std::endl;
+        failures++;
+    }
+
+    scene::Scene loaded(64, 4.f);
+    if (!loaded.load_file(path) || !same_samples(loaded, saved)) {
+        std::cerr << "The untouched file should load as saved" << std::endl;
+        failures++;
+    }
+
+    fs::remove(path);
+    fs::remove(bad_path);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "vxng/scene.h"
+
+#include <glm/glm.hpp>
+
+#include <random>
+
+namespace vxng::tests {
+
+/**
+ * Scatters filled and empty voxels of mixed sizes across a few chunks either
+ * side of the origin, so rays see hits, misses and chunk boundaries
+ */
+inline auto fill_random_scene(scene::Scene &scene, unsigned seed) -> void {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::uniform_int_distribution<int> depth(2, 6);
+    std::uniform_int_distribution<int> channel(0, 254);
+
+    for (int i = 0; i < 6000; ++i) {
+        // one at a time, since argument order isn't specified
+        float x = unit(rng) * 15.9f - 7.95f;
+        float y = unit(rng) * 11.9f - 5.95f;
+        float z = unit(rng) * 7.9f - 3.95f;
+        glm::vec3 position(x, y, z);
+        if (rng() % 3) {
+            glm::u8vec4 color(channel(rng), 100, 20, 255);
+            scene.set_voxel_filled(depth(rng), position, color);
+        } else {
+            scene.set_voxel_empty(depth(rng), position);
+        }
+    }
+}
+
+} // namespace vxng::tests